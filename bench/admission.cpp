@@ -0,0 +1,95 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+#include <dummydb_client.hpp>
+#include <dummydb_server.hpp>
+
+#include <atomic>
+#include <deque>
+#include <thread>
+
+namespace {
+
+/// The number of tables scanned by the background load.
+constexpr std::size_t table_count = 16;
+
+/// The number of records in each table.
+constexpr std::size_t records_per_table = 500;
+
+/// The number of point lookups whose latency is measured.
+constexpr std::size_t lookup_count = 20000;
+
+/// The number of connections issuing scans.
+constexpr std::size_t scanner_count = 2;
+
+/// The number of scans each scanner keeps in flight.
+constexpr std::size_t scan_depth = 32;
+
+/// Measures the latency of point lookups on a server configured by `options` while other clients
+/// keep scanning whole tables, and prints it labeled by `label`.
+void mixed_load(ddb::ServerOptions const& options, char const* label) {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::Integer});
+    for (std::size_t i = 0; i < records_per_table; ++i) {
+      db.insert(t, {static_cast<std::int32_t>(i), 0});
+    }
+  }
+
+  ddb::Server server{db, options};
+  ddb::Endpoint e;
+  e.port = server.listen_tcp(0);
+  server.start();
+
+  std::atomic<bool> done = false;
+  std::atomic<std::size_t> scans = 0, shed = 0;
+  std::vector<std::thread> scanners;
+  for (std::size_t s = 0; s < scanner_count; ++s) {
+    scanners.emplace_back([&, s] {
+      ddb::Connection c{e};
+      std::deque<std::future<std::vector<std::vector<ddb::Value>>>> inflight;
+      for (std::size_t i = s; !done.load(std::memory_order_relaxed); ++i) {
+        if (inflight.size() == scan_depth) {
+          try {
+            ddb::bench::keep(inflight.front().get());
+            scans.fetch_add(1, std::memory_order_relaxed);
+          } catch (ddb::ServerBusy const&) {
+            shed.fetch_add(1, std::memory_order_relaxed);
+          }
+          inflight.pop_front();
+        }
+        inflight.push_back(c.scan(i % table_count, 0, ddb::not_found));
+      }
+      for (auto& f : inflight) f.wait();
+    });
+  }
+
+  ddb::Connection c{e};
+  ddb::bench::Latencies latencies;
+  for (std::size_t i = 0; i < lookup_count; ++i) {
+    auto s = ddb::bench::Clock::now();
+    ddb::bench::keep(c.record(i % table_count, i % records_per_table).get());
+    latencies.add(ddb::bench::elapsed_ns(s));
+  }
+  done = true;
+  for (auto& t : scanners) t.join();
+  server.stop();
+
+  latencies.report(label);
+  std::printf("%-32s %zu scans completed, %zu shed\n", "", scans.load(), shed.load());
+}
+
+}
+
+int main() {
+  ddb::ServerOptions inline_options;
+  inline_options.threads = 2;
+  mixed_load(inline_options, "record under scans (inline)");
+
+  ddb::ServerOptions admission_options;
+  admission_options.threads = 2;
+  admission_options.admission.workers = 2;
+  admission_options.admission.max_queued_scans = 4;
+  mixed_load(admission_options, "record under scans (admission)");
+
+  return 0;
+}
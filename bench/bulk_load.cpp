@@ -0,0 +1,76 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+#include <dummydb_bulk.hpp>
+
+#include <string>
+#include <thread>
+
+namespace {
+
+/// A database whose string table holds millions of strings.
+using Database = ddb::BasicDummyDB<ddb::Layout<ddb::table_size, 1 << 26>>;
+
+/// The number of records ingested by each benchmark.
+constexpr std::size_t record_count = 1 << 19;
+
+/// The number of records per batch given to a loader.
+constexpr std::size_t batch_size = 1 << 16;
+
+/// The schema of the records.
+std::vector<ddb::FieldType> const schema{ddb::Integer, ddb::String, ddb::String, ddb::Float};
+
+/// Returns string-heavy records drawing their strings from vocabularies of various sizes.
+std::vector<std::vector<ddb::Value>> records() {
+  std::vector<std::vector<ddb::Value>> result;
+  for (std::size_t i = 0; i < record_count; ++i) {
+    result.push_back({
+      static_cast<std::int32_t>(i), "city " + std::to_string(i % 1000),
+      "session " + std::to_string(i % (record_count / 4)), 0.5 * static_cast<double>(i)
+    });
+  }
+  return result;
+}
+
+/// Inserts `rs` one by one, interning each string separately, and prints the throughput.
+void insert_serially(std::vector<std::vector<ddb::Value>> const& rs, std::size_t count) {
+  Database db{record_count};
+  auto t = db.create_table(schema);
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!db.try_insert(t, rs[i])) {
+      t = db.create_table(schema);
+      db.insert(t, rs[i]);
+    }
+  }
+  ddb::bench::report_throughput("insert (serial)", count, ddb::bench::elapsed_ns(s));
+}
+
+/// Loads `rs` in batches with a loader running `parallelism` tasks on as many threads, and prints
+/// the throughput.
+void load(std::vector<std::vector<ddb::Value>> const& rs, std::size_t parallelism) {
+  Database db{record_count};
+  ddb::ThreadPool pool{parallelism};
+  ddb::BulkLoader loader{db, pool, schema, parallelism};
+  std::span<std::vector<ddb::Value> const> rest = rs;
+  auto s = ddb::bench::Clock::now();
+  for (; !rest.empty(); rest = rest.subspan(std::min(batch_size, rest.size()))) {
+    loader.load(rest.first(std::min(batch_size, rest.size())));
+  }
+  auto label = "BulkLoader (" + std::to_string(parallelism) + " threads)";
+  ddb::bench::report_throughput(label.c_str(), rs.size(), ddb::bench::elapsed_ns(s));
+}
+
+}
+
+int main() {
+  std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+  auto rs = records();
+
+  // Interning strings one by one walks the string table for each of them, so only a prefix of the
+  // records is inserted serially.
+  insert_serially(rs, record_count / 64);
+  for (std::size_t parallelism : {1, 2, 4, 8}) {
+    load(rs, parallelism);
+  }
+  return 0;
+}
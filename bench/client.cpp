@@ -0,0 +1,100 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+#include <dummydb_client.hpp>
+#include <dummydb_server.hpp>
+
+#include <deque>
+
+namespace {
+
+/// The number of tables filled by the insertion benchmarks.
+constexpr std::size_t table_count = 64;
+
+/// The number of records inserted in each table.
+constexpr std::size_t records_per_table = 500;
+
+/// The number of lookups performed by the lookup benchmarks.
+constexpr std::size_t lookup_count = 50000;
+
+/// Performs `lookup_count` lookups with up to `depth` requests in flight, spread over `pool`.
+void lookups(ddb::ConnectionPool& pool, std::size_t table, std::size_t depth, char const* label) {
+  std::deque<std::future<std::vector<ddb::Value>>> inflight;
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t i = 0; i < lookup_count; ++i) {
+    if (inflight.size() == depth) {
+      ddb::bench::keep(inflight.front().get());
+      inflight.pop_front();
+    }
+    inflight.push_back(pool.record(table, i % records_per_table));
+  }
+  while (!inflight.empty()) {
+    ddb::bench::keep(inflight.front().get());
+    inflight.pop_front();
+  }
+  ddb::bench::report_throughput(label, lookup_count, ddb::bench::elapsed_ns(s));
+}
+
+}
+
+int main() {
+  ddb::DummyDB db{3 * table_count};
+  ddb::Server server{db};
+  ddb::Endpoint e;
+  e.port = server.listen_tcp(0);
+  server.start();
+
+  ddb::ConnectionPool single{e, 1};
+  ddb::ConnectionPool pool{e, 4};
+  std::vector<ddb::Value> record{1, 2};
+
+  // One request per round trip.
+  {
+    auto s = ddb::bench::Clock::now();
+    for (std::size_t t = 0; t < table_count; ++t) {
+      auto table = single.create_table({ddb::Integer, ddb::Integer}).get();
+      for (std::size_t i = 0; i < records_per_table; ++i) {
+        single.insert(table, record).get();
+      }
+    }
+    ddb::bench::report_throughput("insert (round trip)", table_count * records_per_table, ddb::bench::elapsed_ns(s));
+  }
+
+  // Pipelined: all the insertions of a table are in flight at once.
+  {
+    auto s = ddb::bench::Clock::now();
+    std::vector<std::future<std::size_t>> inflight;
+    for (std::size_t t = 0; t < table_count; ++t) {
+      auto table = pool.create_table({ddb::Integer, ddb::Integer}).get();
+      inflight.clear();
+      for (std::size_t i = 0; i < records_per_table; ++i) {
+        inflight.push_back(pool.insert(table, record));
+      }
+      for (auto& f : inflight) f.get();
+    }
+    ddb::bench::report_throughput("insert (pipelined)", table_count * records_per_table, ddb::bench::elapsed_ns(s));
+  }
+
+  // Batched: records are sent to the server by groups of 128.
+  std::size_t last_table = 0;
+  {
+    auto s = ddb::bench::Clock::now();
+    std::vector<std::future<std::size_t>> inflight;
+    for (std::size_t t = 0; t < table_count; ++t) {
+      last_table = single.create_table({ddb::Integer, ddb::Integer}).get();
+      inflight.clear();
+      ddb::BatchInserter batch{single.next(), last_table, 128};
+      for (std::size_t i = 0; i < records_per_table; ++i) {
+        inflight.push_back(batch.insert(record));
+      }
+      batch.flush();
+      for (auto& f : inflight) f.get();
+    }
+    ddb::bench::report_throughput("insert (batched)", table_count * records_per_table, ddb::bench::elapsed_ns(s));
+  }
+
+  lookups(single, last_table, 1, "record (round trip)");
+  lookups(single, last_table, 64, "record (pipelined, 1 conn)");
+  lookups(pool, last_table, 64, "record (pipelined, 4 conns)");
+
+  return 0;
+}
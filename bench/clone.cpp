@@ -0,0 +1,69 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <sstream>
+#include <string>
+
+namespace {
+
+/// The maximum number of tables of the benchmarked databases.
+constexpr std::size_t max_table_count = 1 << 16;
+
+/// The number of times each operation is repeated.
+constexpr std::size_t repetition_count = 8;
+
+/// Returns a database with `table_count` full tables whose records have a string field.
+ddb::DummyDB populated(std::size_t table_count) {
+  ddb::DummyDB db{max_table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::String});
+    for (std::int32_t i = 0; db.try_insert(t, i, std::to_string(i % 64) + " units"); ++i) {}
+  }
+  return db;
+}
+
+/// Prints the duration of `duplicate`, which copies a database of `table_count` tables, labeled by
+/// `label`.
+template<typename Duplicate>
+void measure(char const* label, std::size_t table_count, Duplicate duplicate) {
+  double total = 0;
+  for (std::size_t i = 0; i < repetition_count; ++i) {
+    auto s = ddb::bench::Clock::now();
+    ddb::bench::keep(duplicate());
+    total += ddb::bench::elapsed_ns(s);
+  }
+  auto mib = static_cast<double>(table_count * ddb::table_size) / (1 << 20);
+  std::printf("%-24s %6zu tables (%7.1f MiB) %10.3f ms\n",
+    label, table_count, mib, total / static_cast<double>(repetition_count) / 1e6);
+}
+
+}
+
+int main() {
+  for (std::size_t n : {16, 256, 4096, 65536}) {
+    auto db = populated(n);
+    measure("clone", n, [&] { return db.clone().table_count(); });
+    measure("save and load", n, [&] {
+      std::stringstream image;
+      db.save(image);
+      return ddb::DummyDB{image}.table_count();
+    });
+  }
+
+  // Copying tables into a clone keeps the identities of their strings, whereas copying them into
+  // another database re-interns them.
+  std::size_t n = 4096;
+  auto db = populated(n);
+  measure("copy_table (clone)", n, [&] {
+    auto copy = db.clone();
+    for (std::size_t t = 0; t < n; ++t) copy.copy_table(db, t);
+    return copy.table_count();
+  });
+  measure("copy_table (other)", n, [&] {
+    ddb::DummyDB other{max_table_count};
+    other.insert_string("a string that shifts every identity");
+    for (std::size_t t = 0; t < n; ++t) other.copy_table(db, t);
+    return other.table_count();
+  });
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+/// The number of tables in the benchmarked database.
+constexpr std::size_t table_count = 4096;
+
+/// The number of records stored in each table before the readers start.
+constexpr std::size_t preloaded_count = 8;
+
+/// Reads the preloaded records of all tables with `reader_count` threads while another thread
+/// appends records to the same tables if `writing` is `true`, and prints the throughput of the
+/// readers labeled by `label`.
+///
+/// Readers only touch the schema and the preloaded records of each table, whereas the writer
+/// updates the counters of the tables and the records that it appends. Any slowdown of the
+/// readers caused by the writer thus comes from cache lines shared by both.
+void read_while_writing(std::size_t reader_count, bool writing, char const* label) {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::Integer});
+    for (std::size_t i = 0; i < preloaded_count; ++i) {
+      db.insert(t, static_cast<std::int32_t>(i), 0);
+    }
+  }
+  auto capacity = db.record_capacity(0);
+
+  std::atomic<bool> done = false;
+  std::atomic<std::size_t> reads = 0;
+  std::vector<std::thread> readers;
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t r = 0; r < reader_count; ++r) {
+    readers.emplace_back([&, r] {
+      std::size_t n = 0;
+      for (std::size_t i = r; !done.load(std::memory_order_relaxed); ++i, ++n) {
+        ddb::bench::keep(db.record(i % table_count, i % preloaded_count));
+      }
+      reads.fetch_add(n, std::memory_order_relaxed);
+    });
+  }
+
+  if (writing) {
+    // Append one record to each table in turn until all of them are full.
+    for (std::size_t i = preloaded_count; i < capacity; ++i) {
+      for (std::size_t t = 0; t < table_count; ++t) {
+        ddb::bench::keep(db.insert(t, static_cast<std::int32_t>(i), 1));
+      }
+    }
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  }
+  done = true;
+  for (auto& t : readers) t.join();
+  ddb::bench::report_throughput(label, reads.load(), ddb::bench::elapsed_ns(s) * static_cast<double>(reader_count));
+}
+
+/// Appends records to disjoint sets of tables with `writer_count` threads and prints the
+/// throughput of each thread labeled by `label`.
+///
+/// Writers share no table, so they only slow each other down if the counters of their tables
+/// share cache lines.
+void write_disjoint(std::size_t writer_count, char const* label) {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::Integer});
+  }
+  auto capacity = db.record_capacity(0);
+
+  std::vector<std::thread> writers;
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t w = 0; w < writer_count; ++w) {
+    writers.emplace_back([&, w] {
+      for (std::size_t i = 0; i < capacity; ++i) {
+        for (std::size_t t = w; t < table_count; t += writer_count) {
+          ddb::bench::keep(db.insert(t, static_cast<std::int32_t>(i), 1));
+        }
+      }
+    });
+  }
+  for (auto& t : writers) t.join();
+  auto inserted = table_count * capacity;
+  ddb::bench::report_throughput(label, inserted, ddb::bench::elapsed_ns(s) * static_cast<double>(writer_count));
+}
+
+}
+
+int main() {
+  auto n = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  std::printf("%u hardware threads, %u readers\n", std::thread::hardware_concurrency(), n);
+  read_while_writing(n, false, "record (idle tables)");
+  read_while_writing(n, true, "record (tables being filled)");
+  write_disjoint(1, "insert (1 writer)");
+  write_disjoint(n + 1, "insert (disjoint writers)");
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <dummydb_bench.hpp>
+#include <dummydb_hash.hpp>
+
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+/// The number of keys inserted in the benchmarked tables.
+constexpr std::size_t key_count = 1 << 20;
+
+/// Hashes each of `keys` with `hash` and prints the throughput labeled by `label`.
+template<typename K, typename Hash>
+void hash_all(std::vector<K> const& keys, char const* label, Hash hash) {
+  std::uint64_t x = 0;
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t r = 0; r < 8; ++r) {
+    for (auto const& k : keys) x += hash(k);
+  }
+  ddb::bench::keep(x);
+  ddb::bench::report_throughput(label, keys.size() * 8, ddb::bench::elapsed_ns(s));
+}
+
+/// Benchmarks insertions, successful and failed lookups, and erasures of `keys` in a table of type
+/// `Map`, whose lookups are made by `find`, and prints the throughput of each, labeled by `name`.
+template<typename Map, typename K, typename Find>
+void operations(std::vector<K> const& keys, std::vector<K> const& missing, std::string const& name, Find find) {
+  Map m;
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t i = 0; i < keys.size(); ++i) m.try_emplace(keys[i], i);
+  ddb::bench::report_throughput((name + " insert").c_str(), keys.size(), ddb::bench::elapsed_ns(s));
+
+  std::size_t found = 0;
+  s = ddb::bench::Clock::now();
+  for (auto const& k : keys) found += find(m, k);
+  ddb::bench::report_throughput((name + " find (hit)").c_str(), keys.size(), ddb::bench::elapsed_ns(s));
+  s = ddb::bench::Clock::now();
+  for (auto const& k : missing) found += find(m, k);
+  ddb::bench::report_throughput((name + " find (miss)").c_str(), missing.size(), ddb::bench::elapsed_ns(s));
+  ddb::bench::keep(found);
+
+  s = ddb::bench::Clock::now();
+  for (auto const& k : keys) m.erase(k);
+  ddb::bench::report_throughput((name + " erase").c_str(), keys.size(), ddb::bench::elapsed_ns(s));
+}
+
+/// Benchmarks `ddb::HashMap` and `std::unordered_map` with keys of type `K`.
+template<typename K>
+void compare(std::vector<K> const& keys, std::vector<K> const& missing, char const* name) {
+  operations<ddb::HashMap<K, std::size_t>>(keys, missing, std::string{"HashMap "} + name,
+    [](auto const& m, K const& k) { return m.find(k) != nullptr; });
+  operations<std::unordered_map<K, std::size_t>>(keys, missing, std::string{"unordered_map "} + name,
+    [](auto const& m, K const& k) { return m.find(k) != m.end(); });
+}
+
+}
+
+int main() {
+  std::mt19937_64 rng{42};
+  std::vector<std::uint64_t> integers(key_count), other_integers(key_count);
+  for (auto& k : integers) k = rng();
+  for (auto& k : other_integers) k = rng();
+  std::vector<double> numbers(key_count);
+  for (auto& k : numbers) k = std::uniform_real_distribution<double>{0, 1}(rng);
+  std::vector<std::string> words, other_words, sentences;
+  for (std::size_t i = 0; i < key_count; ++i) {
+    words.push_back("key " + std::to_string(rng() % 100000000));
+    other_words.push_back("other " + std::to_string(rng() % 100000000));
+    sentences.push_back("a longer string identifying the sensor " + std::to_string(i) + " in building 42");
+  }
+
+  ddb::Hash h;
+  hash_all(integers, "Hash (integer)", h);
+  hash_all(integers, "std::hash (integer)", std::hash<std::uint64_t>{});
+  hash_all(numbers, "Hash (double)", h);
+  hash_all(numbers, "std::hash (double)", std::hash<double>{});
+  hash_all(words, "Hash (12-byte string)", [&](std::string const& s) { return h(s); });
+  hash_all(words, "std::hash (12-byte string)", std::hash<std::string>{});
+  hash_all(sentences, "Hash (50-byte string)", [&](std::string const& s) { return h(s); });
+  hash_all(sentences, "std::hash (50-byte string)", std::hash<std::string>{});
+
+  compare(integers, other_integers, "(integer)");
+  compare(words, other_words, "(string)");
+  return 0;
+}
@@ -0,0 +1,49 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <string_view>
+
+namespace {
+
+/// The number of tables filled by each benchmark.
+constexpr std::size_t table_count = 4096;
+
+/// Fills `table_count` tables of `db` with the given schema by calling `insert(table, i)` for the
+/// `i`-th record of each table, and prints the throughput labeled by `label`.
+template<typename Insert>
+void fill(std::vector<ddb::FieldType> const& schema, char const* label, Insert insert) {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) db.create_table(schema);
+  auto n = db.record_capacity(0);
+
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t t = 0; t < table_count; ++t) {
+    for (std::size_t i = 0; i < n; ++i) {
+      ddb::bench::keep(insert(db, t, static_cast<std::int32_t>(i)));
+    }
+  }
+  ddb::bench::report_throughput(label, table_count * n, ddb::bench::elapsed_ns(s));
+}
+
+}
+
+int main() {
+  std::vector<ddb::FieldType> numbers{ddb::Integer, ddb::Float, ddb::Integer};
+  fill(numbers, "insert (vector, numbers)", [](auto& db, std::size_t t, std::int32_t i) {
+    return db.insert(t, {i, 0.5, i});
+  });
+  fill(numbers, "insert (fields, numbers)", [](auto& db, std::size_t t, std::int32_t i) {
+    return db.insert(t, i, 0.5, i);
+  });
+
+  std::vector<ddb::FieldType> mixed{ddb::Integer, ddb::String};
+  std::string_view name = "a sensor with a name longer than the small string buffer";
+  fill(mixed, "insert (vector, string)", [&](auto& db, std::size_t t, std::int32_t i) {
+    return db.insert(t, {i, std::string{name}});
+  });
+  fill(mixed, "insert (fields, string)", [&](auto& db, std::size_t t, std::int32_t i) {
+    return db.insert(t, i, name);
+  });
+
+  return 0;
+}
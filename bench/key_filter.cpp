@@ -0,0 +1,59 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+#include <dummydb_filter.hpp>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+/// The number of lookups performed by each benchmark.
+constexpr std::size_t lookup_count = 1 << 16;
+
+}
+
+int main() {
+  ddb::DummyDB db{1};
+  auto t = db.create_table({ddb::Integer, ddb::Float});
+  std::mt19937 rng{42};
+  for (std::int32_t i = 0; db.try_insert(t, static_cast<std::int32_t>(rng() >> 1), 0.5 * i); ++i) {}
+  auto n = db.record_count(t);
+  std::printf("%zu keys\n", n);
+
+  // Lookups of keys that are mostly absent, as when deduplicating new data.
+  std::vector<ddb::Value> keys;
+  for (std::size_t i = 0; i < lookup_count; ++i) {
+    keys.push_back((i % 16 == 0) ? db.record(t, rng() % n)[0] : ddb::Value{static_cast<std::int32_t>(rng() >> 1)});
+  }
+
+  // Without a filter, every lookup scans the key column.
+  std::vector<std::int32_t> column(n);
+  std::size_t columns[] = {0};
+  ddb::ColumnBuffer buffers[] = {std::span{column}};
+  std::size_t found = 0;
+  auto s = ddb::bench::Clock::now();
+  for (auto const& k : keys) {
+    db.project(t, columns, 0, n, buffers);
+    found += std::find(column.begin(), column.end(), std::get<std::int32_t>(k)) != column.end();
+  }
+  ddb::bench::report_throughput("scan (no filter)", keys.size(), ddb::bench::elapsed_ns(s));
+
+  for (double rate : {0.1, 0.01, 0.001}) {
+    ddb::KeyFilter f{db, t, 0, rate};
+    s = ddb::bench::Clock::now();
+    for (auto const& k : keys) found += f.contains(k);
+    auto label = "KeyFilter (" + std::to_string(f.filter().fingerprint_bits()) + "-bit fingerprints)";
+    ddb::bench::report_throughput(label.c_str(), keys.size(), ddb::bench::elapsed_ns(s));
+    auto u = f.usage();
+    std::printf("%-32s %5zu bytes (%.1f bits/key), false positive rate %.4f (target %.3f)\n", "",
+      f.filter().memory_size(), 8.0 * static_cast<double>(f.filter().memory_size()) / static_cast<double>(n),
+      static_cast<double>(u.false_positives) / static_cast<double>(u.lookups - (u.lookups / 16)), rate);
+  }
+
+  ddb::HashMap<std::int32_t, std::uint32_t> index{n};
+  std::printf("%-32s %5zu bytes (%.1f bits/key) for a hash index\n", "",
+    index.capacity() * (1 + sizeof(std::pair<std::int32_t, std::uint32_t>)),
+    8.0 * static_cast<double>(index.capacity() * (1 + sizeof(std::pair<std::int32_t, std::uint32_t>))) / static_cast<double>(n));
+  ddb::bench::keep(found);
+  return 0;
+}
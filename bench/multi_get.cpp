@@ -0,0 +1,72 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <random>
+
+namespace {
+
+/// The number of tables in the benchmarked database (256 MiB of tables).
+constexpr std::size_t table_count = 65536;
+
+/// The number of records in each table.
+constexpr std::size_t records_per_table = 128;
+
+/// The number of lookups performed by each benchmark.
+constexpr std::size_t lookup_count = 1 << 20;
+
+}
+
+int main() {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::Float, ddb::Integer});
+    for (std::size_t i = 0; i < records_per_table; ++i) {
+      db.insert(t, {static_cast<std::int32_t>(i), 1.0, static_cast<std::int32_t>(t)});
+    }
+  }
+
+  std::mt19937_64 rng{42};
+  std::vector<std::pair<std::size_t, std::size_t>> locations(lookup_count);
+  for (auto& l : locations) {
+    l = {rng() % table_count, rng() % records_per_table};
+  }
+
+  {
+    auto s = ddb::bench::Clock::now();
+    for (auto [t, r] : locations) {
+      ddb::bench::keep(db.record(t, r));
+    }
+    ddb::bench::report_throughput("record (random tables)", lookup_count, ddb::bench::elapsed_ns(s));
+  }
+
+  {
+    auto s = ddb::bench::Clock::now();
+    constexpr std::size_t batch = 256;
+    for (std::size_t i = 0; i < lookup_count; i += batch) {
+      ddb::bench::keep(db.multi_get(std::span{locations}.subspan(i, batch)));
+    }
+    ddb::bench::report_throughput("multi_get (random tables)", lookup_count, ddb::bench::elapsed_ns(s));
+  }
+
+  // A single table fits in L1, so there is nothing to hide; this measures the overhead of staging.
+  std::vector<std::size_t> ids(lookup_count);
+  for (auto& i : ids) i = rng() % records_per_table;
+  {
+    auto s = ddb::bench::Clock::now();
+    for (auto i : ids) {
+      ddb::bench::keep(db.record(0, i));
+    }
+    ddb::bench::report_throughput("record (one table)", lookup_count, ddb::bench::elapsed_ns(s));
+  }
+
+  {
+    auto s = ddb::bench::Clock::now();
+    constexpr std::size_t batch = 256;
+    for (std::size_t i = 0; i < lookup_count; i += batch) {
+      ddb::bench::keep(db.multi_get(0, std::span{ids}.subspan(i, batch)));
+    }
+    ddb::bench::report_throughput("multi_get (one table)", lookup_count, ddb::bench::elapsed_ns(s));
+  }
+
+  return 0;
+}
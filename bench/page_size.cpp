@@ -0,0 +1,66 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <random>
+
+namespace {
+
+/// The number of records stored by each benchmark.
+constexpr std::size_t record_count = 1 << 22;
+
+/// The number of lookups performed by each benchmark.
+constexpr std::size_t lookup_count = 1 << 20;
+
+/// Stores `record_count` records in a database of layout `L`, then looks records up at random and
+/// summarizes a column of every table, printing the throughput of each phase and the memory used
+/// per record, labeled by `label`.
+template<typename L>
+void run(char const* label) {
+  using Database = ddb::BasicDummyDB<L>;
+  std::vector<ddb::FieldType> schema{ddb::Integer, ddb::Float, ddb::Integer};
+  Database probe{1};
+  auto capacity = probe.record_capacity(probe.create_table(schema));
+  auto table_count = (record_count + capacity - 1) / capacity;
+
+  Database db{table_count};
+  std::string name = std::string{label} + " insert";
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t i = 0; i < record_count; ++i) {
+    auto t = i / capacity;
+    if (t == db.table_count()) db.create_table(schema);
+    ddb::bench::keep(db.insert(t, static_cast<std::int32_t>(i), 0.5, 1));
+  }
+  ddb::bench::report_throughput(name.c_str(), record_count, ddb::bench::elapsed_ns(s));
+
+  std::mt19937_64 rng{42};
+  std::vector<std::size_t> rows(lookup_count);
+  for (auto& r : rows) r = rng() % record_count;
+  name = std::string{label} + " record";
+  s = ddb::bench::Clock::now();
+  for (auto r : rows) {
+    ddb::bench::keep(db.record(r / capacity, r % capacity));
+  }
+  ddb::bench::report_throughput(name.c_str(), lookup_count, ddb::bench::elapsed_ns(s));
+
+  name = std::string{label} + " summarize";
+  s = ddb::bench::Clock::now();
+  ddb::Summary total;
+  for (std::size_t t = 0; t < table_count; ++t) {
+    total.merge(db.summarize(t, 0));
+  }
+  ddb::bench::keep(total);
+  ddb::bench::report_throughput(name.c_str(), record_count, ddb::bench::elapsed_ns(s));
+
+  std::printf("%-32s %zu records/table, %.2f bytes/record\n", "", capacity,
+    static_cast<double>(db.storage_size()) / static_cast<double>(record_count));
+}
+
+}
+
+int main() {
+  run<ddb::Layout<1024>>("1 KiB tables");
+  run<ddb::Layout<4096>>("4 KiB tables");
+  run<ddb::Layout<16384>>("16 KiB tables");
+  run<ddb::Layout<65536>>("64 KiB tables");
+  return 0;
+}
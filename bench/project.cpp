@@ -0,0 +1,79 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <string>
+
+namespace {
+
+/// The number of tables in the benchmarked database.
+constexpr std::size_t table_count = 1024;
+
+/// Extracts the columns `columns` of every table of `db` with `extract` and prints the throughput
+/// in values labeled by `label`.
+template<typename Extract>
+void extract_all(ddb::DummyDB const& db, std::vector<std::size_t> const& columns, char const* label, Extract extract) {
+  std::size_t values = 0;
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t t = 0; t < db.table_count(); ++t) {
+    values += extract(t) * columns.size();
+  }
+  ddb::bench::report_throughput(label, values, ddb::bench::elapsed_ns(s));
+}
+
+/// Benchmarks extracting `columns` of a database whose tables have the schema `schema` with
+/// `record` and with `project`.
+void compare(std::vector<ddb::FieldType> const& schema, std::vector<std::size_t> const& columns, char const* name) {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table(schema);
+    for (std::int32_t i = 0; ; ++i) {
+      std::vector<ddb::Value> r;
+      for (auto type : schema) {
+        if (type == ddb::Integer) r.emplace_back(i);
+        if (type == ddb::Float) r.emplace_back(0.5 * i);
+        if (type == ddb::String) r.emplace_back(std::to_string(i % 64));
+      }
+      if (!db.try_insert(t, r)) break;
+    }
+  }
+  auto capacity = db.record_capacity(0);
+
+  std::vector<std::int32_t> ints(capacity);
+  std::vector<double> doubles(capacity);
+  std::vector<std::string_view> strings(capacity);
+  std::vector<ddb::ColumnBuffer> buffers;
+  for (auto c : columns) {
+    if (schema[c] == ddb::Integer) buffers.emplace_back(std::span{ints});
+    if (schema[c] == ddb::Float) buffers.emplace_back(std::span{doubles});
+    if (schema[c] == ddb::String) buffers.emplace_back(std::span{strings});
+  }
+
+  auto label = std::string{"record ("} + name + ")";
+  extract_all(db, columns, label.c_str(), [&](std::size_t t) {
+    auto n = db.record_count(t);
+    for (std::size_t i = 0; i < n; ++i) {
+      auto r = db.record(t, i);
+      for (std::size_t j = 0; j < columns.size(); ++j) {
+        if (auto* x = std::get_if<std::int32_t>(&r[columns[j]])) ints[i] = *x;
+        if (auto* x = std::get_if<double>(&r[columns[j]])) doubles[i] = *x;
+      }
+    }
+    ddb::bench::keep(ints.data());
+    return n;
+  });
+  label = std::string{"project ("} + name + ")";
+  extract_all(db, columns, label.c_str(), [&](std::size_t t) {
+    auto n = db.project(t, columns, 0, capacity, buffers);
+    ddb::bench::keep(ints.data());
+    return n;
+  });
+}
+
+}
+
+int main() {
+  compare({ddb::Integer}, {0}, "1 integer column");
+  compare({ddb::Integer, ddb::Float, ddb::Integer, ddb::Float}, {0, 1}, "2 of 4 columns");
+  compare({ddb::Integer, ddb::String, ddb::Float}, {0, 1, 2}, "3 columns, 1 string");
+  return 0;
+}
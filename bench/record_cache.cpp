@@ -0,0 +1,57 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+#include <dummydb_cache.hpp>
+
+#include <random>
+#include <string>
+
+namespace {
+
+/// The number of tables in the benchmarked database.
+constexpr std::size_t table_count = 4096;
+
+/// The number of lookups performed by each benchmark.
+constexpr std::size_t lookup_count = 1 << 22;
+
+/// Looks up the records identified by `ids` with `lookup` and prints the throughput labeled by
+/// `label`.
+template<typename Lookup>
+void lookups(std::vector<ddb::RecordId> const& ids, char const* label, Lookup lookup) {
+  auto s = ddb::bench::Clock::now();
+  for (auto id : ids) {
+    ddb::bench::keep(lookup(id));
+  }
+  ddb::bench::report_throughput(label, ids.size(), ddb::bench::elapsed_ns(s));
+}
+
+}
+
+int main() {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::String, ddb::Float, ddb::String});
+    for (std::int32_t i = 0; i < 64; ++i) {
+      db.insert(t, i, "temperature sensor " + std::to_string(i % 16), 0.5, "degrees celsius " + std::to_string(i % 4));
+    }
+  }
+
+  // Skewed lookups: 90% of them hit 1024 hot records, the others are spread over all records.
+  std::mt19937_64 rng{42};
+  std::vector<ddb::RecordId> hot(1024);
+  for (auto& id : hot) id = db.record_id(rng() % table_count, rng() % 64);
+  std::vector<ddb::RecordId> ids(lookup_count);
+  for (auto& id : ids) {
+    id = ((rng() % 10) != 0) ? hot[rng() % hot.size()] : db.record_id(rng() % table_count, rng() % 64);
+  }
+
+  lookups(ids, "record (decoded)", [&](ddb::RecordId id) { return db.record(id); });
+  for (std::size_t capacity : {1024, 4096, 16384}) {
+    ddb::RecordCache cache{db, capacity};
+    auto label = "record (cache, " + std::to_string(capacity) + ")";
+    lookups(ids, label.c_str(), [&](ddb::RecordId id) { return cache.record(id); });
+    std::printf("%-32s hit ratio %.3f\n", "", cache.usage().hit_ratio());
+    label = "shared_record (cache, " + std::to_string(capacity) + ")";
+    lookups(ids, label.c_str(), [&](ddb::RecordId id) { return cache.shared_record(id); });
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <stdexcept>
+
+namespace {
+
+/// The number of records ingested by each benchmark.
+constexpr std::size_t record_count = 1 << 20;
+
+/// Ingests `record_count` copies of `record` into tables of the given schema, moving to a new
+/// table whenever the current one is full, with the throwing API if `throwing` is `true` or with
+/// the non-throwing one otherwise, and returns the number of rollovers.
+std::size_t ingest(std::vector<ddb::FieldType> const& schema, std::vector<ddb::Value> const& record, bool throwing) {
+  ddb::DummyDB probe{1};
+  auto capacity = probe.record_capacity(probe.create_table(schema));
+  ddb::DummyDB db{(record_count / capacity) + 1};
+
+  auto t = db.create_table(schema);
+  std::size_t rollovers = 0;
+  for (std::size_t i = 0; i < record_count; ++i) {
+    if (throwing) {
+      try {
+        ddb::bench::keep(db.insert(t, record));
+        continue;
+      } catch (std::overflow_error const&) {}
+    } else if (auto r = db.try_insert(t, record)) {
+      ddb::bench::keep(*r);
+      continue;
+    }
+    t = db.create_table(schema);
+    rollovers += 1;
+    db.insert(t, record);
+  }
+  return rollovers;
+}
+
+/// Benchmarks both APIs on records of the given schema.
+void compare(std::vector<ddb::FieldType> const& schema, char const* throwing_label, char const* expected_label) {
+  std::vector<ddb::Value> record(schema.size(), std::int32_t{7});
+
+  auto s = ddb::bench::Clock::now();
+  auto rollovers = ingest(schema, record, true);
+  ddb::bench::report_throughput(throwing_label, record_count, ddb::bench::elapsed_ns(s));
+
+  s = ddb::bench::Clock::now();
+  ingest(schema, record, false);
+  ddb::bench::report_throughput(expected_label, record_count, ddb::bench::elapsed_ns(s));
+  std::printf("%-32s %zu rollovers\n", "", rollovers);
+}
+
+}
+
+int main() {
+  // Narrow records fill a table every ~500 insertions; wide ones every ~15.
+  compare(std::vector<ddb::FieldType>(2, ddb::Integer), "insert (2 fields)", "try_insert (2 fields)");
+  compare(std::vector<ddb::FieldType>(64, ddb::Integer), "insert (64 fields)", "try_insert (64 fields)");
+  return 0;
+}
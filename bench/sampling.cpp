@@ -0,0 +1,67 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+#include <dummydb_sampling.hpp>
+
+#include <numeric>
+#include <random>
+
+namespace {
+
+/// The number of tables in the benchmarked database.
+constexpr std::size_t table_count = 1 << 16;
+
+/// Prints the duration of `compute`, which returns estimates of the sum of a column, labeled by
+/// `label`, along with the estimate and its error relative to `exact`.
+template<typename Compute>
+void measure(char const* label, double exact, Compute compute) {
+  auto s = ddb::bench::Clock::now();
+  ddb::EstimatedSummary e = compute();
+  auto ns = ddb::bench::elapsed_ns(s);
+  std::printf("%-36s %9.3f ms  sum %.4e +/- %.1e (error %+.4f%%)\n",
+    label, ns / 1e6, e.sum.value, e.sum.margin, 100 * (e.sum.value - exact) / exact);
+}
+
+}
+
+int main() {
+  // Tables whose values drift from one table to the next, as when loading data in time order.
+  ddb::DummyDB db{table_count};
+  std::vector<std::size_t> tables(table_count);
+  std::iota(tables.begin(), tables.end(), 0);
+  std::mt19937_64 rng{42};
+  std::normal_distribution<float> noise{0, 10};
+  for (auto t : tables) {
+    db.create_table({ddb::Integer, ddb::Float});
+    for (std::int32_t i = 0; db.try_insert(t, i % 8, static_cast<float>(t % 1000) + noise(rng)); ++i) {}
+  }
+  std::printf("%zu records in %zu tables\n", db.record_count(0) * table_count, table_count);
+
+  ddb::Summary exact;
+  auto s = ddb::bench::Clock::now();
+  for (auto t : tables) exact.merge(db.summarize(t, 1));
+  std::printf("%-36s %9.3f ms  sum %.4e\n", "summarize (exact)", ddb::bench::elapsed_ns(s) / 1e6, exact.sum);
+
+  for (std::size_t n : {1000, 10000}) {
+    auto label = "sample_records (" + std::to_string(n) + ")";
+    measure(label.c_str(), exact.sum, [&] {
+      return ddb::estimate_summary(db, ddb::sample_records(db, tables, n, rng), 1);
+    });
+  }
+  measure("reservoir_sample (10000)", exact.sum, [&] {
+    return ddb::estimate_summary(db, ddb::reservoir_sample(db, tables, 10000, rng), 1);
+  });
+  for (std::size_t n : {64, 512}) {
+    auto label = "sample_tables (" + std::to_string(n) + ")";
+    measure(label.c_str(), exact.sum, [&] {
+      return ddb::estimate_summary(db, ddb::sample_tables(db, tables, n, rng), 1);
+    });
+  }
+  measure("sample_tables (1000, 10 rows each)", exact.sum, [&] {
+    return ddb::estimate_summary(db, ddb::sample_tables(db, tables, 1000, rng, 10), 1);
+  });
+  s = ddb::bench::Clock::now();
+  auto groups = ddb::estimate_groups(db, ddb::sample_records(db, tables, 10000, rng), 0, 1);
+  std::printf("%-36s %9.3f ms  %zu groups\n",
+    "estimate_groups (10000)", ddb::bench::elapsed_ns(s) / 1e6, groups.size());
+  return 0;
+}
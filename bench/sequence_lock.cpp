@@ -0,0 +1,86 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+/// The number of tables in the benchmarked database.
+constexpr std::size_t table_count = 256;
+
+/// The number of records stored in each table.
+constexpr std::size_t record_count = 64;
+
+/// The number of in-place updates made by the writer.
+constexpr std::size_t update_count = 2'000'000;
+
+/// How the writer modifies the database while the readers run.
+enum class Writes { None, OtherTables, SameTables };
+
+/// Returns a record whose fields all derive from `k`.
+std::vector<ddb::Value> make_record(std::int32_t k) {
+  return {k, k, k, k, k, k, static_cast<double>(k), static_cast<double>(k)};
+}
+
+/// Reads the records of the first half of the tables with `reader_count` threads while another
+/// thread updates records in place as described by `writes`, and prints the throughput of the
+/// readers labeled by `label` and that of the writer, if any, labeled by `writer_label`.
+///
+/// Reads of a table being updated retry when they overlap an update, so their throughput drops
+/// with the share of reads that must be repeated rather than because of any lock.
+void read_while_updating(
+  std::size_t reader_count, Writes writes, char const* label, char const* writer_label = nullptr
+) {
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({
+      ddb::Integer, ddb::Integer, ddb::Integer, ddb::Integer, ddb::Integer, ddb::Integer, ddb::Float, ddb::Float
+    });
+    for (std::size_t i = 0; i < record_count; ++i) {
+      db.insert(t, make_record(static_cast<std::int32_t>(i)));
+    }
+  }
+  auto read_tables = table_count / 2;
+
+  std::atomic<bool> done = false;
+  std::atomic<std::size_t> reads = 0;
+  std::vector<std::thread> readers;
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t r = 0; r < reader_count; ++r) {
+    readers.emplace_back([&, r] {
+      std::size_t n = 0;
+      for (std::size_t i = r; !done.load(std::memory_order_relaxed); ++i, ++n) {
+        ddb::bench::keep(db.record(i % read_tables, (i / read_tables) % record_count));
+      }
+      reads.fetch_add(n, std::memory_order_relaxed);
+    });
+  }
+
+  if (writes == Writes::None) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  } else {
+    auto first = (writes == Writes::SameTables) ? 0 : read_tables;
+    auto w = ddb::bench::Clock::now();
+    for (std::size_t i = 0; i < update_count; ++i) {
+      auto t = first + (i % read_tables);
+      db.update(t, (i / read_tables) % record_count, make_record(static_cast<std::int32_t>(i)));
+    }
+    auto ns = ddb::bench::elapsed_ns(w);
+    ddb::bench::report_throughput(writer_label, update_count, ns);
+  }
+  done = true;
+  for (auto& t : readers) t.join();
+  ddb::bench::report_throughput(label, reads.load(), ddb::bench::elapsed_ns(s) * static_cast<double>(reader_count));
+}
+
+}
+
+int main() {
+  auto n = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  std::printf("%u hardware threads, %u readers\n", std::thread::hardware_concurrency(), n);
+  read_while_updating(n, Writes::None, "record (no updates)");
+  read_while_updating(n, Writes::OtherTables, "record (other tables updated)", "update (other tables)");
+  read_while_updating(n, Writes::SameTables, "record (same tables updated)", "update (same tables)");
+  return 0;
+}
@@ -0,0 +1,75 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+#include <dummydb_snapshot.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+/// The number of tables in the benchmarked database (64 MiB of tables).
+constexpr std::size_t table_count = 16384;
+
+/// Inserts `count` records round-robin across the tables of `db`, recording the latency of each
+/// insertion in `latencies`, until `count` records were inserted or `until` returns `true`.
+template<typename Until>
+void insert_round_robin(
+  ddb::DummyDB& db, std::size_t& cursor, std::size_t count, ddb::bench::Latencies& latencies,
+  Until until
+) {
+  for (std::size_t i = 0; (i < count) && !until(); ++i) {
+    auto t = (cursor++) % table_count;
+    auto s = ddb::bench::Clock::now();
+    db.insert(t, {static_cast<std::int32_t>(i), 1});
+    latencies.add(ddb::bench::elapsed_ns(s));
+  }
+}
+
+}
+
+int main() {
+  auto path = (std::filesystem::temp_directory_path() / "dummydb-bench-snapshot.ddb").string();
+
+  ddb::DummyDB db{table_count};
+  for (std::size_t t = 0; t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::Integer});
+  }
+  std::size_t cursor = 0;
+  ddb::bench::Latencies warmup;
+  insert_round_robin(db, cursor, table_count * 100, warmup, [] { return false; });
+
+  // Baseline: no snapshot in progress.
+  ddb::bench::Latencies idle;
+  insert_round_robin(db, cursor, table_count * 8, idle, [] { return false; });
+  idle.report("insert (idle)");
+
+  // Stop-the-world: writes are blocked while the image is being written.
+  {
+    auto s = ddb::bench::Clock::now();
+    std::ofstream output{path, std::ios::binary};
+    db.save(output);
+    output.flush();
+    ddb::bench::Latencies stalled;
+    stalled.add(ddb::bench::elapsed_ns(s));
+    stalled.report("blocking save (stall)");
+  }
+
+  // Copy-on-write: writes continue while a child process saves the image.
+  {
+    ddb::bench::Latencies during;
+    auto s = ddb::bench::Clock::now();
+    ddb::BackgroundSave save{db, path};
+    ddb::bench::Latencies fork;
+    fork.add(ddb::bench::elapsed_ns(s));
+    fork.report("background save (fork)");
+    insert_round_robin(db, cursor, table_count * 8, during, [&] { return save.done(); });
+    during.report("insert (during background save)");
+    if (!save.wait()) {
+      std::fprintf(stderr, "background save failed\n");
+      return 1;
+    }
+  }
+
+  std::filesystem::remove(path);
+  return 0;
+}
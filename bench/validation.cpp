@@ -0,0 +1,65 @@
+#include <dummydb.hpp>
+#include <dummydb_bench.hpp>
+
+#include <random>
+
+namespace {
+
+/// The number of tables in the benchmarked database.
+constexpr std::size_t table_count = 1024;
+
+/// The number of operations performed by each benchmark.
+constexpr std::size_t operation_count = 1 << 22;
+
+/// Inserts records in all the tables of `db` through `handle` and prints the throughput labeled
+/// by `label`.
+template<typename Handle>
+void insertions(ddb::DummyDB& db, Handle handle, char const* label) {
+  for (std::size_t t = db.table_count(); t < table_count; ++t) {
+    db.create_table({ddb::Integer, ddb::Float, ddb::Integer});
+  }
+  auto n = db.record_capacity(0);
+  auto s = ddb::bench::Clock::now();
+  for (std::size_t t = 0; t < table_count; ++t) {
+    for (std::size_t i = db.record_count(t); i < n; ++i) {
+      ddb::bench::keep(handle.insert(t, static_cast<std::int32_t>(i), 0.5, 1));
+    }
+  }
+  ddb::bench::report_throughput(label, table_count * n, ddb::bench::elapsed_ns(s));
+}
+
+/// Looks up the records at `locations` through `handle` and prints the throughput labeled by
+/// `label`.
+template<typename Handle>
+void lookups(Handle handle, std::vector<std::pair<std::size_t, std::size_t>> const& locations, char const* label) {
+  auto s = ddb::bench::Clock::now();
+  for (auto [t, r] : locations) {
+    ddb::bench::keep(handle.record(t, r));
+  }
+  ddb::bench::report_throughput(label, locations.size(), ddb::bench::elapsed_ns(s));
+}
+
+}
+
+int main() {
+  {
+    ddb::DummyDB db{table_count};
+    insertions(db, db.checked(), "insert (checked)");
+  }
+  {
+    ddb::DummyDB db{table_count};
+    insertions(db, db.unchecked(), "insert (unchecked)");
+  }
+
+  ddb::DummyDB db{table_count};
+  insertions(db, db.unchecked(), "insert (setup)");
+  std::mt19937_64 rng{42};
+  std::vector<std::pair<std::size_t, std::size_t>> locations(operation_count);
+  for (auto& l : locations) {
+    l = {rng() % table_count, rng() % db.record_capacity(0)};
+  }
+  lookups(db.checked(), locations, "record (checked)");
+  lookups(db.unchecked(), locations, "record (unchecked)");
+
+  return 0;
+}
@@ -1,20 +1,45 @@
+#pragma once
+
+#include "dummydb_hash.hpp"
+
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
 #include <optional>
+#include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 #include <cstdint>
 #include <stdexcept>
 #include <limits>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace ddb {
 
-/// The size of a table.
+/// The size of a table in the default layout.
 constexpr std::size_t table_size = 4096;
 
-/// The size of a string table.
+/// The size of a string table in the default layout.
 constexpr std::size_t string_table_size = 4096;
 
+/// The size of a cache line, which is the unit of coherence between cores.
+constexpr std::size_t cache_line_size = 64;
+
+/// The tag identifying the images written by `DummyDB::save`.
+constexpr std::uint64_t image_magic = 0x3230304244444d44; // "DMDDB002"
+
 /// A value indicating that a record or string was not found.
 constexpr std::size_t not_found = std::numeric_limits<std::size_t>::max();
 
@@ -26,24 +51,330 @@ enum FieldType : std::uint8_t {
 /// The value of a field.
 using Value = std::variant<std::int32_t, double, std::string>;
 
+/// An integer type all of whose values fit in an `Integer` field, other than `bool` and the
+/// character types, whose values are not meant as numbers.
+template<typename T>
+concept IntegerArgument =
+  std::integral<T> && !std::same_as<T, bool> && !std::same_as<T, char> && !std::same_as<T, wchar_t>
+  && !std::same_as<T, char8_t> && !std::same_as<T, char16_t> && !std::same_as<T, char32_t>
+  && (std::numeric_limits<T>::digits <= std::numeric_limits<std::int32_t>::digits);
+
+/// A type whose values can be passed directly as fields to the variadic overloads of
+/// `DummyDB::insert`: an integer that converts to `std::int32_t` without narrowing for an `Integer`
+/// field, a floating-point number for a `Float` field, or a string for a `String` field.
+template<typename T>
+concept FieldArgument =
+  IntegerArgument<std::remove_cvref_t<T>> || std::floating_point<std::remove_cvref_t<T>>
+  || std::convertible_to<T, std::string_view>;
+
+/// The type of the fields that accept arguments of type `T`.
+template<FieldArgument T>
+constexpr FieldType field_type_of =
+  IntegerArgument<std::remove_cvref_t<T>> ? Integer
+  : std::floating_point<std::remove_cvref_t<T>> ? Float
+  : String;
+
 /// Returns `address` advanced by `byte_offset` bytes.
-void* advanced(void* address, std::size_t byte_offset) {
+inline void* advanced(void* address, std::size_t byte_offset) {
   return static_cast<void*>(static_cast<std::byte*>(address) + byte_offset);
 }
 
 /// Returns `x` rounded up to the nearest multiple of `n`, which is a power of two.
 template<typename N>
-N rounded_up_to_nearest_multiple(N x, N n) {
+constexpr N rounded_up_to_nearest_multiple(N x, N n) {
   auto r = x & (n - 1);
   return (r == 0) ? x : x + (n - r);
 }
 
-/// A collection of tables.
-class DummyDB final {
+/// Summary statistics of the values of a numeric column over a set of records.
+struct Summary {
+
+  /// The number of values.
+  std::size_t count = 0;
+
+  /// The sum of the values.
+  double sum = 0;
+
+  /// The smallest value, or positive infinity if there are none.
+  double min = std::numeric_limits<double>::infinity();
+
+  /// The largest value, or negative infinity if there are none.
+  double max = -std::numeric_limits<double>::infinity();
+
+  /// Returns the arithmetic mean of the values, or NaN if there are none.
+  double mean() const {
+    return (count == 0) ? std::numeric_limits<double>::quiet_NaN() : sum / static_cast<double>(count);
+  }
+
+  /// Accounts for `x`.
+  void add(double x) {
+    count += 1;
+    sum += x;
+    min = std::min(min, x);
+    max = std::max(max, x);
+  }
+
+  /// Accounts for the values summarized by `other`.
+  void merge(Summary const& other) {
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+
+};
+
+/// A buffer receiving the values of a column projected by `DummyDB::project`: 32-bit integers for an
+/// `Integer` column, single- or double-precision numbers for a `Float` column, and views for a
+/// `String` column, which remain valid as long as the database exists.
+using ColumnBuffer = std::variant<
+  std::span<std::int32_t>, std::span<float>, std::span<double>, std::span<std::string_view>
+>;
+
+/// The identity of a record, which designates it for as long as its database exists and encodes
+/// where it is stored: its table, the page of that table, and the slot of that page.
+///
+/// The 64 bits of an identity hold, from the most to the least significant, the table, the page and
+/// the slot, so that decoding takes a shift and a mask per component and identities sort like the
+/// locations of their records. A table currently spans a single page, so pages are always 0.
+class RecordId final {
+private:
+
+  /// The encoded identity.
+  std::uint64_t value;
+
+public:
+
+  /// The number of bits encoding the slot of a record.
+  static constexpr unsigned slot_bits = 20;
+
+  /// The number of bits encoding the page of a record.
+  static constexpr unsigned page_bits = 12;
+
+  /// The number of bits encoding the table of a record.
+  static constexpr unsigned table_bits = 64 - page_bits - slot_bits;
+
+  /// Creates an instance designating no record.
+  constexpr RecordId() : value(std::numeric_limits<std::uint64_t>::max()) {}
+
+  /// Creates an instance designating the record in the given slot of the given page of the given
+  /// table, each of which must be representable in its number of bits.
+  constexpr RecordId(std::size_t table, std::size_t page, std::size_t slot)
+    : value((std::uint64_t{table} << (page_bits + slot_bits)) | (std::uint64_t{page} << slot_bits) | slot) {}
+
+  /// Returns the instance whose encoding is `bits`.
+  static constexpr RecordId from_bits(std::uint64_t bits) {
+    RecordId result;
+    result.value = bits;
+    return result;
+  }
+
+  /// Returns the encoding of this instance.
+  constexpr std::uint64_t bits() const {
+    return value;
+  }
+
+  /// Returns the identity of the table of the record.
+  constexpr std::size_t table() const {
+    return static_cast<std::size_t>(value >> (page_bits + slot_bits));
+  }
+
+  /// Returns the index of the page of the record in its table.
+  constexpr std::size_t page() const {
+    return static_cast<std::size_t>((value >> slot_bits) & ((std::uint64_t{1} << page_bits) - 1));
+  }
+
+  /// Returns the index of the slot of the record in its page.
+  constexpr std::size_t slot() const {
+    return static_cast<std::size_t>(value & ((std::uint64_t{1} << slot_bits) - 1));
+  }
+
+  /// Compares identities by their encodings.
+  friend constexpr auto operator<=>(RecordId, RecordId) = default;
+
+};
+
+/// The memory occupied by a part of a database.
+struct Footprint {
+
+  /// The number of bytes reserved for the part.
+  std::size_t allocated = 0;
+
+  /// The number of bytes holding data.
+  std::size_t used = 0;
+
+  /// Accounts for the memory described by `other`.
+  void merge(Footprint const& other) {
+    allocated += other.allocated;
+    used += other.used;
+  }
+
+};
+
+/// The reason why an operation on a database failed.
+enum class ErrorCode : std::uint8_t {
+
+  /// The database already holds its maximum number of tables.
+  TooManyTables = 1,
+
+  /// The table has no room left for another record.
+  TableFull,
+
+  /// The string table has no room left for another string.
+  StringTableFull
+
+};
+
+/// Returns a description of `e`.
+inline char const* describe(ErrorCode e) {
+  switch (e) {
+    case ErrorCode::TooManyTables: return "not enough space to create a new table";
+    case ErrorCode::TableFull: return "table is full";
+    case ErrorCode::StringTableFull: return "string table is full";
+  }
+  return "unknown error";
+}
+
+/// The outcome of an operation that returns either a value of type `T` or an `ErrorCode`.
+///
+/// This is a minimal counterpart of C++23's `std::expected<T, ErrorCode>`, letting callers treat
+/// expected failures (e.g., a full table triggering a rollover) as ordinary control flow.
+template<typename T>
+class Result final {
+private:
+
+  /// The value, which is meaningful iff `code` is 0.
+  T payload;
+
+  /// The error, or 0 if the operation succeeded.
+  ErrorCode code;
+
+public:
+
+  /// Creates a successful outcome holding `value`.
+  Result(T value) : payload(std::move(value)), code(ErrorCode{0}) {}
+
+  /// Creates a failed outcome describing `error`.
+  Result(ErrorCode error) : payload(), code(error) {}
+
+  /// Returns `true` iff the operation succeeded.
+  bool has_value() const {
+    return code == ErrorCode{0};
+  }
+
+  /// Returns `true` iff the operation succeeded.
+  explicit operator bool() const {
+    return has_value();
+  }
+
+  /// Returns the value of a successful outcome.
+  T const& operator*() const {
+    return payload;
+  }
+
+  /// Returns the value of a successful outcome or throws `std::overflow_error` describing its error.
+  T const& value() const {
+    if (!has_value()) {
+      throw std::overflow_error(describe(code));
+    }
+    return payload;
+  }
+
+  /// Returns the error of a failed outcome.
+  ErrorCode error() const {
+    return code;
+  }
+
+};
+
+/// The validation performed by the operations of a database on their arguments.
+enum class Validation : std::uint8_t {
+
+  /// Identities, records, and strings are checked, and invalid ones are reported by exceptions:
+  /// `std::out_of_range` for identities that do not designate a table, record, column or string,
+  /// and `std::invalid_argument` for records that do not match the schema of their table and for
+  /// strings that cannot be stored.
+  Checked,
+
+  /// Arguments are assumed to be valid, and this assumption is passed on to the optimizer: invalid
+  /// arguments have undefined behavior.
+  Unchecked
+
+};
+
+/// The maximum length of a string stored in a database, whose length is stored in a byte.
+constexpr std::size_t max_string_size = 255;
+
+/// The layout of the storage of a database, which is fixed at compile time.
+///
+/// `TableSize` is the size of each table and hence bounds its number of records: larger tables
+/// amortize their headers and make scans longer, whereas smaller ones waste less memory when
+/// tables are sparse. `StringTableSize` is the size of the string table. `Alignment` is the
+/// alignment of the storage and of every table; with an alignment smaller than a cache line, the
+/// counters of a table may share a cache line with the records of the next one.
+template<
+  std::size_t TableSize = table_size,
+  std::size_t StringTableSize = string_table_size,
+  std::size_t Alignment = cache_line_size
+>
+struct Layout {
+
+  static_assert((Alignment & (Alignment - 1)) == 0, "alignment must be a power of two");
+  static_assert(Alignment >= alignof(std::size_t), "alignment must be at least that of std::size_t");
+  static_assert((TableSize % Alignment) == 0, "table size must be a multiple of the alignment");
+  static_assert(TableSize >= 1024, "table size must leave room for any schema and the counters");
+  static_assert(StringTableSize <= std::numeric_limits<std::uint32_t>::max(),
+    "string identities must fit in a field");
+
+  /// The size of a table.
+  static constexpr std::size_t table_size = TableSize;
+
+  /// The size of the string table.
+  static constexpr std::size_t string_table_size = StringTableSize;
+
+  /// The alignment of the storage and of each table.
+  static constexpr std::size_t alignment = Alignment;
+
+};
+
+template<typename L = Layout<>>
+class BasicDummyDB;
+
+/// A database with the default layout.
+using DummyDB = BasicDummyDB<>;
+
+template<Validation mode, typename Database = DummyDB>
+class Handle;
+
+template<typename Database = DummyDB>
+class BulkLoader;
+
+/// A collection of tables whose storage is laid out according to `L`, an instance of `Layout`.
+///
+/// Operations that modify the database validate their arguments, whereas operations that read it
+/// only check what is cheap to check. Use `checked()` or `unchecked()` to obtain a handle
+/// validating all arguments or none.
+template<typename L>
+class BasicDummyDB final {
+public:
+
+  /// The layout of the storage of this database.
+  using layout = L;
+
+  /// The size of a table.
+  static constexpr std::size_t table_size = L::table_size;
+
+  /// The size of the string table.
+  static constexpr std::size_t string_table_size = L::string_table_size;
+
+  /// The alignment of the storage and of each table.
+  static constexpr std::size_t alignment = L::alignment;
+
 private:
 
-  /// The header of the storage of a database.
-  struct Header {
+  /// The header of the storage of a database, which fills a cache line so that creating a table
+  /// does not invalidate the cache line holding the first strings.
+  struct alignas(cache_line_size) Header {
 
     /// The offset of the header relative to the start of the storage's allocation.
     const std::size_t offset;
@@ -56,18 +387,70 @@ private:
 
   };
 
+  /// The alignment of the storage of a database.
+  static constexpr std::size_t storage_alignment = std::max({alignment, alignof(Header), alignof(Value)});
+
+  /// The offset of the first table relative to the start of the header.
+  static constexpr std::size_t tables_offset =
+    rounded_up_to_nearest_multiple(sizeof(Header) + string_table_size, alignment);
+
   /// The raw data in the database.
   ///
   /// This pointer refers to an instance of `Header` and a tail-allocated byte buffer storing the
   /// contents of the database. Note that this pointer may be offset w.r.t. the dynamic allocation
-  /// performed in the constructor to satisfy the alignment requirements, hence calling `delete[]`
-  /// on this pointer may cause undefined behavior.
+  /// performed in the constructor to satisfy the alignment requirements, hence calling `free` on
+  /// this pointer may cause undefined behavior. This pointer is null after the instance has been
+  /// moved from.
   ///
-  /// Tables are allocated right after the header and have the same alignment. Each table stores a
-  /// header that describes its schema and the number of records that it contains, followed by the
-  /// records themselves.
+  /// The string table is allocated right after the header, followed by the tables, each of which
+  /// is aligned to `alignment` (tables are contiguous since their size is a multiple of the
+  /// alignment). Each table stores its schema, followed by the records themselves, and its
+  /// counters in its last cache line.
   void* data;
 
+  /// The counters of a table, which are updated by every insertion.
+  ///
+  /// Counters are stored in the last cache line of their table, which holds no records, so that
+  /// an insertion does not invalidate the cache lines holding the schema and the records read by
+  /// concurrent lookups and scans.
+  struct TableCounters {
+
+    /// The number of records in the table.
+    std::size_t record_count;
+
+    /// The modification version of the table, which is incremented by every modification of the
+    /// table so that derived data (e.g., cached query results) can be validated cheaply.
+    std::uint64_t version;
+
+    /// The sequence lock of the table, which is odd while records of the table are updated in
+    /// place, so that readers can detect and retry reads that overlap an update without locking.
+    std::uint64_t sequence;
+
+  };
+
+  static_assert(sizeof(TableCounters) <= cache_line_size);
+  static_assert((table_size / sizeof(std::uint32_t)) <= (std::size_t{1} << RecordId::slot_bits),
+    "the slots of a table must be representable in a record identity");
+
+  /// Accesses the counters of the table `t`.
+  static TableCounters& counters(void* t) {
+    return *static_cast<TableCounters*>(advanced(t, table_size - cache_line_size));
+  }
+
+  /// Returns the offset of the first record of a table whose records have `record_width` fields,
+  /// which follows its schema.
+  static constexpr std::size_t records_offset(std::size_t record_width) {
+    return rounded_up_to_nearest_multiple(record_width + 1, alignof(std::uint32_t));
+  }
+
+  /// Returns the maximum number of records with `record_width` fields that a table can hold, or
+  /// `not_found` if records have no field.
+  static constexpr std::size_t capacity_of(std::size_t record_width) {
+    if (record_width == 0) return not_found;
+    auto record_size = record_width * sizeof(std::uint32_t);
+    return (table_size - cache_line_size - records_offset(record_width)) / record_size;
+  }
+
   /// Accesses the header of this database.
   Header& header() const {
     return *static_cast<Header*>(data);
@@ -79,8 +462,8 @@ private:
   }
 
   /// Accesses the table with the given identity.
-  void* table(std::size_t identity) {
-    return advanced(data, sizeof(Header) + string_table_size + (identity * table_size));
+  void* table(std::size_t identity) const {
+    return advanced(data, tables_offset + (identity * table_size));
   }
 
   /// Accesses the string table of this database.
@@ -91,14 +474,12 @@ private:
   /// Returns the total capacity of the database.
   std::size_t capacity() const {
     auto n = header().max_table_count;
-    auto a = std::max(alignof(Header), alignof(Value)) - 1;
-    auto s = a + sizeof(Header) + string_table_size + (n * table_size);
-    return s;
+    return (storage_alignment - 1) + tables_offset + (n * table_size);
   }
 
   /// Returns the offset of `s` in the string table or the position immediately after the last
   /// string in the table.
-  std::size_t string_offset(std::string const& s) const {
+  std::size_t string_offset(std::string_view s) const {
     auto* ss = string_table();
     std::size_t o = 0;
 
@@ -115,17 +496,493 @@ private:
     return o;
   }
 
+  /// Returns the address of the record identified by `record_identity` in the table `t`.
+  static std::uint32_t* record_address(void* t, std::size_t record_identity) {
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    auto record_size = record_width * sizeof(std::uint32_t);
+    auto b = records_offset(record_width) + (record_identity * record_size);
+    return static_cast<std::uint32_t*>(advanced(t, b));
+  }
+
+  /// Returns the address immediately after the storage of this database.
+  void* storage_end() const {
+    return advanced(data, tables_offset + (header().max_table_count * table_size));
+  }
+
+  /// Returns the size of a page of virtual memory.
+  static std::size_t page_size() {
+    static auto const result = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return result;
+  }
+
+  /// Returns the physical memory of the whole pages in [first, last), whose contents are not
+  /// needed, to the operating system and returns the number of bytes released.
+  ///
+  /// Released pages read as zeros and are mapped again when written.
+  static std::size_t release(void* first, void* last) {
+    auto p = page_size();
+    auto a = rounded_up_to_nearest_multiple(reinterpret_cast<std::uintptr_t>(first), p);
+    auto b = reinterpret_cast<std::uintptr_t>(last) & ~(p - 1);
+    if ((b <= a) || (::madvise(reinterpret_cast<void*>(a), b - a, MADV_DONTNEED) != 0)) {
+      return 0;
+    }
+    return b - a;
+  }
+
+  /// Returns the contents of the record whose fields are at address `p`, in the table `t`.
+  std::vector<Value> decode(void* t, std::uint32_t const* p) const {
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    std::vector<Value> result;
+    result.reserve(record_width);
+    for (std::size_t i = 0; i < record_width; ++i) {
+      switch (*static_cast<FieldType*>(advanced(t, i + 1))) {
+        case Integer:
+          result.emplace_back(std::bit_cast<std::int32_t>(*(p++)));
+          continue;
+
+        case Float:
+          result.emplace_back(static_cast<double>(std::bit_cast<float>(*(p++))));
+          continue;
+
+        case String:
+          result.emplace_back(string(*(p++)));
+          continue;
+      }
+    }
+    return result;
+  }
+
+  /// A section during which a single writer updates records of a table in place, making the
+  /// sequence lock of the table odd so that concurrent readers retry.
+  ///
+  /// Fields written in a section must be stored atomically, with relaxed ordering, since readers
+  /// may load them concurrently.
+  class WriteSection final {
+  private:
+
+    /// The sequence lock of the table.
+    std::atomic_ref<std::uint64_t> sequence;
+
+  public:
+
+    /// Starts a section updating the table `t`.
+    explicit WriteSection(void* t) : sequence(counters(t).sequence) {
+      sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /// Ends the section.
+    ~WriteSection() {
+      sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    WriteSection(WriteSection const&) = delete;
+    WriteSection& operator=(WriteSection const&) = delete;
+
+  };
+
+  /// Copies the fields of the record identified by `record_identity` in the table `t` to `output`
+  /// and returns `true`, or returns `false` if the table has no such record.
+  ///
+  /// The fields are loaded atomically between two loads of the sequence lock of the table, and
+  /// loaded again until no update overlapped them, so that the copy is never torn. Appended
+  /// records are published by a release store of the record count, which is loaded within the
+  /// same window.
+  static bool read_fields(void* t, std::size_t record_identity, std::uint32_t* output) {
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    auto& c = counters(t);
+    std::atomic_ref sequence{c.sequence};
+    while (true) {
+      auto before = sequence.load(std::memory_order_acquire);
+      if ((before & 1) != 0) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+        continue;
+      }
+      if (record_identity >= std::atomic_ref{c.record_count}.load(std::memory_order_acquire)) {
+        return false;
+      }
+      auto p = record_address(t, record_identity);
+      for (std::size_t i = 0; i < record_width; ++i) {
+        output[i] = std::atomic_ref{p[i]}.load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence.load(std::memory_order_relaxed) == before) {
+        return true;
+      }
+    }
+  }
+
+  /// Returns the contents of the record identified by `record_identity` in the table `t`, read
+  /// with `read_fields` and validated according to `mode`.
+  template<Validation mode>
+  std::vector<Value> consistent_record(void* t, std::size_t record_identity) const {
+    std::uint32_t fields[std::numeric_limits<std::uint8_t>::max()];
+    require<mode, std::out_of_range>(read_fields(t, record_identity, fields), "no such record");
+    return decode(t, fields);
+  }
+
+  template<Validation, typename>
+  friend class Handle;
+
+  template<typename>
+  friend class BulkLoader;
+
+  /// Throws an exception of type `E` with the given message if `condition` is `false` and `mode`
+  /// is `Checked`, or assumes that `condition` holds otherwise.
+  template<Validation mode, typename E>
+  static void require(bool condition, char const* message) {
+    if constexpr (mode == Validation::Checked) {
+      if (!condition) throw E(message);
+    } else if (!condition) {
+      __builtin_unreachable();
+    }
+  }
+
+  /// Accesses the table identified by `table_identity`, which is validated according to `mode`.
+  template<Validation mode>
+  void* existing_table(std::size_t table_identity) const {
+    require<mode, std::out_of_range>(table_identity < header().table_count, "no such table");
+    return table(table_identity);
+  }
+
+  /// Implements `try_insert` for records given as vectors, validating them according to `mode`.
+  template<Validation mode>
+  Result<std::size_t> insert_values(std::size_t table_identity, std::vector<Value> const& record) {
+    auto t = existing_table<mode>(table_identity);
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    require<mode, std::invalid_argument>(record.size() == record_width,
+      "record does not match the schema of the table");
+    for (std::size_t i = 0; i < record_width; ++i) {
+      require<mode, std::invalid_argument>(record[i].index() == *static_cast<FieldType*>(advanced(t, i + 1)),
+        "record does not match the schema of the table");
+    }
+
+    auto& c = counters(t);
+    if (c.record_count == capacity_of(record_width)) {
+      return ErrorCode::TableFull;
+    }
+
+    // Copy the contents of the record.
+    auto p = record_address(t, c.record_count);
+    for (std::size_t i = 0; i < record_width; ++i) {
+      switch (*static_cast<FieldType*>(advanced(t, i + 1))) {
+        case Integer:
+          *static_cast<std::int32_t*>(static_cast<void*>(p++)) = *std::get_if<Integer>(&record[i]);
+          continue;
+
+        case Float:
+          *static_cast<float*>(static_cast<void*>(p++)) = static_cast<float>(*std::get_if<Float>(&record[i]));
+          continue;
+
+        case String:
+          auto s = insert_bytes<mode>(*std::get_if<String>(&record[i]));
+          if (!s) return s.error();
+          *(p++) = static_cast<std::uint32_t>(*s);
+          continue;
+      }
+    }
+
+    c.version += 1;
+    std::atomic_ref{c.record_count}.store(c.record_count + 1, std::memory_order_release);
+    return c.record_count - 1;
+  }
+
+  /// Implements `try_insert` for records given as separate fields, validating them according to
+  /// `mode`.
+  template<Validation mode, typename... Args>
+  Result<std::size_t> insert_fields(std::size_t table_identity, Args&&... fields) {
+    auto t = existing_table<mode>(table_identity);
+    auto schema = static_cast<FieldType const*>(t);
+    std::size_t i = 0;
+    require<mode, std::invalid_argument>(
+      (schema[0] == sizeof...(Args)) && ((schema[1 + i++] == field_type_of<Args>) && ...),
+      "record does not match the schema of the table");
+
+    constexpr auto record_width = sizeof...(Args);
+    constexpr auto record_size = record_width * sizeof(std::uint32_t);
+    constexpr auto first = records_offset(record_width);
+    auto& c = counters(t);
+    if (c.record_count == capacity_of(record_width)) {
+      return ErrorCode::TableFull;
+    }
+
+    // Copy the fields, stopping at the first string that does not fit in the string table.
+    auto p = static_cast<std::uint32_t*>(advanced(t, first + (c.record_count * record_size)));
+    auto failure = ErrorCode{0};
+    auto write = [&]<typename T>(T&& x) {
+      if constexpr (field_type_of<T> == Integer) {
+        *static_cast<std::int32_t*>(static_cast<void*>(p++)) = static_cast<std::int32_t>(x);
+      } else if constexpr (field_type_of<T> == Float) {
+        *static_cast<float*>(static_cast<void*>(p++)) = static_cast<float>(x);
+      } else {
+        auto s = insert_bytes<mode>(std::string_view{x});
+        if (!s) {
+          failure = s.error();
+          return false;
+        }
+        *(p++) = static_cast<std::uint32_t>(*s);
+      }
+      return true;
+    };
+    if (!(write(std::forward<Args>(fields)) && ...)) {
+      return failure;
+    }
+
+    c.version += 1;
+    std::atomic_ref{c.record_count}.store(c.record_count + 1, std::memory_order_release);
+    return c.record_count - 1;
+  }
+
+  /// Implements `append_encoded` for `fields` that make up whole records and whose string
+  /// identities are those of stored strings, e.g., as returned by `insert_strings`.
+  std::size_t append_fields(std::size_t table_identity, std::span<std::uint32_t const> fields) {
+    auto t = table(table_identity);
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    auto& c = counters(t);
+    auto n = std::min(fields.size() / record_width, capacity_of(record_width) - c.record_count);
+    if (n == 0) return 0;
+    std::memcpy(record_address(t, c.record_count), fields.data(), n * record_width * sizeof(std::uint32_t));
+    c.version += 1;
+    std::atomic_ref{c.record_count}.store(c.record_count + n, std::memory_order_release);
+    return n;
+  }
+
+  /// Implements `try_insert_string`, validating `s` according to `mode`.
+  template<Validation mode>
+  Result<std::size_t> insert_bytes(std::string_view s) {
+    // An empty string would be indistinguishable from the end of the string table.
+    require<mode, std::invalid_argument>(!s.empty(), "empty strings cannot be stored");
+    require<mode, std::invalid_argument>(s.size() <= max_string_size, "string is too long");
+    auto o = string_offset(s);
+    if ((o < string_table_size) && (string_table()[o] != 0)) {
+      return o;
+    } else if ((o + 1 + s.size()) > string_table_size) {
+      return ErrorCode::StringTableFull;
+    } else {
+      auto* ss = string_table();
+      reinterpret_cast<unsigned char*>(ss)[o] = static_cast<unsigned char>(s.size());
+      std::copy(std::begin(s), std::end(s), ss + o + 1);
+      return o;
+    }
+  }
+
+  /// Implements `record`, validating the identities according to `mode`.
+  template<Validation mode>
+  std::vector<Value> read_record(std::size_t table_identity, std::size_t record_identity) const {
+    return consistent_record<mode>(existing_table<mode>(table_identity), record_identity);
+  }
+
+  /// Implements `record` for `id`, validating it according to `mode`.
+  template<Validation mode>
+  std::vector<Value> read_record(RecordId id) const {
+    return consistent_record<mode>(existing_table<mode>(id.table()), position<mode>(id));
+  }
+
+  /// Implements `row_number`, validating the table of `id` according to `mode`.
+  template<Validation mode>
+  std::size_t position(RecordId id) const {
+    auto c = capacity_of(*static_cast<std::uint8_t*>(existing_table<mode>(id.table())));
+    return (id.page() * c) + id.slot();
+  }
+
+  /// Implements `summarize`, validating the table and the column according to `mode`.
+  template<Validation mode>
+  Summary summarize_column(std::size_t table_identity, std::size_t column) const {
+    auto t = existing_table<mode>(table_identity);
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    require<mode, std::out_of_range>(column < record_width, "no such column");
+
+    Summary result;
+    auto n = record_count(table_identity);
+    auto p = record_address(t, 0) + column;
+    switch (*static_cast<FieldType*>(advanced(t, column + 1))) {
+      case Integer:
+        for (std::size_t i = 0; i < n; ++i, p += record_width) {
+          result.add(*static_cast<std::int32_t*>(static_cast<void*>(p)));
+        }
+        return result;
+
+      case Float:
+        for (std::size_t i = 0; i < n; ++i, p += record_width) {
+          result.add(*static_cast<float*>(static_cast<void*>(p)));
+        }
+        return result;
+
+      default:
+        require<mode, std::invalid_argument>(false, "column is not numeric");
+        return result;
+    }
+  }
+
+  /// Implements `string`, validating `id` according to `mode`.
+  template<Validation mode>
+  std::string read_string(std::size_t id) const {
+    if constexpr (mode == Validation::Checked) {
+      // Identities are the offsets of the strings, so walk the table to check that `id` is one.
+      auto* ss = reinterpret_cast<unsigned char const*>(string_table());
+      std::size_t o = 0;
+      while ((o < id) && (ss[o] != 0)) o += 1 + static_cast<std::size_t>(ss[o]);
+      require<mode, std::out_of_range>((o == id) && (o < string_table_size) && (ss[o] != 0), "no such string");
+    }
+    auto* ss = string_table();
+    auto n = static_cast<std::size_t>(reinterpret_cast<unsigned char*>(ss)[id]);
+    return std::string{ss + id + 1, n};
+  }
+
+  /// Writes `convert(p[i * Stride])` to `output[i]` for each `i` in [0, n).
+  ///
+  /// The stride is a constant so that the compiler can turn the loop into vector shuffles.
+  template<std::size_t Stride, typename T, typename Convert>
+  static void copy_strided(std::uint32_t const* p, std::size_t n, T* output, Convert convert) {
+    for (std::size_t i = 0; i < n; ++i) {
+      output[i] = convert(p[i * Stride]);
+    }
+  }
+
+  /// Writes `convert(p[i * stride])` to `output[i]` for each `i` in [0, n), dispatching to a copy
+  /// specialized for the common strides.
+  template<typename T, typename Convert>
+  static void copy_column(std::uint32_t const* p, std::size_t stride, std::size_t n, T* output, Convert convert) {
+    switch (stride) {
+      case 1: return copy_strided<1>(p, n, output, convert);
+      case 2: return copy_strided<2>(p, n, output, convert);
+      case 3: return copy_strided<3>(p, n, output, convert);
+      case 4: return copy_strided<4>(p, n, output, convert);
+      case 8: return copy_strided<8>(p, n, output, convert);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      output[i] = convert(p[i * stride]);
+    }
+  }
+
+  /// Copies the `n` values of the column whose type is `type` starting at `p` in a table whose
+  /// records have `record_width` fields to `output`, throwing `std::invalid_argument` if `output`
+  /// cannot receive them.
+  void project_column(
+    FieldType type, std::uint32_t const* p, std::size_t record_width, std::size_t n, ColumnBuffer const& output
+  ) const {
+    auto as_float = [](std::uint32_t x) { return std::bit_cast<float>(x); };
+    if (auto o = std::get_if<std::span<std::int32_t>>(&output); o && (type == Integer)) {
+      require<Validation::Checked, std::invalid_argument>(o->size() >= n, "buffer is too small");
+      if (record_width == 1) {
+        std::memcpy(o->data(), p, n * sizeof(std::uint32_t));
+      } else {
+        copy_column(p, record_width, n, o->data(), [](std::uint32_t x) { return std::bit_cast<std::int32_t>(x); });
+      }
+    } else if (auto o = std::get_if<std::span<float>>(&output); o && (type == Float)) {
+      require<Validation::Checked, std::invalid_argument>(o->size() >= n, "buffer is too small");
+      if (record_width == 1) {
+        std::memcpy(o->data(), p, n * sizeof(std::uint32_t));
+      } else {
+        copy_column(p, record_width, n, o->data(), as_float);
+      }
+    } else if (auto o = std::get_if<std::span<double>>(&output); o && (type == Float)) {
+      require<Validation::Checked, std::invalid_argument>(o->size() >= n, "buffer is too small");
+      copy_column(p, record_width, n, o->data(), [&](std::uint32_t x) { return static_cast<double>(as_float(x)); });
+    } else if (auto o = std::get_if<std::span<std::string_view>>(&output); o && (type == String)) {
+      require<Validation::Checked, std::invalid_argument>(o->size() >= n, "buffer is too small");
+      auto* ss = string_table();
+      copy_column(p, record_width, n, o->data(), [&](std::uint32_t x) {
+        return std::string_view{ss + x + 1, static_cast<unsigned char>(ss[x])};
+      });
+    } else {
+      throw std::invalid_argument("buffer does not match the type of the column");
+    }
+  }
+
+  /// The number of lookups whose cache misses are overlapped by `gather`.
+  static constexpr std::size_t gather_group_size = 16;
+
+  /// Returns the contents of the `n` records whose locations are given by `locate(i)` for each `i`
+  /// in [0, n), in order.
+  ///
+  /// Lookups are processed by groups of `gather_group_size`. The headers of the tables of a group
+  /// are prefetched first, then the records themselves, whose address depends on the schema stored
+  /// in the header, and finally the records are decoded.
+  template<typename Locate>
+  std::vector<std::vector<Value>> gather(std::size_t n, Locate locate) const {
+    std::vector<std::vector<Value>> result(n);
+    void* tables[gather_group_size];
+    std::uint32_t* records[gather_group_size];
+
+    for (std::size_t g = 0; g < n; g += gather_group_size) {
+      auto m = std::min(gather_group_size, n - g);
+      for (std::size_t i = 0; i < m; ++i) {
+        tables[i] = table(locate(g + i).first);
+        __builtin_prefetch(tables[i]);
+      }
+      for (std::size_t i = 0; i < m; ++i) {
+        records[i] = record_address(tables[i], locate(g + i).second);
+        __builtin_prefetch(records[i]);
+      }
+      for (std::size_t i = 0; i < m; ++i) {
+        result[g + i] = consistent_record<Validation::Unchecked>(tables[i], locate(g + i).second);
+      }
+    }
+    return result;
+  }
+
+  /// The fixed-size prefix of an image written by `save`.
+  struct ImagePreamble {
+
+    /// The tag identifying the image; always `image_magic`.
+    std::uint64_t magic;
+
+    /// The size of a table in the image.
+    std::uint64_t table_size;
+
+    /// The size of the string table in the image.
+    std::uint64_t string_table_size;
+
+    /// The maximum number of tables that the database can hold.
+    std::uint64_t max_table_count;
+
+    /// The number of tables in the database.
+    std::uint64_t table_count;
+
+  };
+
+  /// Reads the preamble of an image from `input` and checks that it is compatible with this build.
+  static ImagePreamble read_preamble(std::istream& input) {
+    ImagePreamble p{};
+    input.read(reinterpret_cast<char*>(&p), sizeof(ImagePreamble));
+    if (!input || (p.magic != image_magic)) {
+      throw std::runtime_error("invalid database image");
+    } else if ((p.table_size != table_size) || (p.string_table_size != string_table_size)) {
+      throw std::runtime_error("incompatible database image");
+    } else if (p.table_count > p.max_table_count) {
+      throw std::runtime_error("corrupted database image");
+    }
+    return p;
+  }
+
+  /// Creates an instance from the contents of the image whose preamble is `p` and whose remaining
+  /// bytes are read from `input`.
+  BasicDummyDB(ImagePreamble const& p, std::istream& input) : BasicDummyDB(p.max_table_count) {
+    auto read = [&](void* destination, std::size_t count) {
+      input.read(static_cast<char*>(destination), static_cast<std::streamsize>(count));
+      return input.gcount() == static_cast<std::streamsize>(count);
+    };
+    if (!read(string_table(), string_table_size) || !read(table(0), p.table_count * table_size)) {
+      throw std::runtime_error("truncated database image");
+    }
+    header().table_count = p.table_count;
+  }
+
 public:
 
   /// Creates an instance capable of containing up to `max_table_count` tables.
-  DummyDB(std::size_t max_table_count) : data(nullptr) {
+  BasicDummyDB(std::size_t max_table_count) : data(nullptr) {
     // Allocate enough memory to store the header and the tables.
-    auto a = std::max(alignof(Header), alignof(Value)) - 1;
-    auto s = a + sizeof(Header) + string_table_size + (max_table_count * table_size);
+    auto a = storage_alignment - 1;
+    auto s = a + tables_offset + (max_table_count * table_size);
 
-    // Compute the offset of the header to satisfy alignment requirements.
-    auto d = new std::byte[s];
-    std::fill(d, d + s, std::byte{0});
+    // Compute the offset of the header to satisfy alignment requirements. Large allocations are
+    // mapped from zero pages, so the tables that are never used cost no memory.
+    auto d = static_cast<std::byte*>(std::calloc(s, 1));
+    if (d == nullptr) throw std::bad_alloc();
 
     // Assign `data` to the start of the header.
     auto header_offset = -(reinterpret_cast<std::uintptr_t>(d) & a) & a;
@@ -133,10 +990,51 @@ public:
     new(data) Header{header_offset, max_table_count, 0};
   }
 
-  ~DummyDB() {
+  /// Creates an instance from an image written by `save`.
+  explicit BasicDummyDB(std::istream& input) : BasicDummyDB(read_preamble(input), input) {}
+
+  /// Creates an instance taking the contents of `other`, which can only be destroyed or assigned
+  /// afterward.
+  BasicDummyDB(BasicDummyDB&& other) noexcept : data(std::exchange(other.data, nullptr)) {}
+
+  /// Databases are not copied implicitly; use `clone` instead.
+  BasicDummyDB(BasicDummyDB const&) = delete;
+
+  ~BasicDummyDB() {
+    if (data == nullptr) return;
     auto h = static_cast<Header*>(data);
-    auto d = static_cast<std::byte*>(data) - h->offset;
-    delete[] d;
+    std::free(static_cast<std::byte*>(data) - h->offset);
+  }
+
+  /// Exchanges the contents of this instance with those of `other`.
+  BasicDummyDB& operator=(BasicDummyDB&& other) noexcept {
+    std::swap(data, other.data);
+    return *this;
+  }
+
+  /// Databases are not copied implicitly; use `clone` instead.
+  BasicDummyDB& operator=(BasicDummyDB const&) = delete;
+
+  /// Returns a copy of this database, with the same capacity.
+  ///
+  /// Only the strings and the tables that have been created are copied, each with a single
+  /// `memcpy`; the storage of the other tables is mapped lazily, as in a new database.
+  BasicDummyDB clone() const {
+    BasicDummyDB result{max_table_count()};
+    std::memcpy(result.string_table(), string_table(), string_table_usage());
+    std::memcpy(result.table(0), table(0), table_count() * table_size);
+    result.header().table_count = table_count();
+    return result;
+  }
+
+  /// Returns a handle on this database validating all the arguments of its operations.
+  Handle<Validation::Checked, BasicDummyDB> checked() {
+    return Handle<Validation::Checked, BasicDummyDB>{*this};
+  }
+
+  /// Returns a handle on this database validating none of the arguments of its operations.
+  Handle<Validation::Unchecked, BasicDummyDB> unchecked() {
+    return Handle<Validation::Unchecked, BasicDummyDB>{*this};
   }
 
   /// Returns the maximum number of tables that the database can hold.
@@ -149,11 +1047,30 @@ public:
     return header().table_count;
   }
 
+  /// Returns the modification version of the table identified by `table_identity`.
+  ///
+  /// The version changes whenever the contents of the table change, so a result computed from the
+  /// table is still valid if the version of the table has not changed since it was computed.
+  std::uint64_t version(std::size_t table_identity) const {
+    return counters(table(table_identity)).version;
+  }
+
   /// Creates a new table with the given scheme and returns its identity.
   std::size_t create_table(std::vector<FieldType> const& schema) {
+    return try_create_table(schema).value();
+  }
+
+  /// Creates a new table with the given scheme and returns its identity, or returns
+  /// `ErrorCode::TooManyTables` if the database cannot hold another table.
+  ///
+  /// Throws `std::invalid_argument` if the schema has more than 255 fields.
+  Result<std::size_t> try_create_table(std::vector<FieldType> const& schema) {
+    if (schema.size() > std::numeric_limits<std::uint8_t>::max()) {
+      throw std::invalid_argument("schema has too many fields");
+    }
     Header& h = header();
     if (h.table_count == h.max_table_count) {
-      throw std::overflow_error("not enough space to create a new table");
+      return ErrorCode::TooManyTables;
     }
 
     auto t = table(h.table_count);
@@ -166,80 +1083,290 @@ public:
     }
 
     // Update the table count, expecting that `h` be a mutable reference on the header.
+    counters(t).version += 1;
     return h.table_count++;
   }
 
-  /// Inserts `record` in the table identified by `table_identity` and returns its identity.
-  std::size_t insert(std::size_t table_identity, std::vector<Value> const& record) {
-    auto t = table(table_identity);
-    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
-    auto record_size = record_width * sizeof(std::uint32_t);
-    auto table_header = rounded_up_to_nearest_multiple(record_width + 1, alignof(std::size_t));
+  /// Creates a new table holding a copy of the table identified by `table_identity` in `source`
+  /// and returns its identity.
+  std::size_t copy_table(BasicDummyDB const& source, std::size_t table_identity) {
+    return try_copy_table(source, table_identity).value();
+  }
 
-    auto n = static_cast<std::size_t*>(advanced(t, table_header));
-    auto b = table_header + sizeof(std::size_t) + ((*n) * record_size);
-    if ((b + record_size) > table_size) {
-      throw std::overflow_error("table is full");
+  /// Creates a new table holding a copy of the table identified by `table_identity` in `source`
+  /// and returns its identity, or returns `ErrorCode::TooManyTables` or
+  /// `ErrorCode::StringTableFull` if there is no room for it.
+  ///
+  /// The schema and the records are copied with a single `memcpy`. The strings of the records are
+  /// then inserted in the string table of this database, unless it starts with that of `source`
+  /// (e.g., if this database is a clone of `source`), in which case identities are kept as is.
+  /// Throws `std::out_of_range` if there is no such table.
+  Result<std::size_t> try_copy_table(BasicDummyDB const& source, std::size_t table_identity) {
+    auto s = source.existing_table<Validation::Checked>(table_identity);
+    Header& h = header();
+    if (h.table_count == h.max_table_count) {
+      return ErrorCode::TooManyTables;
     }
 
-    // Copy the contents of the record.
-    auto p = static_cast<std::uint32_t*>(advanced(t, b));
-    for (std::size_t i = 0; i < record_width; ++i) {
-      switch (*static_cast<FieldType*>(advanced(t, i + 1))) {
-        case Integer:
-          *static_cast<std::int32_t*>(static_cast<void*>(p++)) = std::get<0>(record[i]);
-          continue;
-
-        case Float:
-          *static_cast<double*>(static_cast<void*>(p++)) = std::get<1>(record[i]);
-          continue;
+    auto t = table(h.table_count);
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(s));
+    auto n = counters(s).record_count;
+    std::memcpy(t, s, records_offset(record_width) + (n * record_width * sizeof(std::uint32_t)));
+    counters(t) = counters(s);
+    counters(t).version += 1;
 
-        case String:
-          auto s = insert_string(std::get<2>(record[i]));
-          *(p++) = static_cast<std::uint32_t>(s);
-          continue;
+    auto used = source.string_table_usage();
+    if (std::memcmp(string_table(), source.string_table(), used) != 0) {
+      // Translate the identities of the strings, each of which is looked up once.
+      HashMap<std::uint32_t, std::uint32_t> identities;
+      auto schema = static_cast<FieldType const*>(s) + 1;
+      for (std::size_t c = 0; c < record_width; ++c) {
+        if (schema[c] != String) continue;
+        auto p = record_address(t, 0) + c;
+        for (std::size_t i = 0; i < n; ++i, p += record_width) {
+          auto [j, inserted] = identities.try_emplace(*p);
+          if (inserted) {
+            auto* ss = source.string_table();
+            auto k = insert_bytes<Validation::Unchecked>({ss + *p + 1, static_cast<unsigned char>(ss[*p])});
+            if (!k) {
+              // Leave the storage of the table as it would be if it had never been used.
+              std::memset(t, 0, table_size);
+              return k.error();
+            }
+            *j = static_cast<std::uint32_t>(*k);
+          }
+          *p = *j;
+        }
       }
     }
 
-    return (*n)++;
+    return h.table_count++;
   }
 
-  /// Returns the contents of the record identified by `record_identity`, which is stored in the
-  /// table identified by `table_identity`.
-  std::vector<Value> record(std::size_t table_identity, std::size_t record_identity) {
+  /// Returns the schema of the table identified by `table_identity`.
+  std::vector<FieldType> schema(std::size_t table_identity) const {
+    auto t = static_cast<FieldType const*>(table(table_identity));
+    auto record_width = static_cast<std::size_t>(t[0]);
+    return std::vector<FieldType>(t + 1, t + 1 + record_width);
+  }
+
+  /// Returns the maximum number of records that the table identified by `table_identity` can hold.
+  std::size_t record_capacity(std::size_t table_identity) const {
     auto t = table(table_identity);
     auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
-    auto record_size = record_width * sizeof(std::uint32_t);
-    auto table_header = rounded_up_to_nearest_multiple(record_width + 1, alignof(std::size_t));
+    return capacity_of(record_width);
+  }
 
-    auto b = table_header + sizeof(std::size_t) + (record_identity * record_size);
-    auto p = static_cast<std::uint32_t*>(advanced(t, b));
+  /// Returns the number of records in the table identified by `table_identity`.
+  std::size_t record_count(std::size_t table_identity) const {
+    return std::atomic_ref{counters(table(table_identity)).record_count}.load(std::memory_order_acquire);
+  }
 
-    std::vector<Value> result;
-    result.reserve(record_width);
+  /// Returns summary statistics of the values of the column at index `column` of the table
+  /// identified by `table_identity`, which must be an `Integer` or a `Float` column.
+  ///
+  /// The values are read in place, without materializing the records that contain them.
+  Summary summarize(std::size_t table_identity, std::size_t column) const {
+    return summarize_column<Validation::Checked>(table_identity, column);
+  }
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity.
+  std::size_t insert(std::size_t table_identity, std::vector<Value> const& record) {
+    return try_insert(table_identity, record).value();
+  }
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity, or
+  /// returns `ErrorCode::TableFull` or `ErrorCode::StringTableFull` if there is no room for it.
+  ///
+  /// Throws `std::out_of_range` if there is no such table and `std::invalid_argument` if `record`
+  /// does not match the schema of the table. Strings of the record that fit in the string table
+  /// remain there if the insertion fails.
+  Result<std::size_t> try_insert(std::size_t table_identity, std::vector<Value> const& record) {
+    return insert_values<Validation::Checked>(table_identity, record);
+  }
+
+  /// Inserts a record whose fields are `fields` in the table identified by `table_identity` and
+  /// returns its identity.
+  ///
+  /// This overload writes the fields directly into the table, without building a vector of values
+  /// or copying strings. Throws `std::invalid_argument` if the types of the fields do not match the
+  /// schema of the table.
+  template<FieldArgument... Args>
+    requires (sizeof...(Args) > 0)
+  std::size_t insert(std::size_t table_identity, Args&&... fields) {
+    return try_insert(table_identity, std::forward<Args>(fields)...).value();
+  }
+
+  /// Inserts a record whose fields are `fields` in the table identified by `table_identity` and
+  /// returns its identity, or returns `ErrorCode::TableFull` or `ErrorCode::StringTableFull` if
+  /// there is no room for it.
+  ///
+  /// Throws `std::invalid_argument` if the types of the fields do not match the schema of the table.
+  template<FieldArgument... Args>
+    requires (sizeof...(Args) > 0)
+  Result<std::size_t> try_insert(std::size_t table_identity, Args&&... fields) {
+    return insert_fields<Validation::Checked>(table_identity, std::forward<Args>(fields)...);
+  }
+
+  /// Inserts a record whose fields are the elements of the tuple-like `fields` (e.g., a
+  /// `std::tuple`, a `std::pair`, or a `std::array`) in the table identified by `table_identity`
+  /// and returns its identity.
+  template<typename Tuple>
+  std::size_t emplace(std::size_t table_identity, Tuple&& fields) {
+    return std::apply([&](auto&&... xs) {
+      return insert(table_identity, std::forward<decltype(xs)>(xs)...);
+    }, std::forward<Tuple>(fields));
+  }
+
+  /// Replaces the contents of the record identified by `record_identity`, which is stored in the
+  /// table identified by `table_identity`, with `record`.
+  void update(std::size_t table_identity, std::size_t record_identity, std::vector<Value> const& record) {
+    try_update(table_identity, record_identity, record).value();
+  }
+
+  /// Replaces the contents of the record identified by `record_identity`, which is stored in the
+  /// table identified by `table_identity`, with `record` and returns its identity, or returns
+  /// `ErrorCode::StringTableFull` if a string of `record` does not fit in the string table, in
+  /// which case the record is left unchanged.
+  ///
+  /// The strings of `record` are interned first, then its fields are stored within a write section
+  /// of the sequence lock of the table, so that concurrent calls to `record` and `multi_get` retry
+  /// rather than return a mix of old and new fields. Updates must not run concurrently with each
+  /// other or with insertions in the same database. Throws `std::out_of_range` if there is no such
+  /// table or record, and `std::invalid_argument` if the record does not match the schema of the
+  /// table.
+  Result<std::size_t> try_update(
+    std::size_t table_identity, std::size_t record_identity, std::vector<Value> const& record
+  ) {
+    auto t = existing_table<Validation::Checked>(table_identity);
+    require<Validation::Checked, std::out_of_range>(record_identity < record_count(table_identity),
+      "no such record");
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    require<Validation::Checked, std::invalid_argument>(record.size() == record_width,
+      "record does not match the schema of the table");
+
+    std::uint32_t fields[std::numeric_limits<std::uint8_t>::max()];
     for (std::size_t i = 0; i < record_width; ++i) {
-      switch (*static_cast<FieldType*>(advanced(t, i + 1))) {
+      auto type = *static_cast<FieldType*>(advanced(t, i + 1));
+      require<Validation::Checked, std::invalid_argument>(record[i].index() == type,
+        "record does not match the schema of the table");
+      switch (type) {
         case Integer:
-          result.emplace_back(*static_cast<std::int32_t*>(static_cast<void*>(p++)));
+          fields[i] = std::bit_cast<std::uint32_t>(*std::get_if<Integer>(&record[i]));
           continue;
 
         case Float:
-          result.emplace_back(*static_cast<double*>(static_cast<void*>(p++)));
+          fields[i] = std::bit_cast<std::uint32_t>(static_cast<float>(*std::get_if<Float>(&record[i])));
           continue;
 
         case String:
-          auto s = *static_cast<std::uint32_t*>(static_cast<void*>(p++));
-          result.emplace_back(string(s));
+          auto s = insert_bytes<Validation::Checked>(*std::get_if<String>(&record[i]));
+          if (!s) return s.error();
+          fields[i] = static_cast<std::uint32_t>(*s);
           continue;
       }
     }
 
-    return result;
+    WriteSection section{t};
+    auto p = record_address(t, record_identity);
+    for (std::size_t i = 0; i < record_width; ++i) {
+      std::atomic_ref{p[i]}.store(fields[i], std::memory_order_relaxed);
+    }
+    counters(t).version += 1;
+    return record_identity;
+  }
+
+  /// Returns the contents of the record identified by `record_identity`, which is stored in the
+  /// table identified by `table_identity`.
+  std::vector<Value> record(std::size_t table_identity, std::size_t record_identity) const {
+    return consistent_record<Validation::Unchecked>(table(table_identity), record_identity);
+  }
+
+  /// Returns the contents of the record identified by `id`.
+  std::vector<Value> record(RecordId id) const {
+    return read_record<Validation::Unchecked>(id);
+  }
+
+  /// Returns the identity of the record at position `row` in the table identified by
+  /// `table_identity`.
+  ///
+  /// Throws `std::out_of_range` if there is no such record.
+  RecordId record_id(std::size_t table_identity, std::size_t row) const {
+    auto t = existing_table<Validation::Checked>(table_identity);
+    require<Validation::Checked, std::out_of_range>(row < counters(t).record_count, "no such record");
+    auto c = capacity_of(*static_cast<std::uint8_t*>(t));
+    return RecordId{table_identity, row / c, row % c};
+  }
+
+  /// Returns the position of the record identified by `id` in its table.
+  std::size_t row_number(RecordId id) const {
+    return position<Validation::Unchecked>(id);
+  }
+
+  /// Returns the contents of the records identified by `record_identities`, which are stored in the
+  /// table identified by `table_identity`, in the same order.
+  ///
+  /// This method is equivalent to calling `record` for each identity but overlaps the cache misses
+  /// of several lookups: records are processed in groups whose memory is prefetched in stages, so
+  /// that the latency of a miss is hidden behind the misses of the other lookups of its group.
+  std::vector<std::vector<Value>> multi_get(
+    std::size_t table_identity, std::span<std::size_t const> record_identities
+  ) const {
+    return gather(record_identities.size(), [&](std::size_t i) {
+      return std::pair{table_identity, record_identities[i]};
+    });
+  }
+
+  /// Returns the contents of the records identified by `locations`, which are pairs whose first
+  /// element identifies a table and second element identifies a record in that table, in the same
+  /// order.
+  ///
+  /// This method is equivalent to calling `record` for each location but overlaps the cache misses
+  /// of several lookups, which is most effective when locations are spread over many tables.
+  std::vector<std::vector<Value>> multi_get(
+    std::span<std::pair<std::size_t, std::size_t> const> locations
+  ) const {
+    return gather(locations.size(), [&](std::size_t i) { return locations[i]; });
+  }
+
+  /// Returns the contents of the records identified by `ids`, in the same order, overlapping the
+  /// cache misses of several lookups like the other overloads.
+  std::vector<std::vector<Value>> multi_get(std::span<RecordId const> ids) const {
+    return gather(ids.size(), [&](std::size_t i) { return std::pair{ids[i].table(), row_number(ids[i])}; });
+  }
+
+  /// Copies the values of the columns at indices `columns` of the records of the table identified by
+  /// `table_identity` whose identities are in [first, first + count) to the buffers `outputs`, in
+  /// the same order as `columns`, and returns the number of records copied, which is smaller than
+  /// `count` if the table has fewer records.
+  ///
+  /// Values are copied column by column, with `memcpy` for tables with one field and with loops
+  /// specialized for the stride of the records otherwise, so exporting columns to numeric code
+  /// runs at memory speed without materializing records. Throws `std::out_of_range` if there is
+  /// no such table or column and `std::invalid_argument` if a buffer is too small or does not
+  /// match the type of its column.
+  std::size_t project(
+    std::size_t table_identity, std::span<std::size_t const> columns,
+    std::size_t first, std::size_t count, std::span<ColumnBuffer const> outputs
+  ) const {
+    auto t = existing_table<Validation::Checked>(table_identity);
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    require<Validation::Checked, std::invalid_argument>(columns.size() == outputs.size(),
+      "there must be one buffer per column");
+    auto m = counters(t).record_count;
+    auto n = (first < m) ? std::min(count, m - first) : 0;
+    auto schema = static_cast<FieldType const*>(t) + 1;
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+      require<Validation::Checked, std::out_of_range>(columns[i] < record_width, "no such column");
+      auto p = record_address(t, first) + columns[i];
+      project_column(schema[columns[i]], p, record_width, n, outputs[i]);
+    }
+    return n;
   }
 
   /* Returns the identity of the string `s` if it is in this database or the maximum representable
   value of `std::size_t` otherwise. */
-  std::size_t find_string(std::string const& s) const {
+  std::size_t find_string(std::string_view s) const {
     auto o = string_offset(s);
     if ((o < string_table_size) && (string_table()[o] != 0)) {
       return o;
@@ -249,25 +1376,335 @@ public:
   }
 
   /// Inserts `s` in this database if it wasn't already and returns its identity.
-  std::size_t insert_string(std::string const& s) {
-    auto o = string_offset(s);
-    if ((o < string_table_size) && (string_table()[o] != 0)) {
-      return o;
-    } else if ((o + 1 + s.size()) > capacity()) {
-      throw std::overflow_error("table is full");
-    } else {
-      auto* ss = string_table();
-      reinterpret_cast<unsigned char*>(ss)[o] = static_cast<unsigned char>(s.size() & 0xff);
-      std::copy(std::begin(s), std::end(s), ss + o + 1);
-      return o;
+  std::size_t insert_string(std::string_view s) {
+    return try_insert_string(s).value();
+  }
+
+  /// Inserts `s` in this database if it wasn't already and returns its identity, or returns
+  /// `ErrorCode::StringTableFull` if there is no room for it.
+  ///
+  /// Throws `std::invalid_argument` if `s` is empty or longer than `max_string_size`.
+  Result<std::size_t> try_insert_string(std::string_view s) {
+    return insert_bytes<Validation::Checked>(s);
+  }
+
+  /// Inserts the strings `strings` in this database if they weren't already and returns their
+  /// identities, in the same order.
+  std::vector<std::size_t> insert_strings(std::span<std::string_view const> strings) {
+    return try_insert_strings(strings).value();
+  }
+
+  /// Inserts the strings `strings` in this database if they weren't already and returns their
+  /// identities, in the same order, or returns `ErrorCode::StringTableFull` if there is no room
+  /// for all of them, in which case only some of them may have been inserted.
+  ///
+  /// The string table is walked once for the whole batch to index the strings it holds, whereas
+  /// `insert_string` walks it for every string, so interning many strings takes linear time.
+  /// Throws `std::invalid_argument` if a string is empty or longer than `max_string_size`.
+  Result<std::vector<std::size_t>> try_insert_strings(std::span<std::string_view const> strings) {
+    for (auto s : strings) {
+      require<Validation::Checked, std::invalid_argument>(!s.empty(), "empty strings cannot be stored");
+      require<Validation::Checked, std::invalid_argument>(s.size() <= max_string_size, "string is too long");
+    }
+
+    auto* ss = string_table();
+    HashMap<std::string_view, std::size_t> index;
+    index.reserve(strings.size());
+    std::size_t o = 0;
+    while ((o < string_table_size) && (ss[o] != 0)) {
+      auto n = static_cast<std::size_t>(reinterpret_cast<unsigned char*>(ss)[o]);
+      index.try_emplace(std::string_view{ss + o + 1, n}, o);
+      o += n + 1;
+    }
+
+    std::vector<std::size_t> result;
+    result.reserve(strings.size());
+    for (auto s : strings) {
+      auto [i, inserted] = index.try_emplace(s, o);
+      if (inserted) {
+        if ((o + 1 + s.size()) > string_table_size) {
+          return ErrorCode::StringTableFull;
+        }
+        reinterpret_cast<unsigned char*>(ss)[o] = static_cast<unsigned char>(s.size());
+        std::copy(std::begin(s), std::end(s), ss + o + 1);
+        o += 1 + s.size();
+      }
+      result.push_back(*i);
+    }
+    return result;
+  }
+
+  /// Appends the records whose fields are `fields` to the table identified by `table_identity`
+  /// until it is full, and returns the number of records appended.
+  ///
+  /// Records are given in their stored encoding, one 32-bit word per field: the bits of integers
+  /// and single-precision numbers, and the identities of strings. This lets loaders that encode
+  /// records in parallel append them with a copy. String identities are checked in one walk of the
+  /// string table up to the largest of them, which `BulkLoader` skips since it obtains them from
+  /// `insert_strings`. Throws `std::out_of_range` if there is no such table or if a string identity
+  /// is not that of a stored string, and `std::invalid_argument` if the number of fields is not a
+  /// multiple of the width of the records of the table.
+  std::size_t append_encoded(std::size_t table_identity, std::span<std::uint32_t const> fields) {
+    auto t = existing_table<Validation::Checked>(table_identity);
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    require<Validation::Checked, std::invalid_argument>(
+      (record_width != 0) && ((fields.size() % record_width) == 0),
+      "fields do not make up whole records");
+    auto schema = static_cast<FieldType const*>(t) + 1;
+    std::vector<std::uint32_t> ids;
+    for (std::size_t i = 0; i < fields.size(); ++i) {
+      if (schema[i % record_width] == String) ids.push_back(fields[i]);
+    }
+    std::ranges::sort(ids);
+
+    // Identities are the offsets of the strings, so walk the table up to the largest one to check
+    // that each is the start of a string.
+    auto* ss = reinterpret_cast<unsigned char const*>(string_table());
+    std::size_t o = 0;
+    for (auto id : ids) {
+      while ((o < id) && (o < string_table_size) && (ss[o] != 0)) o += 1 + static_cast<std::size_t>(ss[o]);
+      require<Validation::Checked, std::out_of_range>((o == id) && (o < string_table_size) && (ss[o] != 0),
+        "no such string");
+    }
+    return append_fields(table_identity, fields);
+  }
+
+  /// Writes an image of this database by calling `write(bytes, count)` on consecutive chunks of
+  /// the image, returning `false` as soon as `write` does.
+  ///
+  /// Only the string table and the tables that have been created are written, so the size of an
+  /// image is proportional to the number of tables in use rather than to `max_table_count()`.
+  template<typename Write>
+  bool write_image(Write&& write) const {
+    auto& h = header();
+    ImagePreamble p{image_magic, table_size, string_table_size, h.max_table_count, h.table_count};
+    return write(reinterpret_cast<char const*>(&p), sizeof(ImagePreamble))
+      && write(string_table(), string_table_size)
+      && ((h.table_count == 0) || write(static_cast<char const*>(table(0)), h.table_count * table_size));
+  }
+
+  /// Writes an image of this database to `output`.
+  void save(std::ostream& output) const {
+    auto ok = write_image([&](char const* bytes, std::size_t count) {
+      return static_cast<bool>(output.write(bytes, static_cast<std::streamsize>(count)));
+    });
+    if (!ok) {
+      throw std::runtime_error("cannot write database image");
+    }
+  }
+
+  /// Returns the number of bytes of the string table occupied by strings.
+  std::size_t string_table_usage() const {
+    auto* ss = reinterpret_cast<unsigned char const*>(string_table());
+    std::size_t o = 0;
+    while ((o < string_table_size) && (ss[o] != 0)) {
+      o += 1 + static_cast<std::size_t>(ss[o]);
+    }
+    return std::min(o, string_table_size);
+  }
+
+  /// Returns the number of bytes allocated for the storage of this database.
+  std::size_t storage_size() const {
+    return capacity();
+  }
+
+  /// Returns the memory occupied by the table identified by `table_identity`, whose used bytes are
+  /// those of its schema, its records, and its counters.
+  Footprint table_footprint(std::size_t table_identity) const {
+    auto t = table(table_identity);
+    auto record_width = static_cast<std::size_t>(*static_cast<uint8_t*>(t));
+    auto n = counters(t).record_count;
+    auto used = records_offset(record_width) + (n * record_width * sizeof(std::uint32_t));
+    return {table_size, used + sizeof(TableCounters)};
+  }
+
+  /// Returns the memory occupied by the string table.
+  Footprint string_table_footprint() const {
+    return {string_table_size, string_table_usage()};
+  }
+
+  /// Returns the memory occupied by this database, whose allocated bytes are `storage_size()` and
+  /// whose used bytes are those of its header, its strings, and its tables.
+  Footprint footprint() const {
+    Footprint result{storage_size(), sizeof(Header)};
+    result.used += string_table_usage();
+    for (std::size_t t = 0; t < table_count(); ++t) {
+      result.used += table_footprint(t).used;
     }
+    return result;
+  }
+
+  /// Returns the number of bytes of the storage of this database that are backed by physical
+  /// memory, or `not_found` if it cannot be determined.
+  ///
+  /// Pages of the storage are only mapped when written, so this is typically much smaller than
+  /// `storage_size()` for databases sized for their peak.
+  std::size_t resident_size() const {
+    auto p = page_size();
+    auto a = reinterpret_cast<std::uintptr_t>(data) & ~(p - 1);
+    auto b = reinterpret_cast<std::uintptr_t>(storage_end());
+    std::vector<unsigned char> pages((b - a + p - 1) / p);
+    if (::mincore(reinterpret_cast<void*>(a), b - a, pages.data()) != 0) {
+      return not_found;
+    }
+    return p * static_cast<std::size_t>(std::ranges::count_if(pages, [](auto x) { return (x & 1) != 0; }));
+  }
+
+  /// Returns the physical memory of the pages of the storage that hold no data to the operating
+  /// system and returns the number of bytes released.
+  ///
+  /// The released pages are those of the tables that have not been created, of the free end of the
+  /// string table, and of the free space between the records and the counters of tables spanning
+  /// several pages. They read as zeros, as in a new database, and are mapped again when written,
+  /// so the capacity of the database is unchanged. Records cannot be compacted since their
+  /// identities are their positions.
+  std::size_t shrink_to_fit() {
+    auto released = release(string_table() + string_table_usage(), table(0));
+    for (std::size_t t = 0; t < table_count(); ++t) {
+      auto u = table(t);
+      released += release(record_address(u, counters(u).record_count), &counters(u));
+    }
+    return released + release(table(table_count()), storage_end());
   }
 
   /// Returns the string identified by `id`:
-  std::string string(std::size_t id) {
-    auto* ss = string_table();
-    auto n = static_cast<std::size_t>(reinterpret_cast<unsigned char*>(ss)[id]);
-    return std::string{ss + id + 1, n};
+  std::string string(std::size_t id) const {
+    return read_string<Validation::Unchecked>(id);
+  }
+
+};
+
+/// A reference to a database whose operations validate their arguments according to `mode`.
+///
+/// Handles are cheap to copy and several handles with different modes may refer to the same
+/// database, which must outlive them. For example, a service can use checked handles in staging
+/// and unchecked ones in production, or unchecked handles only on paths whose inputs have already
+/// been validated. `Database` is the type of the database, an instance of `BasicDummyDB`.
+template<Validation mode, typename Database>
+class Handle final {
+private:
+
+  /// The database.
+  Database* db;
+
+public:
+
+  /// Creates an instance referring to `db`.
+  explicit Handle(Database& db) : db(&db) {}
+
+  /// Returns the database to which this handle refers.
+  Database& database() const {
+    return *db;
+  }
+
+  /// Returns the number of tables in the database.
+  std::size_t table_count() const {
+    return db->table_count();
+  }
+
+  /// Creates a new table with the given scheme and returns its identity.
+  std::size_t create_table(std::vector<FieldType> const& schema) const {
+    return db->create_table(schema);
+  }
+
+  /// Returns the schema of the table identified by `table_identity`.
+  std::vector<FieldType> schema(std::size_t table_identity) const {
+    db->template existing_table<mode>(table_identity);
+    return db->schema(table_identity);
+  }
+
+  /// Returns the number of records in the table identified by `table_identity`.
+  std::size_t record_count(std::size_t table_identity) const {
+    db->template existing_table<mode>(table_identity);
+    return db->record_count(table_identity);
+  }
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity.
+  std::size_t insert(std::size_t table_identity, std::vector<Value> const& record) const {
+    return db->template insert_values<mode>(table_identity, record).value();
+  }
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity, or
+  /// returns the reason why there is no room for it.
+  Result<std::size_t> try_insert(std::size_t table_identity, std::vector<Value> const& record) const {
+    return db->template insert_values<mode>(table_identity, record);
+  }
+
+  /// Inserts a record whose fields are `fields` in the table identified by `table_identity` and
+  /// returns its identity.
+  template<FieldArgument... Args>
+    requires (sizeof...(Args) > 0)
+  std::size_t insert(std::size_t table_identity, Args&&... fields) const {
+    return db->template insert_fields<mode>(table_identity, std::forward<Args>(fields)...).value();
+  }
+
+  /// Inserts a record whose fields are `fields` in the table identified by `table_identity` and
+  /// returns its identity, or returns the reason why there is no room for it.
+  template<FieldArgument... Args>
+    requires (sizeof...(Args) > 0)
+  Result<std::size_t> try_insert(std::size_t table_identity, Args&&... fields) const {
+    return db->template insert_fields<mode>(table_identity, std::forward<Args>(fields)...);
+  }
+
+  /// Inserts a record whose fields are the elements of the tuple-like `fields` in the table
+  /// identified by `table_identity` and returns its identity.
+  template<typename Tuple>
+  std::size_t emplace(std::size_t table_identity, Tuple&& fields) const {
+    return std::apply([&](auto&&... xs) {
+      return insert(table_identity, std::forward<decltype(xs)>(xs)...);
+    }, std::forward<Tuple>(fields));
+  }
+
+  /// Returns the contents of the record identified by `record_identity`, which is stored in the
+  /// table identified by `table_identity`.
+  std::vector<Value> record(std::size_t table_identity, std::size_t record_identity) const {
+    return db->template read_record<mode>(table_identity, record_identity);
+  }
+
+  /// Returns the contents of the record identified by `id`.
+  std::vector<Value> record(RecordId id) const {
+    return db->template read_record<mode>(id);
+  }
+
+  /// Returns the contents of the records identified by `record_identities`, which are stored in the
+  /// table identified by `table_identity`, in the same order.
+  std::vector<std::vector<Value>> multi_get(
+    std::size_t table_identity, std::span<std::size_t const> record_identities
+  ) const {
+    if constexpr (mode == Validation::Checked) {
+      auto n = record_count(table_identity);
+      for (auto i : record_identities) {
+        Database::template require<mode, std::out_of_range>(i < n, "no such record");
+      }
+    }
+    return db->multi_get(table_identity, record_identities);
+  }
+
+  /// Returns summary statistics of the values of the column at index `column` of the table
+  /// identified by `table_identity`.
+  Summary summarize(std::size_t table_identity, std::size_t column) const {
+    return db->template summarize_column<mode>(table_identity, column);
+  }
+
+  /// Returns the identity of the string `s` if it is in the database or `not_found` otherwise.
+  std::size_t find_string(std::string_view s) const {
+    return db->find_string(s);
+  }
+
+  /// Inserts `s` in the database if it wasn't already and returns its identity.
+  std::size_t insert_string(std::string_view s) const {
+    return db->template insert_bytes<mode>(s).value();
+  }
+
+  /// Inserts `s` in the database if it wasn't already and returns its identity, or returns
+  /// `ErrorCode::StringTableFull` if there is no room for it.
+  Result<std::size_t> try_insert_string(std::string_view s) const {
+    return db->template insert_bytes<mode>(s);
+  }
+
+  /// Returns the string identified by `id`.
+  std::string string(std::size_t id) const {
+    return db->template read_string<mode>(id);
   }
 
 };
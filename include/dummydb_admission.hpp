@@ -0,0 +1,250 @@
+#pragma once
+
+#include "dummydb_protocol.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ddb {
+
+/// The class of a request, which determines the queue in which it waits for execution.
+enum class RequestClass : std::uint8_t {
+
+  /// A request touching a single record or string, which should complete quickly.
+  Point = 0,
+
+  /// A request reading or writing many records.
+  Scan = 1
+
+};
+
+/// Returns the class of the requests performing `operation`.
+inline RequestClass classify(protocol::Opcode operation) {
+  switch (operation) {
+    case protocol::Opcode::Scan:
+    case protocol::Opcode::Summarize:
+    case protocol::Opcode::InsertBatch:
+      return RequestClass::Scan;
+    default:
+      return RequestClass::Point;
+  }
+}
+
+/// The configuration of the admission control of a server.
+struct AdmissionOptions {
+
+  /// The number of threads executing requests, or 0 to execute requests on the event loops as
+  /// they are received, without admission control.
+  std::size_t workers = 0;
+
+  /// The number of point requests executed for every `scan_weight` scans when both are queued.
+  std::size_t point_weight = 8;
+
+  /// The number of scans executed for every `point_weight` point requests when both are queued.
+  std::size_t scan_weight = 1;
+
+  /// The maximum number of workers executing scans at the same time, or 0 to keep one worker
+  /// available for point requests if there are several.
+  std::size_t max_concurrent_scans = 0;
+
+  /// The maximum number of queued point requests beyond which new ones are rejected.
+  std::size_t max_queued_points = 4096;
+
+  /// The maximum number of queued scans beyond which new ones are rejected.
+  std::size_t max_queued_scans = 64;
+
+  /// The maximum number of requests of a client that are queued or executing.
+  std::size_t max_requests_per_client = 256;
+
+  /// The maximum number of bytes of requests and responses of a client that are queued, executing,
+  /// or waiting to be sent.
+  std::size_t max_bytes_per_client = std::size_t{16} << 20;
+
+};
+
+/// Counters describing the decisions of an admission controller.
+struct AdmissionStatistics {
+
+  /// The number of requests admitted, by class.
+  std::array<std::size_t, 2> admitted{};
+
+  /// The number of requests rejected, by class.
+  std::array<std::size_t, 2> rejected{};
+
+  /// The number of requests waiting for execution, by class.
+  std::array<std::size_t, 2> queued{};
+
+};
+
+/// A scheduler executing requests on a pool of workers with one bounded queue per class.
+///
+/// Queues are served in weighted round-robin: in each round, up to `point_weight` point requests
+/// and `scan_weight` scans are executed, and a round ends early when the queues it may still serve
+/// are empty, so that no worker idles while requests wait. The number of workers executing scans at
+/// once is capped so that a burst of scans cannot occupy every worker and delay point requests
+/// behind them. Requests are rejected rather than queued when their queue is full.
+class AdmissionController final {
+private:
+
+  /// The configuration.
+  AdmissionOptions options;
+
+  /// The lock protecting the queues and the scheduling state.
+  std::mutex mutex;
+
+  /// The condition signaled when a request is queued or the controller is stopped.
+  std::condition_variable changed;
+
+  /// The requests waiting for execution, by class.
+  std::array<std::deque<std::function<void()>>, 2> queues;
+
+  /// The number of requests of each class executed in the current round.
+  std::array<std::size_t, 2> served{};
+
+  /// The number of scans being executed.
+  std::size_t running_scans = 0;
+
+  /// `true` iff the workers must return.
+  bool stopping = false;
+
+  /// The counters of admitted and rejected requests, by class.
+  std::array<std::atomic<std::size_t>, 2> admitted{}, rejected{};
+
+  /// The workers.
+  std::vector<std::thread> workers;
+
+  /// Returns the weight of the class `c`.
+  std::size_t weight(std::size_t c) const {
+    return std::max<std::size_t>((c == 0) ? options.point_weight : options.scan_weight, 1);
+  }
+
+  /// Returns `true` iff a request of class `c` may start now.
+  bool may_start(std::size_t c) const {
+    return !queues[c].empty() && ((c == 0) || (running_scans < options.max_concurrent_scans));
+  }
+
+  /// Returns the class of the next request to execute, or 2 if none may start.
+  std::size_t next_class() {
+    for (int round = 0; round < 2; ++round) {
+      for (std::size_t c = 0; c < 2; ++c) {
+        if (may_start(c) && (served[c] < weight(c))) return c;
+      }
+      if (!may_start(0) && !may_start(1)) break;
+      served = {};
+    }
+    return 2;
+  }
+
+  /// Executes requests until the controller is stopped.
+  void work() {
+    std::unique_lock l{mutex};
+    while (true) {
+      std::size_t c = 2;
+      changed.wait(l, [&] { return stopping || ((c = next_class()) < 2); });
+      if (stopping) return;
+
+      auto job = std::move(queues[c].front());
+      queues[c].pop_front();
+      served[c] += 1;
+      if (c == 1) running_scans += 1;
+      l.unlock();
+      job();
+      l.lock();
+      if (c == 1) {
+        running_scans -= 1;
+        changed.notify_one();
+      }
+    }
+  }
+
+public:
+
+  /// Creates an instance configured by `options`, whose workers must be started by `start`.
+  explicit AdmissionController(AdmissionOptions const& options) : options(options) {
+    this->options.workers = std::max<std::size_t>(options.workers, 1);
+    if (this->options.max_concurrent_scans == 0) {
+      this->options.max_concurrent_scans = std::max<std::size_t>(this->options.workers - 1, 1);
+    }
+  }
+
+  AdmissionController(AdmissionController const&) = delete;
+  AdmissionController& operator=(AdmissionController const&) = delete;
+
+  ~AdmissionController() {
+    stop();
+  }
+
+  /// Returns the configuration of this instance.
+  AdmissionOptions const& configuration() const {
+    return options;
+  }
+
+  /// Queues `job` for execution as a request of class `c` and returns `true`, or returns `false`
+  /// without queuing it if the queue of `c` is full.
+  bool submit(RequestClass c, std::function<void()> job) {
+    auto i = static_cast<std::size_t>(c);
+    {
+      std::lock_guard l{mutex};
+      auto limit = (c == RequestClass::Point) ? options.max_queued_points : options.max_queued_scans;
+      if (queues[i].size() >= limit) {
+        rejected[i].fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      queues[i].push_back(std::move(job));
+    }
+    admitted[i].fetch_add(1, std::memory_order_relaxed);
+    changed.notify_one();
+    return true;
+  }
+
+  /// Records that a request of class `c` was rejected before reaching its queue.
+  void shed(RequestClass c) {
+    rejected[static_cast<std::size_t>(c)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// Returns the counters of this instance.
+  AdmissionStatistics statistics() {
+    AdmissionStatistics s;
+    for (std::size_t c = 0; c < 2; ++c) {
+      s.admitted[c] = admitted[c].load(std::memory_order_relaxed);
+      s.rejected[c] = rejected[c].load(std::memory_order_relaxed);
+    }
+    std::lock_guard l{mutex};
+    for (std::size_t c = 0; c < 2; ++c) s.queued[c] = queues[c].size();
+    return s;
+  }
+
+  /// Starts the workers.
+  void start() {
+    std::lock_guard l{mutex};
+    stopping = false;
+    for (std::size_t i = 0; i < options.workers; ++i) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  /// Stops the workers once they have completed the requests they are executing and discards the
+  /// queued requests.
+  void stop() {
+    {
+      std::lock_guard l{mutex};
+      stopping = true;
+    }
+    changed.notify_all();
+    for (auto& w : workers) w.join();
+    workers.clear();
+
+    std::lock_guard l{mutex};
+    for (auto& q : queues) q.clear();
+  }
+
+};
+
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include "dummydb.hpp"
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace ddb {
+
+/// An object running work items submitted from any thread.
+///
+/// Implement this interface to run the blocking part of database operations on the threads of
+/// your choice (e.g., a dedicated I/O pool or your own scheduler).
+class Executor {
+public:
+
+  virtual ~Executor() = default;
+
+  /// Schedules `work` for execution.
+  virtual void post(std::function<void()> work) = 0;
+
+};
+
+/// An executor running work items immediately on the thread that posts them.
+class InlineExecutor final : public Executor {
+public:
+
+  void post(std::function<void()> work) override {
+    work();
+  }
+
+};
+
+/// An executor running work items on a fixed set of threads in FIFO order.
+class ThreadPool final : public Executor {
+private:
+
+  /// The lock protecting `queue` and `stopping`.
+  std::mutex mutex;
+
+  /// The condition signaled when `queue` or `stopping` changes.
+  std::condition_variable changed;
+
+  /// The work items waiting to run.
+  std::deque<std::function<void()>> queue;
+
+  /// `true` iff the pool is being destroyed.
+  bool stopping;
+
+  /// The worker threads.
+  std::vector<std::thread> workers;
+
+  /// Runs work items until the pool is being destroyed and its queue is empty.
+  void work() {
+    while (true) {
+      std::unique_lock l{mutex};
+      changed.wait(l, [&] { return stopping || !queue.empty(); });
+      if (queue.empty()) return;
+      auto w = std::move(queue.front());
+      queue.pop_front();
+      l.unlock();
+      w();
+    }
+  }
+
+public:
+
+  /// Creates an instance with `thread_count` threads.
+  explicit ThreadPool(std::size_t thread_count = std::thread::hardware_concurrency())
+    : stopping(false)
+  {
+    for (std::size_t i = 0; i < std::max<std::size_t>(thread_count, 1); ++i) {
+      workers.emplace_back([this] { work(); });
+    }
+  }
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  /// Runs the pending work items and joins the threads.
+  ~ThreadPool() {
+    {
+      std::lock_guard l{mutex};
+      stopping = true;
+    }
+    changed.notify_all();
+    for (auto& w : workers) w.join();
+  }
+
+  void post(std::function<void()> work) override {
+    {
+      std::lock_guard l{mutex};
+      queue.push_back(std::move(work));
+    }
+    changed.notify_one();
+  }
+
+};
+
+/// An awaitable resuming the awaiting coroutine on an executor.
+class Schedule final {
+private:
+
+  /// The executor on which the awaiting coroutine is resumed.
+  Executor& executor;
+
+public:
+
+  /// Creates an instance resuming the awaiting coroutine on `executor`.
+  explicit Schedule(Executor& executor) : executor(executor) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    executor.post([h] { h.resume(); });
+  }
+
+  void await_resume() const noexcept {}
+
+};
+
+/// An awaitable running `F` on an executor and resuming the awaiting coroutine with its result on
+/// the thread that ran it.
+///
+/// The awaiting coroutine is suspended rather than blocked while `F` runs, so the thread that was
+/// running it can make progress on other work.
+template<typename F>
+class Offload final {
+public:
+
+  /// The result of `F`.
+  using Result = std::invoke_result_t<F&>;
+
+private:
+
+  /// The executor on which `work` runs.
+  Executor& executor;
+
+  /// The work to run.
+  F work;
+
+  /// The result of `work`, if it returned.
+  std::optional<std::conditional_t<std::is_void_v<Result>, std::monostate, Result>> result;
+
+  /// The exception thrown by `work`, if it threw.
+  std::exception_ptr error;
+
+public:
+
+  /// Creates an instance running `work` on `executor`.
+  Offload(Executor& executor, F work) : executor(executor), work(std::move(work)) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    executor.post([this, h] {
+      try {
+        if constexpr (std::is_void_v<Result>) {
+          work();
+          result.emplace();
+        } else {
+          result.emplace(work());
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+      h.resume();
+    });
+  }
+
+  Result await_resume() {
+    if (error) std::rethrow_exception(error);
+    if constexpr (!std::is_void_v<Result>) return std::move(*result);
+  }
+
+};
+
+/// A lazily started coroutine producing a value of type `T`.
+///
+/// A task starts running when it is awaited and resumes its awaiter when it completes.
+template<typename T = void>
+class Task final {
+public:
+
+  struct promise_type;
+
+private:
+
+  /// The state shared by the promises of tasks of all result types.
+  struct PromiseBase {
+
+    /// The coroutine awaiting the task.
+    std::coroutine_handle<> continuation;
+
+    /// The exception thrown by the task, if any.
+    std::exception_ptr error;
+
+    /// An awaitable transferring control to the continuation of a completed task.
+    struct FinalAwaiter {
+
+      bool await_ready() const noexcept { return false; }
+
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+        auto c = h.promise().continuation;
+        return c ? c : std::noop_coroutine();
+      }
+
+      void await_resume() const noexcept {}
+
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+
+  };
+
+  /// The storage of the result of a task producing a value.
+  struct PromiseValue : PromiseBase {
+
+    /// The result of the task.
+    std::optional<T> value;
+
+    template<typename U>
+    void return_value(U&& v) { value.emplace(std::forward<U>(v)); }
+
+    T result() {
+      if (this->error) std::rethrow_exception(this->error);
+      return std::move(*value);
+    }
+
+  };
+
+  /// The storage of the result of a task producing no value.
+  struct PromiseVoid : PromiseBase {
+
+    void return_void() noexcept {}
+
+    void result() {
+      if (this->error) std::rethrow_exception(this->error);
+    }
+
+  };
+
+  /// The coroutine of the task.
+  std::coroutine_handle<promise_type> handle;
+
+public:
+
+  struct promise_type : std::conditional_t<std::is_void_v<T>, PromiseVoid, PromiseValue> {
+
+    Task get_return_object() {
+      return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+
+  };
+
+  /// Creates an instance wrapping `handle`.
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+  Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+  Task(Task const&) = delete;
+  Task& operator=(Task const&) = delete;
+
+  ~Task() {
+    if (handle) handle.destroy();
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> h) noexcept {
+    handle.promise().continuation = h;
+    return handle;
+  }
+
+  T await_resume() {
+    return handle.promise().result();
+  }
+
+};
+
+namespace detail {
+
+/// A coroutine that starts eagerly and destroys itself when it completes.
+struct Detached {
+
+  struct promise_type {
+    Detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+
+};
+
+/// Runs `task` and fulfills `p` with its result.
+///
+/// The promise is shared since the waiter may return, and destroy its reference, as soon as the
+/// promise is fulfilled, while `set_value` may still be running on the executor's thread.
+template<typename T>
+Detached fulfill(Task<T> task, std::shared_ptr<std::promise<T>> p) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await task;
+      p->set_value();
+    } else {
+      p->set_value(co_await task);
+    }
+  } catch (...) {
+    p->set_exception(std::current_exception());
+  }
+}
+
+}
+
+/// Runs `task`, blocks the calling thread until it completes, and returns its result.
+template<typename T>
+T sync_wait(Task<T> task) {
+  auto p = std::make_shared<std::promise<T>>();
+  auto f = p->get_future();
+  detail::fulfill(std::move(task), p);
+  return f.get();
+}
+
+/// An asynchronous interface to a database.
+///
+/// Each operation returns an awaitable that runs the operation on an executor and suspends the
+/// awaiting coroutine until the operation completes, at which point the coroutine is resumed on
+/// the executor's thread. Await `Schedule` to move it back to another executor. Operations that
+/// modify the database are serialized with respect to each other and to readers; operations that
+/// only read from it run concurrently.
+class AsyncDB final {
+private:
+
+  /// The database.
+  DummyDB& db;
+
+  /// The executor running the operations.
+  Executor& executor;
+
+  /// The lock protecting `db`.
+  std::shared_mutex mutex;
+
+  /// Returns an awaitable running `f` on `executor` with exclusive access to `db`.
+  template<typename F>
+  auto writing(F f) {
+    return Offload{executor, [this, f = std::move(f)] {
+      std::unique_lock l{mutex};
+      return f();
+    }};
+  }
+
+  /// Returns an awaitable running `f` on `executor` with shared access to `db`.
+  template<typename F>
+  auto reading(F f) {
+    return Offload{executor, [this, f = std::move(f)] {
+      std::shared_lock l{mutex};
+      return f();
+    }};
+  }
+
+public:
+
+  /// Creates an instance running operations on `db` with `executor`.
+  AsyncDB(DummyDB& db, Executor& executor) : db(db), executor(executor) {}
+
+  /// Creates a new table with the given scheme and returns its identity.
+  auto create_table(std::vector<FieldType> schema) {
+    return writing([this, schema = std::move(schema)] { return db.create_table(schema); });
+  }
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity.
+  auto insert(std::size_t table_identity, std::vector<Value> record) {
+    return writing([this, table_identity, record = std::move(record)] {
+      return db.insert(table_identity, record);
+    });
+  }
+
+  /// Returns the contents of the record identified by `record_identity`, which is stored in the
+  /// table identified by `table_identity`.
+  auto record(std::size_t table_identity, std::size_t record_identity) {
+    return reading([this, table_identity, record_identity] {
+      return db.record(table_identity, record_identity);
+    });
+  }
+
+  /// Returns up to `count` records of the table identified by `table_identity`, starting from the
+  /// record identified by `first`.
+  auto scan(std::size_t table_identity, std::size_t first, std::size_t count) {
+    return reading([this, table_identity, first, count] {
+      auto n = db.record_count(table_identity);
+      auto last = (first < n) ? first + std::min(count, n - first) : first;
+      std::vector<std::vector<Value>> result;
+      result.reserve(last - first);
+      for (auto i = first; i < last; ++i) {
+        result.push_back(db.record(table_identity, i));
+      }
+      return result;
+    });
+  }
+
+};
+
+}
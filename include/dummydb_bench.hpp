@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/// Helpers shared by the benchmarks in `bench/` and the load generator.
+namespace ddb::bench {
+
+/// The clock used to measure durations.
+using Clock = std::chrono::steady_clock;
+
+/// Returns the number of nanoseconds elapsed since `start`.
+inline double elapsed_ns(Clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/// Prevents the compiler from optimizing away the computation of `x`.
+template<typename T>
+inline void keep(T const& x) {
+  asm volatile("" : : "g"(&x) : "memory");
+}
+
+/// A collection of latency samples, in nanoseconds.
+class Latencies final {
+private:
+
+  /// The samples, sorted lazily by `percentile`.
+  std::vector<double> samples;
+
+public:
+
+  /// Records `ns`.
+  void add(double ns) {
+    samples.push_back(ns);
+  }
+
+  /// Adds the samples of `other`.
+  void merge(Latencies const& other) {
+    samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+  }
+
+  /// Returns the number of samples.
+  std::size_t size() const {
+    return samples.size();
+  }
+
+  /// Returns the `p`-th percentile of the samples, where `p` is in [0, 100].
+  double percentile(double p) {
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    auto i = static_cast<std::size_t>((p / 100.0) * static_cast<double>(samples.size() - 1));
+    return samples[i];
+  }
+
+  /// Prints a summary of the samples labeled by `label`.
+  void report(char const* label) {
+    std::printf("%-32s n=%-9zu p50=%9.0fns p99=%9.0fns p99.9=%9.0fns max=%9.0fns\n",
+      label, size(), percentile(50), percentile(99), percentile(99.9), percentile(100));
+  }
+
+};
+
+/// Prints the throughput of `count` operations performed in `ns` nanoseconds, labeled by `label`.
+inline void report_throughput(char const* label, std::size_t count, double ns) {
+  std::printf("%-32s %12.0f ops/s (%7.1f ns/op)\n",
+    label, static_cast<double>(count) * 1e9 / ns, ns / static_cast<double>(count));
+}
+
+}
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "dummydb.hpp"
+#include "dummydb_async.hpp"
+
+#include <latch>
+
+namespace ddb {
+
+/// Runs `f(i)` for each `i` in [0, n) on `executor`, waits for all of them to complete, and
+/// rethrows the first exception thrown by any of them.
+template<typename F>
+void run_all(Executor& executor, std::size_t n, F const& f) {
+  std::latch done{static_cast<std::ptrdiff_t>(n)};
+  std::mutex mutex;
+  std::exception_ptr failure;
+  for (std::size_t i = 0; i < n; ++i) {
+    executor.post([&, i] {
+      try {
+        f(i);
+      } catch (...) {
+        std::lock_guard l{mutex};
+        if (!failure) failure = std::current_exception();
+      }
+      done.count_down();
+    });
+  }
+  done.wait();
+  if (failure) std::rethrow_exception(failure);
+}
+
+/// A loader appending batches of records to tables of the same schema, moving to a new table
+/// whenever the current one is full.
+///
+/// Inserting string fields one by one interns each of them separately, which serializes loads of
+/// string-heavy data. A loader instead encodes a batch in parallel chunks that collect their
+/// strings, deduplicates the strings in parallel partitions chosen by their hash, interns the
+/// distinct ones in one pass with `insert_strings`, rewrites the string fields of each chunk in
+/// parallel, and appends the chunks as `append_encoded` does, without checking the identities
+/// returned by `insert_strings` again. The database must not be accessed by other threads while a
+/// batch is loaded.
+template<typename Database>
+class BulkLoader final {
+private:
+
+  /// The part of a batch encoded by one task.
+  struct Chunk {
+
+    /// The fields of the records, whose strings are rewritten once interned.
+    std::vector<std::uint32_t> fields;
+
+    /// The string fields, as their index in `fields`, their partition, and their index in the
+    /// strings of the chunk in that partition.
+    std::vector<std::tuple<std::size_t, std::size_t, std::size_t>> strings;
+
+    /// The strings of the chunk by partition.
+    std::vector<std::vector<std::string_view>> partitions;
+
+    /// The index of each string of `partitions` among the distinct strings of its partition.
+    std::vector<std::vector<std::size_t>> positions;
+
+  };
+
+  /// The strings of a batch that hash to the same partition.
+  struct Partition {
+
+    /// The distinct strings of the partition.
+    std::vector<std::string_view> strings;
+
+    /// The index of each string in `strings`.
+    HashMap<std::string_view, std::size_t> index;
+
+    /// The index of the identity of `strings[0]` in the identities of all strings of the batch.
+    std::size_t first = 0;
+
+  };
+
+  /// The database.
+  Database& db;
+
+  /// The executor running the parallel phases of a load.
+  Executor& executor;
+
+  /// The number of tasks running each parallel phase.
+  std::size_t parallelism;
+
+  /// The schema of the records.
+  std::vector<FieldType> record_schema;
+
+  /// The identities of the tables holding the loaded records, in order.
+  std::vector<std::size_t> table_identities;
+
+  /// Returns the partition of `s` among `parallelism` partitions.
+  std::size_t partition_of(std::string_view s) const {
+    return hash_bytes(s.data(), s.size()) % parallelism;
+  }
+
+  /// Encodes the records `records` into `c`, collecting their strings.
+  void encode(std::span<std::vector<Value> const> records, Chunk& c) const {
+    auto w = record_schema.size();
+    c.fields.resize(records.size() * w);
+    c.partitions.resize(parallelism);
+    c.positions.resize(parallelism);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      auto const& r = records[i];
+      if (r.size() != w) {
+        throw std::invalid_argument("record does not match the schema of the table");
+      }
+      for (std::size_t j = 0; j < w; ++j) {
+        if (r[j].index() != record_schema[j]) {
+          throw std::invalid_argument("record does not match the schema of the table");
+        }
+        auto& f = c.fields[(i * w) + j];
+        switch (record_schema[j]) {
+          case Integer:
+            f = std::bit_cast<std::uint32_t>(*std::get_if<Integer>(&r[j]));
+            continue;
+
+          case Float:
+            f = std::bit_cast<std::uint32_t>(static_cast<float>(*std::get_if<Float>(&r[j])));
+            continue;
+
+          case String:
+            std::string_view s = *std::get_if<String>(&r[j]);
+            auto q = partition_of(s);
+            c.strings.emplace_back((i * w) + j, q, c.partitions[q].size());
+            c.partitions[q].push_back(s);
+            continue;
+        }
+      }
+    }
+  }
+
+public:
+
+  /// Creates a loader appending records of the schema `schema` to new tables of `db`, running
+  /// each phase of a load as `parallelism` tasks on `executor`.
+  BulkLoader(
+    Database& db, Executor& executor, std::vector<FieldType> schema,
+    std::size_t parallelism = std::thread::hardware_concurrency()
+  ) : db(db), executor(executor), parallelism(std::max<std::size_t>(parallelism, 1)), record_schema(std::move(schema))
+  {
+    table_identities.push_back(db.create_table(record_schema));
+  }
+
+  /// Returns the identities of the tables holding the loaded records, in order.
+  std::vector<std::size_t> const& tables() const {
+    return table_identities;
+  }
+
+  /// Appends `records` in order and returns their number.
+  ///
+  /// Throws `std::invalid_argument` if a record does not match the schema or holds a string that
+  /// cannot be stored, and `std::overflow_error` if the string table or the database is full, in
+  /// which case some of the records may have been appended.
+  std::size_t load(std::span<std::vector<Value> const> records) {
+    auto p = parallelism;
+    std::vector<Chunk> chunks(p);
+    auto chunk_size = (records.size() + p - 1) / p;
+    run_all(executor, p, [&](std::size_t i) {
+      auto first = std::min(i * chunk_size, records.size());
+      encode(records.subspan(first, std::min(chunk_size, records.size() - first)), chunks[i]);
+    });
+
+    // Deduplicate each partition on its own, then intern all distinct strings at once.
+    std::vector<Partition> partitions(p);
+    run_all(executor, p, [&](std::size_t i) {
+      auto& q = partitions[i];
+      for (auto& c : chunks) {
+        for (auto s : c.partitions[i]) {
+          auto [k, inserted] = q.index.try_emplace(s, q.strings.size());
+          if (inserted) q.strings.push_back(s);
+          c.positions[i].push_back(*k);
+        }
+      }
+    });
+    std::vector<std::string_view> distinct;
+    for (auto& q : partitions) {
+      q.first = distinct.size();
+      distinct.insert(distinct.end(), q.strings.begin(), q.strings.end());
+    }
+    auto identities = db.insert_strings(distinct);
+
+    run_all(executor, p, [&](std::size_t i) {
+      auto& c = chunks[i];
+      for (auto [f, q, k] : c.strings) {
+        c.fields[f] = static_cast<std::uint32_t>(identities[partitions[q].first + c.positions[q][k]]);
+      }
+    });
+
+    auto w = record_schema.size();
+    for (auto const& c : chunks) {
+      std::span<std::uint32_t const> rest = c.fields;
+      while (!rest.empty()) {
+        auto n = db.append_fields(table_identities.back(), rest);
+        rest = rest.subspan(n * w);
+        if (!rest.empty()) table_identities.push_back(db.create_table(record_schema));
+      }
+    }
+    return records.size();
+  }
+
+};
+
+}
@@ -0,0 +1,483 @@
+#pragma once
+
+#include "dummydb.hpp"
+#include "dummydb_protocol.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace ddb {
+
+/// Statistics about the use of a result cache.
+struct ResultCacheStatistics {
+
+  /// The number of lookups that found a valid result.
+  std::size_t hits = 0;
+
+  /// The number of lookups that computed a result.
+  std::size_t misses = 0;
+
+  /// The number of results evicted to make room for others.
+  std::size_t evictions = 0;
+
+  /// The number of results in the cache.
+  std::size_t entries = 0;
+
+  /// The estimated number of bytes occupied by the results in the cache.
+  std::size_t bytes = 0;
+
+};
+
+/// A cache of the results of read-only queries on a database.
+///
+/// Results are keyed by the normalized form of their query, which is the encoding of the request
+/// that would perform the query in the client protocol, so that equivalent queries share their
+/// result. A result records the modification version of each table it was computed from and is
+/// only returned if none of these tables has been modified since. The estimated size of the cached
+/// results is bounded; the least recently used results are evicted first when the bound is reached.
+///
+/// The cache is safe to use from several threads, but the caller must ensure that the database is
+/// not modified while a query computes its result, typically by holding a shared lock.
+class ResultCache final {
+private:
+
+  /// A cached result.
+  struct Entry {
+
+    /// The normalized query.
+    std::string key;
+
+    /// The identities of the tables read by the query and their versions when it ran.
+    std::vector<std::pair<std::size_t, std::uint64_t>> dependencies;
+
+    /// The result.
+    std::shared_ptr<void const> result;
+
+    /// The estimated size of the entry, in bytes.
+    std::size_t size;
+
+  };
+
+  /// The database.
+  DummyDB const& db;
+
+  /// The maximum estimated size of the cached results, in bytes.
+  std::size_t capacity;
+
+  /// The lock protecting the state of the cache.
+  mutable std::mutex mutex;
+
+  /// The entries, from the most to the least recently used.
+  std::list<Entry> entries;
+
+  /// The entries keyed by normalized query.
+  HashMap<std::string_view, std::list<Entry>::iterator> index;
+
+  /// The usage statistics.
+  ResultCacheStatistics statistics;
+
+  /// Returns `true` iff none of the tables on which `e` depends has been modified.
+  bool is_valid(Entry const& e) const {
+    for (auto [t, v] : e.dependencies) {
+      if (db.version(t) != v) return false;
+    }
+    return true;
+  }
+
+  /// Removes the entry at `i`.
+  void remove(std::list<Entry>::iterator i) {
+    statistics.bytes -= i->size;
+    index.erase(i->key);
+    entries.erase(i);
+  }
+
+  /// Returns the estimated size of `x`, in bytes.
+  static std::size_t size_of(Summary const&) {
+    return sizeof(Summary);
+  }
+
+  /// Returns the estimated size of `x`, in bytes.
+  static std::size_t size_of(std::vector<Value> const& x) {
+    auto n = sizeof(x) + x.capacity() * sizeof(Value);
+    for (auto const& v : x) {
+      if (auto s = std::get_if<std::string>(&v)) n += s->capacity();
+    }
+    return n;
+  }
+
+  /// Returns the estimated size of `x`, in bytes.
+  static std::size_t size_of(std::vector<std::vector<Value>> const& x) {
+    auto n = sizeof(x) + (x.capacity() - x.size()) * sizeof(std::vector<Value>);
+    for (auto const& r : x) n += size_of(r);
+    return n;
+  }
+
+public:
+
+  /// Creates an instance caching up to `capacity` bytes of results of queries on `db`.
+  ResultCache(DummyDB const& db, std::size_t capacity) : db(db), capacity(capacity) {}
+
+  ResultCache(ResultCache const&) = delete;
+  ResultCache& operator=(ResultCache const&) = delete;
+
+  /// Returns the result of the query normalized as `key`, which reads the tables identified by
+  /// `tables`, calling `compute` to obtain it if there is no valid result in the cache.
+  template<typename T, typename Compute>
+  std::shared_ptr<T const> get(std::string key, std::vector<std::size_t> const& tables, Compute compute) {
+    {
+      std::lock_guard l{mutex};
+      if (auto i = index.find(key)) {
+        if (is_valid(**i)) {
+          statistics.hits += 1;
+          entries.splice(entries.begin(), entries, *i);
+          return std::static_pointer_cast<T const>((*i)->result);
+        }
+        remove(*i);
+      }
+      statistics.misses += 1;
+    }
+
+    // Compute the result without holding the lock so that other queries can proceed.
+    Entry e{std::move(key), {}, nullptr, 0};
+    for (auto t : tables) e.dependencies.emplace_back(t, db.version(t));
+    auto result = std::make_shared<T const>(compute());
+    e.result = result;
+    e.size = sizeof(Entry) + e.key.capacity() + size_of(*result);
+    if (e.size > capacity) return result;
+
+    std::lock_guard l{mutex};
+    if (auto i = index.find(e.key)) {
+      remove(*i);
+    }
+    while ((statistics.bytes + e.size) > capacity) {
+      remove(std::prev(entries.end()));
+      statistics.evictions += 1;
+    }
+    statistics.bytes += e.size;
+    entries.push_front(std::move(e));
+    index.try_emplace(std::string_view{entries.front().key}, entries.begin());
+    return result;
+  }
+
+  /// Returns summary statistics of the numeric column at index `column` of the table identified by
+  /// `table_identity`.
+  std::shared_ptr<Summary const> summarize(std::size_t table_identity, std::size_t column) {
+    std::string key;
+    protocol::Writer(key, 0, std::uint8_t(protocol::Opcode::Summarize))
+      .u64(table_identity).u8(static_cast<std::uint8_t>(column)).end();
+    return get<Summary>(std::move(key), {table_identity}, [&] {
+      return db.summarize(table_identity, column);
+    });
+  }
+
+  /// Returns up to `count` records of the table identified by `table_identity`, starting from the
+  /// record identified by `first`.
+  std::shared_ptr<std::vector<std::vector<Value>> const> scan(
+    std::size_t table_identity, std::size_t first, std::size_t count
+  ) {
+    // Scans reaching past the end of the table are equivalent regardless of their count.
+    auto n = db.record_count(table_identity);
+    if ((first >= n) || (count >= (n - first))) count = not_found;
+
+    std::string key;
+    protocol::Writer(key, 0, std::uint8_t(protocol::Opcode::Scan))
+      .u64(table_identity).u64(first).u64(count).end();
+    return get<std::vector<std::vector<Value>>>(std::move(key), {table_identity}, [&] {
+      auto last = (first < n) ? first + std::min(count, n - first) : first;
+      std::vector<std::vector<Value>> result;
+      result.reserve(last - first);
+      for (auto i = first; i < last; ++i) {
+        result.push_back(db.record(table_identity, i));
+      }
+      return result;
+    });
+  }
+
+  /// Returns usage statistics.
+  ResultCacheStatistics usage() const {
+    std::lock_guard l{mutex};
+    auto s = statistics;
+    s.entries = entries.size();
+    return s;
+  }
+
+  /// Removes all results.
+  void clear() {
+    std::lock_guard l{mutex};
+    entries.clear();
+    index.clear();
+    statistics.bytes = 0;
+  }
+
+};
+
+/// Statistics about the use of a record cache.
+struct RecordCacheStatistics {
+
+  /// The number of lookups that found the record in the cache.
+  std::size_t hits = 0;
+
+  /// The number of lookups that decoded the record.
+  std::size_t misses = 0;
+
+  /// The number of records evicted to make room for others.
+  std::size_t evictions = 0;
+
+  /// The number of records in the cache.
+  std::size_t entries = 0;
+
+  /// Returns the fraction of the lookups that found the record in the cache, or 0 if there were
+  /// none.
+  double hit_ratio() const {
+    auto n = hits + misses;
+    return (n == 0) ? 0 : static_cast<double>(hits) / static_cast<double>(n);
+  }
+
+};
+
+/// A cache of decoded records, for callers that look up a small set of hot records repeatedly and
+/// need owning copies of their contents.
+///
+/// The cache is a set-associative array of `capacity` slots: each record can only be stored in the
+/// `ways` slots of the set selected by the hash of its identity, and the slots of a set are reused
+/// in CLOCK order, skipping those whose record has been looked up since the hand last passed. Hits
+/// take no lock: a lookup registers as a reader of the set, compares the identities stored in the
+/// set, and copies the shared reference of the matching entry, while code replacing an entry first
+/// empties the identity of its slot and then waits for the readers of the set to leave. Misses
+/// decode the record without holding any lock and insert it under the lock of the shard of its set,
+/// so that concurrent misses on different shards do not contend.
+///
+/// Records are only modified by `update`, so entries remain valid as their tables grow. Code that
+/// updates a record must call `invalidate` for it, code that replaces the contents of the database
+/// (e.g., by assigning it) must call `clear`, and code that wants to drop records from the cache can
+/// call `invalidate`. The caller must ensure that the database is not modified while a missed
+/// record is decoded, typically by holding a shared lock.
+class RecordCache final {
+private:
+
+  /// A cached record.
+  struct Entry {
+
+    /// The encoded identity of the record.
+    std::uint64_t key;
+
+    /// The contents of the record.
+    std::vector<Value> record;
+
+  };
+
+  /// The number of slots of a set.
+  static constexpr std::size_t ways = 8;
+
+  /// The number of shards whose locks serialize insertions.
+  static constexpr std::size_t shard_count = 16;
+
+  /// The key of an empty slot.
+  static constexpr std::uint64_t empty = RecordId{}.bits();
+
+  /// The slots in which a record can be stored.
+  struct alignas(cache_line_size) Set {
+
+    /// The keys of the entries of the slots, which are compared by lookups before acquiring an
+    /// entry, and which are `empty` while the entry of their slot is replaced.
+    std::array<std::atomic<std::uint64_t>, ways> keys;
+
+    /// `true` for the slots whose entry has been looked up since the hand last passed.
+    std::array<std::atomic<bool>, ways> referenced;
+
+    /// The number of lookups reading the keys and the entries of the set.
+    std::atomic<std::uint32_t> readers = 0;
+
+    /// The entries of the slots, which are only modified while the key of their slot is `empty`
+    /// and no lookup that may have read another key is reading the set.
+    std::array<std::shared_ptr<Entry const>, ways> entries;
+
+    /// The position of the CLOCK hand, guarded by the lock of the shard of the set.
+    std::size_t hand = 0;
+
+    /// Creates an instance whose slots are empty.
+    Set() {
+      for (auto& k : keys) k.store(empty, std::memory_order_relaxed);
+    }
+
+  };
+
+  /// A lock and the counters of the sets sharing it.
+  struct alignas(cache_line_size) Shard {
+
+    /// The lock serializing modifications of the sets of this shard.
+    std::mutex mutex;
+
+    /// The number of lookups that found their record.
+    std::atomic<std::size_t> hits = 0;
+
+    /// The number of lookups that decoded their record.
+    std::atomic<std::size_t> misses = 0;
+
+    /// The number of evicted records.
+    std::atomic<std::size_t> evictions = 0;
+
+  };
+
+  /// The database.
+  DummyDB const& db;
+
+  /// The number of sets, which is a power of two.
+  std::size_t set_count;
+
+  /// The sets.
+  std::unique_ptr<Set[]> sets;
+
+  /// The shards; the set at index `i` belongs to the shard at index `i % shard_count`.
+  std::array<Shard, shard_count> shards;
+
+  /// Returns the index of the set in which the record whose key is `key` can be stored.
+  std::size_t set_of(std::uint64_t key) const {
+    return static_cast<std::size_t>(hash_integer(key)) & (set_count - 1);
+  }
+
+  /// Empties the slot `w` of `s`, whose shard is locked, and returns `true` iff it held an entry.
+  ///
+  /// Lookups register as readers of the set before loading a key, and the key is emptied before
+  /// the readers are loaded (both in sequentially consistent order), so any lookup that may have
+  /// read the former key is counted, and the entry is only released once all of them have left.
+  static bool evict(Set& s, std::size_t w) {
+    auto k = s.keys[w].exchange(empty);
+    while (s.readers.load() != 0) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    }
+    s.entries[w].reset();
+    return k != empty;
+  }
+
+  /// Stores `e` in `s`, whose shard is `shard`, unless it is already there.
+  void insert(Set& s, Shard& shard, std::shared_ptr<Entry const> e) {
+    std::lock_guard l{shard.mutex};
+    for (auto const& k : s.keys) {
+      if (k.load(std::memory_order_relaxed) == e->key) return;
+    }
+
+    // Advance the hand until it reaches a slot whose entry has not been looked up recently.
+    while (s.referenced[s.hand].exchange(false, std::memory_order_relaxed)) {
+      s.hand = (s.hand + 1) % ways;
+    }
+    auto w = s.hand;
+    s.hand = (s.hand + 1) % ways;
+    if (evict(s, w)) {
+      shard.evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto k = e->key;
+    s.entries[w] = std::move(e);
+    s.keys[w].store(k, std::memory_order_release);
+  }
+
+public:
+
+  /// `true` iff the atomic operations of hits compile to lock-free instructions, the shared reference
+  /// to the entry found being copied with an atomic increment of its reference count.
+  static constexpr bool lock_free_hits = std::atomic<std::uint64_t>::is_always_lock_free
+    && std::atomic<std::uint32_t>::is_always_lock_free && std::atomic<bool>::is_always_lock_free
+    && std::atomic<std::size_t>::is_always_lock_free;
+
+  static_assert(lock_free_hits, "hits of a record cache must not take locks");
+
+  /// Creates an instance caching up to `capacity` decoded records of `db`, rounded up to a power
+  /// of two no smaller than `ways`.
+  RecordCache(DummyDB const& db, std::size_t capacity)
+    : db(db), set_count(std::bit_ceil(std::max(capacity, ways) / ways)), sets(new Set[set_count])
+  {}
+
+  RecordCache(RecordCache const&) = delete;
+  RecordCache& operator=(RecordCache const&) = delete;
+
+  /// Returns the maximum number of records in the cache.
+  std::size_t capacity() const {
+    return set_count * ways;
+  }
+
+  /// Returns the contents of the record identified by `id`, decoding it if it is not in the cache.
+  std::vector<Value> record(RecordId id) {
+    return *shared_record(id);
+  }
+
+  /// Returns the contents of the record identified by `id`, decoding it if it is not in the cache,
+  /// without copying them.
+  std::shared_ptr<std::vector<Value> const> shared_record(RecordId id) {
+    auto k = id.bits();
+    auto i = set_of(k);
+    auto& s = sets[i];
+    auto& shard = shards[i % shard_count];
+    s.readers.fetch_add(1);
+    for (std::size_t w = 0; w < ways; ++w) {
+      if (s.keys[w].load() != k) continue;
+      // The entry cannot be replaced before this lookup leaves the readers of the set.
+      auto e = s.entries[w];
+      s.readers.fetch_sub(1, std::memory_order_release);
+      if (!s.referenced[w].load(std::memory_order_relaxed)) {
+        s.referenced[w].store(true, std::memory_order_relaxed);
+      }
+      shard.hits.fetch_add(1, std::memory_order_relaxed);
+      return {e, &e->record};
+    }
+    s.readers.fetch_sub(1, std::memory_order_release);
+
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+    auto e = std::make_shared<Entry const>(Entry{k, db.record(id)});
+    insert(s, shard, e);
+    return {e, &e->record};
+  }
+
+  /// Removes the record identified by `id` from the cache.
+  void invalidate(RecordId id) {
+    auto k = id.bits();
+    auto i = set_of(k);
+    std::lock_guard l{shards[i % shard_count].mutex};
+    for (std::size_t w = 0; w < ways; ++w) {
+      if (sets[i].keys[w].load(std::memory_order_relaxed) == k) evict(sets[i], w);
+    }
+  }
+
+  /// Removes the records of the table identified by `table_identity` from the cache.
+  void invalidate(std::size_t table_identity) {
+    for (std::size_t i = 0; i < set_count; ++i) {
+      std::lock_guard l{shards[i % shard_count].mutex};
+      for (std::size_t w = 0; w < ways; ++w) {
+        auto k = sets[i].keys[w].load(std::memory_order_relaxed);
+        if ((k != empty) && (RecordId::from_bits(k).table() == table_identity)) evict(sets[i], w);
+      }
+    }
+  }
+
+  /// Removes all records from the cache.
+  void clear() {
+    for (std::size_t i = 0; i < set_count; ++i) {
+      std::lock_guard l{shards[i % shard_count].mutex};
+      for (std::size_t w = 0; w < ways; ++w) evict(sets[i], w);
+    }
+  }
+
+  /// Returns usage statistics.
+  RecordCacheStatistics usage() const {
+    RecordCacheStatistics result;
+    for (auto const& s : shards) {
+      result.hits += s.hits.load(std::memory_order_relaxed);
+      result.misses += s.misses.load(std::memory_order_relaxed);
+      result.evictions += s.evictions.load(std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < set_count; ++i) {
+      for (auto const& k : sets[i].keys) {
+        result.entries += (k.load(std::memory_order_relaxed) != empty) ? 1 : 0;
+      }
+    }
+    return result;
+  }
+
+};
+
+}
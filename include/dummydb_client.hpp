@@ -0,0 +1,480 @@
+#pragma once
+
+#include "dummydb.hpp"
+#include "dummydb_protocol.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ddb {
+
+/// The address of a server.
+struct Endpoint {
+
+  /// The address of the server's TCP listener.
+  std::string host = "127.0.0.1";
+
+  /// The port of the server's TCP listener.
+  std::uint16_t port = 7411;
+
+  /// The path of the server's Unix-domain socket, which is used instead of TCP if not empty.
+  std::string unix_path;
+
+};
+
+/// Returns a blocking socket connected to `e`.
+inline int connect(Endpoint const& e) {
+  int fd = -1;
+  int status = -1;
+  if (!e.unix_path.empty()) {
+    sockaddr_un a{};
+    a.sun_family = AF_UNIX;
+    if (e.unix_path.size() >= sizeof(a.sun_path)) {
+      throw std::invalid_argument("socket path is too long: " + e.unix_path);
+    }
+    std::copy(e.unix_path.begin(), e.unix_path.end(), a.sun_path);
+    fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    status = ::connect(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+  } else {
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(e.port);
+    if (inet_pton(AF_INET, e.host.c_str(), &a.sin_addr) != 1) {
+      throw std::invalid_argument("invalid address: " + e.host);
+    }
+    fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    status = ::connect(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+
+  if (status < 0) {
+    auto error = errno;
+    ::close(fd);
+    throw std::system_error(error, std::generic_category(), "connect");
+  }
+  return fd;
+}
+
+/// An error reported by a server in response to a request.
+struct ServerError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+/// An error signaling that a server shed a request without executing it because it is overloaded.
+struct ServerBusy : ServerError {
+  using ServerError::ServerError;
+};
+
+/// A connection to a server.
+///
+/// Requests are sent as soon as they are issued, without waiting for the responses to the previous
+/// ones, and the responses are dispatched to their requests by a background thread. Requests issued
+/// concurrently from several threads are coalesced into a single write by whichever thread is
+/// already sending.
+class Connection final {
+public:
+
+  /// A callback notified of the response to a request with either the payload of the response or
+  /// the exception describing why the request failed.
+  using Handler = std::function<void(std::exception_ptr, std::string_view)>;
+
+private:
+
+  /// The socket.
+  int fd;
+
+  /// The identity of the next request.
+  std::atomic<std::uint32_t> next_identity;
+
+  /// The lock protecting `pending`, `sending`, and `handlers`.
+  std::mutex mutex;
+
+  /// The frames waiting to be sent.
+  std::string pending;
+
+  /// `true` iff a thread is sending frames.
+  bool sending;
+
+  /// The handlers of the requests whose responses have not been received, keyed by identity.
+  std::unordered_map<std::uint32_t, Handler> handlers;
+
+  /// The exception describing why the connection failed, if it did.
+  std::exception_ptr failure;
+
+  /// The thread dispatching the responses.
+  std::thread receiver;
+
+  /// Fails all outstanding requests with `e`.
+  void fail(std::exception_ptr e) {
+    std::unordered_map<std::uint32_t, Handler> hs;
+    {
+      std::lock_guard l{mutex};
+      failure = e;
+      hs.swap(handlers);
+    }
+    for (auto& [i, h] : hs) h(e, {});
+  }
+
+  /// Receives responses until the connection is closed.
+  void receive() {
+    std::string input;
+    char chunk[65536];
+    try {
+      while (true) {
+        auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n == 0) {
+          throw std::runtime_error("connection closed");
+        } else if (n < 0) {
+          if (errno == EINTR) continue;
+          throw std::system_error(errno, std::generic_category(), "recv");
+        }
+        input.append(chunk, static_cast<std::size_t>(n));
+
+        std::size_t consumed = 0;
+        while (auto f = protocol::next_frame(std::string_view{input}.substr(consumed))) {
+          consumed += f->size;
+          Handler h;
+          {
+            std::lock_guard l{mutex};
+            auto i = handlers.find(f->request_identity);
+            if (i == handlers.end()) continue;
+            h = std::move(i->second);
+            handlers.erase(i);
+          }
+          if (f->code == std::uint8_t(protocol::Status::Ok)) {
+            h(nullptr, f->payload);
+          } else {
+            auto message = std::string{protocol::Reader{f->payload}.string()};
+            h((f->code == std::uint8_t(protocol::Status::Busy))
+              ? std::make_exception_ptr(ServerBusy(message))
+              : std::make_exception_ptr(ServerError(message)), {});
+          }
+        }
+        input.erase(0, consumed);
+      }
+    } catch (...) {
+      fail(std::current_exception());
+    }
+  }
+
+  /// Sends the frames in `pending`, unless another thread is already doing so.
+  void flush(std::unique_lock<std::mutex>& l) {
+    if (sending) return;
+    sending = true;
+    std::string buffer;
+    while (!pending.empty()) {
+      buffer.swap(pending);
+      l.unlock();
+      std::size_t written = 0;
+      while (written < buffer.size()) {
+        auto n = ::send(fd, buffer.data() + written, buffer.size() - written, MSG_NOSIGNAL);
+        if ((n < 0) && (errno == EINTR)) continue;
+        if (n <= 0) {
+          // The receiver observes the failure and fails the outstanding requests.
+          ::shutdown(fd, SHUT_RDWR);
+          break;
+        }
+        written += static_cast<std::size_t>(n);
+      }
+      buffer.clear();
+      l.lock();
+    }
+    sending = false;
+  }
+
+  /// Issues a request by calling `encode` on a frame writer and returns a future that is set with
+  /// the result of `decode` applied to a reader of the response's payload.
+  template<typename Encode, typename Decode>
+  auto call(protocol::Opcode operation, Encode encode, Decode decode) {
+    using T = decltype(decode(std::declval<protocol::Reader&>()));
+    auto p = std::make_shared<std::promise<T>>();
+    auto f = p->get_future();
+    submit(operation, encode, [p, decode](std::exception_ptr e, std::string_view payload) {
+      if (e) {
+        p->set_exception(e);
+        return;
+      }
+      try {
+        protocol::Reader r{payload};
+        p->set_value(decode(r));
+      } catch (...) {
+        p->set_exception(std::current_exception());
+      }
+    });
+    return f;
+  }
+
+public:
+
+  /// Creates an instance connected to `e`.
+  explicit Connection(Endpoint const& e)
+    : fd(connect(e)), next_identity(0), sending(false)
+  {
+    receiver = std::thread([this] { receive(); });
+  }
+
+  Connection(Connection const&) = delete;
+  Connection& operator=(Connection const&) = delete;
+
+  /// Closes the connection, failing the requests whose responses have not been received.
+  ~Connection() {
+    ::shutdown(fd, SHUT_RDWR);
+    receiver.join();
+    ::close(fd);
+  }
+
+  /// Issues a request by calling `encode` on a frame writer and calls `handler` on a background
+  /// thread with the response.
+  ///
+  /// `handler` should return quickly, since it delays the dispatch of subsequent responses.
+  template<typename Encode>
+  void submit(protocol::Opcode operation, Encode encode, Handler handler) {
+    auto i = next_identity.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock l{mutex};
+    if (failure) {
+      l.unlock();
+      handler(failure, {});
+      return;
+    }
+    handlers.emplace(i, std::move(handler));
+    protocol::Writer w{pending, i, std::uint8_t(operation)};
+    encode(w);
+    w.end();
+    flush(l);
+  }
+
+  /// Creates a table with the given schema and returns its identity.
+  std::future<std::size_t> create_table(std::vector<FieldType> const& schema) {
+    return call(protocol::Opcode::CreateTable,
+      [&](protocol::Writer& w) { w.schema(schema); },
+      [](protocol::Reader& r) { return static_cast<std::size_t>(r.u64()); });
+  }
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity.
+  std::future<std::size_t> insert(std::size_t table_identity, std::vector<Value> const& record) {
+    return call(protocol::Opcode::Insert,
+      [&](protocol::Writer& w) { w.u64(table_identity).record(record); },
+      [](protocol::Reader& r) { return static_cast<std::size_t>(r.u64()); });
+  }
+
+  /// Inserts `records` in the table identified by `table_identity` with a single request and
+  /// returns the identity of the first record inserted along with the number of records inserted.
+  std::future<std::pair<std::size_t, std::size_t>> insert_batch(
+    std::size_t table_identity, std::vector<std::vector<Value>> const& records
+  ) {
+    return call(protocol::Opcode::InsertBatch,
+      [&](protocol::Writer& w) {
+        w.u64(table_identity).u32(static_cast<std::uint32_t>(records.size()));
+        for (auto const& r : records) w.record(r);
+      },
+      [](protocol::Reader& r) {
+        auto first = static_cast<std::size_t>(r.u64());
+        return std::pair{first, static_cast<std::size_t>(r.u32())};
+      });
+  }
+
+  /// Inserts `s` in the database if it wasn't already and returns its identity.
+  std::future<std::size_t> insert_string(std::string_view s) {
+    return call(protocol::Opcode::InsertString,
+      [&](protocol::Writer& w) { w.string(s); },
+      [](protocol::Reader& r) { return static_cast<std::size_t>(r.u64()); });
+  }
+
+  /// Returns the contents of the record identified by `record_identity` in the table identified by
+  /// `table_identity`.
+  std::future<std::vector<Value>> record(std::size_t table_identity, std::size_t record_identity) {
+    return call(protocol::Opcode::Record,
+      [&](protocol::Writer& w) { w.u64(table_identity).u64(record_identity); },
+      [](protocol::Reader& r) { return r.record(); });
+  }
+
+  /// Returns the identity of `s` or `not_found`.
+  std::future<std::size_t> find_string(std::string_view s) {
+    return call(protocol::Opcode::FindString,
+      [&](protocol::Writer& w) { w.string(s); },
+      [](protocol::Reader& r) { return static_cast<std::size_t>(r.u64()); });
+  }
+
+  /// Returns up to `count` records of the table identified by `table_identity`, starting from the
+  /// record identified by `first`.
+  std::future<std::vector<std::vector<Value>>> scan(
+    std::size_t table_identity, std::size_t first, std::size_t count
+  ) {
+    return call(protocol::Opcode::Scan,
+      [&](protocol::Writer& w) { w.u64(table_identity).u64(first).u64(count); },
+      [](protocol::Reader& r) {
+        std::vector<std::vector<Value>> result(r.u64());
+        for (auto& x : result) x = r.record();
+        return result;
+      });
+  }
+
+  /// Returns summary statistics of the values of the numeric column at index `column` of the
+  /// table identified by `table_identity`.
+  std::future<Summary> summarize(std::size_t table_identity, std::size_t column) {
+    return call(protocol::Opcode::Summarize,
+      [&](protocol::Writer& w) { w.u64(table_identity).u8(static_cast<std::uint8_t>(column)); },
+      [](protocol::Reader& r) { return r.summary(); });
+  }
+
+};
+
+/// A fixed set of connections to a server across which requests are spread round-robin.
+class ConnectionPool final {
+private:
+
+  /// The connections.
+  std::vector<std::unique_ptr<Connection>> connections;
+
+  /// The number of connections handed out so far.
+  std::atomic<std::size_t> cursor;
+
+public:
+
+  /// Creates an instance with `size` connections to `e`.
+  ConnectionPool(Endpoint const& e, std::size_t size) : cursor(0) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(size, 1); ++i) {
+      connections.push_back(std::make_unique<Connection>(e));
+    }
+  }
+
+  /// Returns the number of connections in the pool.
+  std::size_t size() const {
+    return connections.size();
+  }
+
+  /// Returns the next connection on which a request should be issued.
+  Connection& next() {
+    return *connections[cursor.fetch_add(1, std::memory_order_relaxed) % connections.size()];
+  }
+
+  /// Creates a table with the given schema and returns its identity.
+  std::future<std::size_t> create_table(std::vector<FieldType> const& schema) {
+    return next().create_table(schema);
+  }
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity.
+  std::future<std::size_t> insert(std::size_t table_identity, std::vector<Value> const& record) {
+    return next().insert(table_identity, record);
+  }
+
+  /// Returns the contents of the record identified by `record_identity` in the table identified by
+  /// `table_identity`.
+  std::future<std::vector<Value>> record(std::size_t table_identity, std::size_t record_identity) {
+    return next().record(table_identity, record_identity);
+  }
+
+  /// Returns the identity of `s` or `not_found`.
+  std::future<std::size_t> find_string(std::string_view s) {
+    return next().find_string(s);
+  }
+
+  /// Returns up to `count` records of the table identified by `table_identity`, starting from the
+  /// record identified by `first`.
+  std::future<std::vector<std::vector<Value>>> scan(
+    std::size_t table_identity, std::size_t first, std::size_t count
+  ) {
+    return next().scan(table_identity, first, count);
+  }
+
+};
+
+/// An object accumulating the records inserted in a table to send them in batches.
+///
+/// A batch is sent when it reaches its maximum size or when `flush` is called. The identity of
+/// each record is delivered through the future returned by `insert` once its batch completes; the
+/// futures of records dropped because the table became full fail with a `ServerError`.
+class BatchInserter final {
+private:
+
+  /// The connection on which batches are sent.
+  Connection& connection;
+
+  /// The table in which records are inserted.
+  std::size_t table_identity;
+
+  /// The maximum number of records in a batch.
+  std::size_t batch_size;
+
+  /// The records of the current batch.
+  std::vector<std::vector<Value>> records;
+
+  /// The promises of the records of the current batch.
+  std::vector<std::promise<std::size_t>> promises;
+
+public:
+
+  /// Creates an instance inserting in the table identified by `table_identity` with batches of up
+  /// to `batch_size` records sent on `connection`.
+  BatchInserter(Connection& connection, std::size_t table_identity, std::size_t batch_size = 256)
+    : connection(connection), table_identity(table_identity), batch_size(batch_size)
+  {}
+
+  BatchInserter(BatchInserter const&) = delete;
+  BatchInserter& operator=(BatchInserter const&) = delete;
+
+  /// Sends the records that have not been sent yet.
+  ~BatchInserter() {
+    flush();
+  }
+
+  /// Inserts `record` and returns its identity.
+  std::future<std::size_t> insert(std::vector<Value> record) {
+    records.push_back(std::move(record));
+    promises.emplace_back();
+    auto f = promises.back().get_future();
+    if (records.size() >= batch_size) flush();
+    return f;
+  }
+
+  /// Sends the current batch.
+  void flush() {
+    if (records.empty()) return;
+    auto ps = std::make_shared<std::vector<std::promise<std::size_t>>>(std::move(promises));
+    auto rs = std::move(records);
+    promises.clear();
+    records.clear();
+
+    connection.submit(protocol::Opcode::InsertBatch,
+      [&](protocol::Writer& w) {
+        w.u64(table_identity).u32(static_cast<std::uint32_t>(rs.size()));
+        for (auto const& r : rs) w.record(r);
+      },
+      [ps](std::exception_ptr e, std::string_view payload) {
+        std::size_t first = 0;
+        std::size_t n = 0;
+        if (!e) {
+          protocol::Reader r{payload};
+          first = static_cast<std::size_t>(r.u64());
+          n = r.u32();
+        }
+        for (std::size_t i = 0; i < ps->size(); ++i) {
+          if (i < n) {
+            (*ps)[i].set_value(first + i);
+          } else {
+            (*ps)[i].set_exception(e ? e : std::make_exception_ptr(ServerError("table is full")));
+          }
+        }
+      });
+  }
+
+};
+
+}
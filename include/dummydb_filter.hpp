@@ -0,0 +1,398 @@
+#pragma once
+
+#include "dummydb.hpp"
+
+#include <array>
+#include <cmath>
+
+namespace ddb {
+
+/// An approximate set of hashes supporting insertions, lookups, and deletions, which may report
+/// that a hash is present when it is not but never the converse.
+///
+/// This is a cuckoo filter: each hash is reduced to a fingerprint of a few bits stored in one of
+/// two buckets of 4 slots, the second of which is derived from the first and the fingerprint so
+/// that fingerprints can be moved between their buckets to make room for others. Fingerprints
+/// are packed, so a filter takes about `fingerprint_bits() * 1.05` bits per hash, and a lookup
+/// reads two buckets. The probability of a false positive is about `8 / 2^fingerprint_bits()` at
+/// full load and proportionally smaller below.
+class CuckooFilter final {
+private:
+
+  /// The number of fingerprints per bucket.
+  static constexpr std::size_t bucket_size = 4;
+
+  /// The number of fingerprints moved by an insertion before the filter is considered full.
+  static constexpr std::size_t max_kicks = 500;
+
+  /// The number of bits of each fingerprint.
+  std::size_t bits;
+
+  /// The number of buckets.
+  std::size_t bucket_count;
+
+  /// The packed fingerprints, 0 denoting an empty slot, followed by a word of padding.
+  std::vector<std::uint64_t> words;
+
+  /// The number of stored fingerprints.
+  std::size_t count = 0;
+
+  /// The fingerprint evicted by the last insertion that failed to find room for it, and its
+  /// bucket, or 0.
+  std::uint32_t stash = 0;
+
+  /// The bucket of `stash`.
+  std::size_t stash_bucket = 0;
+
+  /// The state of the generator choosing the fingerprints to move.
+  std::uint64_t rng = hash_keys[2];
+
+  /// Returns the fingerprint in the slot `s` of the bucket `b`.
+  std::uint32_t get(std::size_t b, std::size_t s) const {
+    auto o = ((b * bucket_size) + s) * bits;
+    auto w = o / 64, shift = o % 64;
+    auto x = words[w] >> shift;
+    if (shift + bits > 64) x |= words[w + 1] << (64 - shift);
+    return static_cast<std::uint32_t>(x & ((std::uint64_t{1} << bits) - 1));
+  }
+
+  /// Stores `fingerprint` in the slot `s` of the bucket `b`.
+  void set(std::size_t b, std::size_t s, std::uint32_t fingerprint) {
+    auto o = ((b * bucket_size) + s) * bits;
+    auto w = o / 64, shift = o % 64;
+    auto mask = (std::uint64_t{1} << bits) - 1;
+    words[w] = (words[w] & ~(mask << shift)) | (std::uint64_t{fingerprint} << shift);
+    if (shift + bits > 64) {
+      auto high = 64 - shift;
+      words[w + 1] = (words[w + 1] & ~(mask >> high)) | (std::uint64_t{fingerprint} >> high);
+    }
+  }
+
+  /// Returns the fingerprint of the hash `h`, which is never 0.
+  std::uint32_t fingerprint_of(std::uint64_t h) const {
+    return static_cast<std::uint32_t>((h >> 32) % ((std::uint64_t{1} << bits) - 1)) + 1;
+  }
+
+  /// Returns the first bucket of the hash `h`.
+  std::size_t bucket_of(std::uint64_t h) const {
+    return static_cast<std::size_t>(((h & 0xffffffff) * bucket_count) >> 32);
+  }
+
+  /// Returns the other bucket of `fingerprint` when it is in the bucket `b`.
+  ///
+  /// The buckets of a fingerprint add up to a value derived from it, so each is obtained from the
+  /// other without the number of buckets having to be a power of two.
+  std::size_t alternate(std::size_t b, std::uint32_t fingerprint) const {
+    auto sum = static_cast<std::size_t>(hash_integer(fingerprint) % bucket_count);
+    return (sum + bucket_count - b) % bucket_count;
+  }
+
+  /// Stores `fingerprint` in an empty slot of the bucket `b` and returns `true`, or returns
+  /// `false` if there is none.
+  bool put(std::size_t b, std::uint32_t fingerprint) {
+    for (std::size_t s = 0; s < bucket_size; ++s) {
+      if (get(b, s) == 0) {
+        set(b, s, fingerprint);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Removes `fingerprint` from the bucket `b` and returns `true`, or returns `false` if it is
+  /// not there.
+  bool take(std::size_t b, std::uint32_t fingerprint) {
+    for (std::size_t s = 0; s < bucket_size; ++s) {
+      if (get(b, s) == fingerprint) {
+        set(b, s, 0);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Returns `true` iff the bucket `b` holds `fingerprint`.
+  bool holds(std::size_t b, std::uint32_t fingerprint) const {
+    for (std::size_t s = 0; s < bucket_size; ++s) {
+      if (get(b, s) == fingerprint) return true;
+    }
+    return false;
+  }
+
+public:
+
+  /// Creates an empty filter with room for about `capacity` hashes whose probability of false
+  /// positives at full load is at most `false_positive_rate`, within the limits of fingerprints
+  /// of 4 to 16 bits.
+  ///
+  /// Throws `std::invalid_argument` if `false_positive_rate` is not in (0, 1).
+  explicit CuckooFilter(std::size_t capacity, double false_positive_rate = 0.01) {
+    if (!(false_positive_rate > 0) || !(false_positive_rate < 1)) {
+      throw std::invalid_argument("false positive rate must be in (0, 1)");
+    }
+    auto b = std::ceil(std::log2((2 * bucket_size) / false_positive_rate));
+    bits = static_cast<std::size_t>(std::clamp(b, 4.0, 16.0));
+    bucket_count = std::max<std::size_t>(1, ((capacity * 20) + (19 * bucket_size) - 1) / (19 * bucket_size));
+    words.resize((((bucket_count * bucket_size * bits) + 63) / 64) + 1);
+  }
+
+  /// Returns the number of hashes in the filter.
+  std::size_t size() const {
+    return count;
+  }
+
+  /// Returns the number of slots of the filter, about 95% of which can be filled.
+  std::size_t capacity() const {
+    return bucket_count * bucket_size;
+  }
+
+  /// Returns the number of bits of each fingerprint.
+  std::size_t fingerprint_bits() const {
+    return bits;
+  }
+
+  /// Returns the number of bytes occupied by the fingerprints.
+  std::size_t memory_size() const {
+    return words.size() * sizeof(std::uint64_t);
+  }
+
+  /// Returns the expected probability that a lookup of an absent hash reports it as present.
+  double false_positive_rate() const {
+    auto load = static_cast<double>(count) / static_cast<double>(capacity());
+    return (2 * bucket_size * load) / static_cast<double>(std::uint64_t{1} << bits);
+  }
+
+  /// Inserts the hash `h` and returns `true`, or returns `false` if the filter is too full.
+  ///
+  /// A hash may be inserted several times, in which case it must be erased as many times.
+  bool insert(std::uint64_t h) {
+    auto f = fingerprint_of(h);
+    auto b = bucket_of(h);
+    if (put(b, f) || put(alternate(b, f), f)) {
+      count += 1;
+      return true;
+    } else if (stash != 0) {
+      return false;
+    }
+
+    // Move fingerprints to their other bucket until one finds an empty slot.
+    for (std::size_t k = 0; k < max_kicks; ++k) {
+      rng = hash_integer(rng);
+      auto s = static_cast<std::size_t>(rng % bucket_size);
+      auto victim = get(b, s);
+      set(b, s, f);
+      f = victim;
+      b = alternate(b, f);
+      if (put(b, f)) {
+        count += 1;
+        return true;
+      }
+    }
+    stash = f;
+    stash_bucket = b;
+    count += 1;
+    return true;
+  }
+
+  /// Returns `false` if the hash `h` is not in the filter, or `true` if it may be.
+  bool contains(std::uint64_t h) const {
+    auto f = fingerprint_of(h);
+    auto b = bucket_of(h);
+    auto c = alternate(b, f);
+    return holds(b, f) || holds(c, f) || ((stash == f) && ((stash_bucket == b) || (stash_bucket == c)));
+  }
+
+  /// Removes one occurrence of the hash `h`, which must have been inserted, and returns `true`, or
+  /// returns `false` if it is not in the filter.
+  ///
+  /// Erasing a hash that was not inserted may remove the fingerprint of another one, which would
+  /// then be reported absent.
+  bool erase(std::uint64_t h) {
+    auto f = fingerprint_of(h);
+    auto b = bucket_of(h);
+    auto c = alternate(b, f);
+    if ((stash == f) && ((stash_bucket == b) || (stash_bucket == c))) {
+      stash = 0;
+    } else if (!take(b, f) && !take(c, f)) {
+      return false;
+    } else if ((stash != 0) && (put(stash_bucket, stash) || put(alternate(stash_bucket, stash), stash))) {
+      stash = 0;
+    }
+    count -= 1;
+    return true;
+  }
+
+};
+
+/// Statistics about the lookups in a key filter.
+struct KeyFilterStatistics {
+
+  /// The number of lookups.
+  std::size_t lookups = 0;
+
+  /// The number of lookups answered by the filter alone, because the key was absent.
+  std::size_t rejected = 0;
+
+  /// The number of lookups that the filter passed to verification and that found no key.
+  std::size_t false_positives = 0;
+
+};
+
+/// A cuckoo filter of the keys of a table, which are the values of one of its columns, telling
+/// whether a key is absent without reading the table.
+///
+/// Ingestion that deduplicates records on their key can check `contains` before each insertion
+/// and `add` the key of each inserted record: most absent keys are rejected by the filter, and
+/// the others are verified by scanning the key column, or by a caller-provided lookup in an
+/// index. Filters are not synchronized.
+class KeyFilter final {
+private:
+
+  /// The database.
+  DummyDB const& db;
+
+  /// The identity of the table.
+  std::size_t table;
+
+  /// The index of the key column.
+  std::size_t column;
+
+  /// The type of the key column.
+  FieldType type;
+
+  /// The filter of the hashes of the keys.
+  CuckooFilter keys;
+
+  /// The statistics of the lookups.
+  mutable KeyFilterStatistics statistics;
+
+  /// Returns the hash of `key` as stored in the key column, throwing `std::invalid_argument` if
+  /// it does not match the type of the column.
+  std::uint64_t hash_of(Value const& key) const {
+    if (key.index() != type) {
+      throw std::invalid_argument("key does not match the type of the column");
+    }
+    switch (type) {
+      case Integer: return Hash{}(*std::get_if<Integer>(&key));
+      case Float: return Hash{}(static_cast<float>(*std::get_if<Float>(&key)));
+      default: return Hash{}(*std::get_if<String>(&key));
+    }
+  }
+
+  /// Calls `f(value)` with the key of each record of the table, read in chunks with `project`,
+  /// until `f` returns `true`, and returns `true` iff it did.
+  template<typename F>
+  bool scan(F f) const {
+    std::size_t columns[] = {column};
+    auto n = db.record_count(table);
+    auto chunk = [&]<typename T>(std::span<T> buffer) {
+      ColumnBuffer buffers[] = {buffer};
+      for (std::size_t first = 0; first < n; first += buffer.size()) {
+        auto m = db.project(table, columns, first, buffer.size(), buffers);
+        for (std::size_t i = 0; i < m; ++i) {
+          if (f(buffer[i])) return true;
+        }
+      }
+      return false;
+    };
+    switch (type) {
+      case Integer: {
+        std::array<std::int32_t, 256> buffer;
+        return chunk(std::span<std::int32_t>{buffer});
+      }
+
+      case Float: {
+        std::array<float, 256> buffer;
+        return chunk(std::span<float>{buffer});
+      }
+
+      default: {
+        std::array<std::string_view, 256> buffer;
+        return chunk(std::span<std::string_view>{buffer});
+      }
+    }
+  }
+
+public:
+
+  /// Creates a filter of the keys of the table identified by `table_identity` of `db`, which are
+  /// the values of its column at index `key_column`, with room for `capacity` keys or for as many
+  /// keys as the table has records if `capacity` is 0, and a probability of false positives of at
+  /// most `false_positive_rate` when full.
+  ///
+  /// The keys of the records already in the table are added. Throws `std::out_of_range` if there
+  /// is no such table or column, and `std::overflow_error` if they do not fit.
+  KeyFilter(
+    DummyDB const& db, std::size_t table_identity, std::size_t key_column,
+    double false_positive_rate = 0.01, std::size_t capacity = 0
+  ) : db(db), table(table_identity), column(key_column),
+      type(db.schema(table_identity).at(key_column)),
+      keys((capacity == 0) ? db.record_capacity(table_identity) : capacity, false_positive_rate)
+  {
+    scan([&](auto x) {
+      if (!keys.insert(Hash{}(x))) throw std::overflow_error("key filter is full");
+      return false;
+    });
+  }
+
+  /// Returns the filter of the hashes of the keys.
+  CuckooFilter const& filter() const {
+    return keys;
+  }
+
+  /// Returns the statistics of the lookups.
+  KeyFilterStatistics usage() const {
+    return statistics;
+  }
+
+  /// Adds `key`, which is the key of a record inserted in the table, and returns `true`, or
+  /// returns `false` if the filter is too full.
+  bool add(Value const& key) {
+    return keys.insert(hash_of(key));
+  }
+
+  /// Removes `key`, which must have been added, and returns `true`, or returns `false` if it is
+  /// not in the filter.
+  bool erase(Value const& key) {
+    return keys.erase(hash_of(key));
+  }
+
+  /// Returns `false` if no record of the table has the key `key`, or `true` if one may have it.
+  bool may_contain(Value const& key) const {
+    statistics.lookups += 1;
+    if (!keys.contains(hash_of(key))) {
+      statistics.rejected += 1;
+      return false;
+    }
+    return true;
+  }
+
+  /// Returns `true` iff a record of the table has the key `key`, scanning the key column only if
+  /// the filter cannot rule it out.
+  bool contains(Value const& key) const {
+    return contains(key, [&](Value const& k) {
+      return scan([&](auto x) {
+        if constexpr (std::is_same_v<decltype(x), std::string_view>) {
+          return x == *std::get_if<String>(&k);
+        } else if constexpr (std::is_same_v<decltype(x), float>) {
+          return x == static_cast<float>(*std::get_if<Float>(&k));
+        } else {
+          return x == *std::get_if<Integer>(&k);
+        }
+      });
+    });
+  }
+
+  /// Returns `true` iff a record of the table has the key `key`, calling `verify(key)` to find
+  /// out only if the filter cannot rule it out.
+  template<typename Verify>
+  bool contains(Value const& key, Verify verify) const {
+    if (!may_contain(key)) return false;
+    auto found = verify(key);
+    statistics.false_positives += !found;
+    return found;
+  }
+
+};
+
+}
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ddb {
+
+/// Returns the exclusive or of the high and low halves of the 128-bit product of `a` and `b`,
+/// which mixes every bit of both operands into every bit of the result.
+inline std::uint64_t fold_multiply(std::uint64_t a, std::uint64_t b) {
+  __extension__ typedef unsigned __int128 Product;
+  auto p = static_cast<Product>(a) * b;
+  return static_cast<std::uint64_t>(p) ^ static_cast<std::uint64_t>(p >> 64);
+}
+
+/// The constants mixed into hashes, which are the first digits of the fractional parts of π and
+/// of the golden ratio.
+constexpr std::uint64_t hash_keys[] = {
+  0x243f6a8885a308d3, 0x13198a2e03707344, 0xa4093822299f31d0, 0x9e3779b97f4a7c15
+};
+
+/// Returns the hash of the integer `x`.
+inline std::uint64_t hash_integer(std::uint64_t x) {
+  return fold_multiply(x ^ hash_keys[0], hash_keys[3]);
+}
+
+/// Returns the hash of the number `x`, which is the same for both zeros.
+inline std::uint64_t hash_number(double x) {
+  return hash_integer(std::bit_cast<std::uint64_t>(x + 0.0));
+}
+
+/// Returns the hash of the `n` bytes starting at `p`.
+///
+/// Bytes are read 16 at a time, each pair of words being folded into the state by a single
+/// multiplication, and the remaining bytes are read with possibly overlapping loads, so short
+/// strings such as keys and identifiers are hashed with a handful of instructions.
+inline std::uint64_t hash_bytes(void const* p, std::size_t n) {
+  auto b = static_cast<unsigned char const*>(p);
+  auto load64 = [](unsigned char const* q) { std::uint64_t x; std::memcpy(&x, q, sizeof(x)); return x; };
+  auto load32 = [](unsigned char const* q) { std::uint32_t x; std::memcpy(&x, q, sizeof(x)); return std::uint64_t{x}; };
+
+  auto h = hash_keys[0] ^ fold_multiply(n ^ hash_keys[1], hash_keys[3]);
+  std::uint64_t x = 0, y = 0;
+  if (n <= 16) {
+    if (n >= 8) {
+      x = load64(b);
+      y = load64(b + n - 8);
+    } else if (n >= 4) {
+      x = load32(b);
+      y = load32(b + n - 4);
+    } else if (n > 0) {
+      x = (std::uint64_t{b[0]} << 16) | (std::uint64_t{b[n / 2]} << 8) | b[n - 1];
+    }
+  } else {
+    auto i = n;
+    for (; i > 16; i -= 16, b += 16) {
+      h = fold_multiply(load64(b) ^ hash_keys[1], load64(b + 8) ^ h);
+    }
+    x = load64(b + i - 16);
+    y = load64(b + i - 8);
+  }
+  return fold_multiply(hash_keys[2] ^ n, fold_multiply(x ^ hash_keys[1], y ^ h));
+}
+
+/// The hash function of the data structures of databases, which hashes integers, numbers, byte
+/// strings, and variants of them.
+///
+/// Hashes mix all bits of their input into all bits of their output, so that tables can index
+/// their buckets with any bits of a hash.
+struct Hash {
+
+  /// Lets hash tables look up keys of any type hashed by this function.
+  using is_transparent = void;
+
+  /// Returns the hash of the integer `x`.
+  std::uint64_t operator()(std::integral auto x) const {
+    return hash_integer(static_cast<std::uint64_t>(x));
+  }
+
+  /// Returns the hash of the number `x`.
+  std::uint64_t operator()(std::floating_point auto x) const {
+    return hash_number(static_cast<double>(x));
+  }
+
+  /// Returns the hash of the bytes of `s`.
+  std::uint64_t operator()(std::string_view s) const {
+    return hash_bytes(s.data(), s.size());
+  }
+
+  /// Returns the hash of the value of `v`, mixed with the index of its alternative.
+  template<typename... T>
+  std::uint64_t operator()(std::variant<T...> const& v) const {
+    return std::visit(*this, v) ^ hash_integer(v.index());
+  }
+
+};
+
+/// An open-addressing hash map storing its entries in a flat array, in the style of Swiss
+/// tables.
+///
+/// Each slot has a control byte, which is either empty, deleted, or holds 7 bits of the hash of
+/// the key of the slot. Lookups probe groups of 16 slots whose control bytes are compared with
+/// the hash of the key at once, with SSE2 when available, so that most lookups compare a single
+/// key and stop at the first group with an empty slot. Keys and values must be default
+/// constructible; erased entries are reset to their default values.
+///
+/// `H` must mix all bits of its result, since the low bits choose groups and the high bits
+/// fill control bytes.
+template<typename K, typename V, typename H = Hash, typename Equal = std::equal_to<>>
+class HashMap final {
+private:
+
+  /// The number of slots whose control bytes are matched at once.
+  static constexpr std::size_t group_size = 16;
+
+  /// The control byte of an empty slot.
+  static constexpr std::int8_t empty_slot = -128;
+
+  /// The control byte of a slot whose entry was erased.
+  static constexpr std::int8_t deleted_slot = -2;
+
+  /// The control bytes of the slots.
+  std::vector<std::int8_t> controls;
+
+  /// The entries of the slots.
+  std::vector<std::pair<K, V>> slots;
+
+  /// The number of entries.
+  std::size_t count = 0;
+
+  /// The number of slots whose entry was erased.
+  std::size_t tombstones = 0;
+
+  /// The hash function.
+  [[no_unique_address]] H hasher;
+
+  /// The equality of keys.
+  [[no_unique_address]] Equal equal;
+
+  /// Returns a mask of the slots of the group starting at `c` whose control byte is `x`.
+  static std::uint32_t match(std::int8_t const* c, std::int8_t x) {
+#if defined(__SSE2__)
+    auto g = _mm_loadu_si128(reinterpret_cast<__m128i const*>(c));
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(x))));
+#else
+    std::uint32_t m = 0;
+    for (std::size_t i = 0; i < group_size; ++i) m |= std::uint32_t{c[i] == x} << i;
+    return m;
+#endif
+  }
+
+  /// Returns a mask of the slots of the group starting at `c` that hold no entry.
+  static std::uint32_t match_free(std::int8_t const* c) {
+#if defined(__SSE2__)
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(c))));
+#else
+    std::uint32_t m = 0;
+    for (std::size_t i = 0; i < group_size; ++i) m |= std::uint32_t{c[i] < 0} << i;
+    return m;
+#endif
+  }
+
+  /// Returns the control byte of the slots holding keys whose hash is `h`.
+  static std::int8_t tag_of(std::uint64_t h) {
+    return static_cast<std::int8_t>(h >> 57);
+  }
+
+  /// Calls `f(g)` for the index `g` of each group in the probe sequence of the hash `h`, until
+  /// `f` returns `true`.
+  ///
+  /// Groups are visited in triangular order, which covers all of them since their number is a
+  /// power of two.
+  template<typename F>
+  void probe(std::uint64_t h, F f) const {
+    auto mask = (controls.size() / group_size) - 1;
+    for (std::size_t g = h & mask, i = 1; !f(g * group_size); g = (g + i++) & mask) {}
+  }
+
+  /// Returns the index of the slot holding `key`, whose hash is `h`, or `controls.size()` if there
+  /// is none.
+  template<typename Q>
+  std::size_t locate(Q const& key, std::uint64_t h) const {
+    auto result = controls.size();
+    if (result == 0) return result;
+    auto tag = tag_of(h);
+    probe(h, [&](std::size_t g) {
+      for (auto m = match(&controls[g], tag); m != 0; m &= m - 1) {
+        auto i = g + static_cast<std::size_t>(std::countr_zero(m));
+        if (equal(slots[i].first, key)) {
+          result = i;
+          return true;
+        }
+      }
+      return match(&controls[g], empty_slot) != 0;
+    });
+    return result;
+  }
+
+  /// Moves the entries to a table of `capacity` slots.
+  void rehash(std::size_t capacity) {
+    auto old_controls = std::exchange(controls, std::vector<std::int8_t>(capacity, empty_slot));
+    auto old_slots = std::exchange(slots, std::vector<std::pair<K, V>>(capacity));
+    tombstones = 0;
+    for (std::size_t i = 0; i < old_controls.size(); ++i) {
+      if (old_controls[i] >= 0) {
+        auto h = hasher(old_slots[i].first);
+        probe(h, [&](std::size_t g) {
+          auto m = match_free(&controls[g]);
+          if (m == 0) return false;
+          auto j = g + static_cast<std::size_t>(std::countr_zero(m));
+          controls[j] = tag_of(h);
+          slots[j] = std::move(old_slots[i]);
+          return true;
+        });
+      }
+    }
+  }
+
+  /// Returns the number of slots that a table holding `n` entries needs.
+  static std::size_t capacity_for(std::size_t n) {
+    return std::bit_ceil(std::max(group_size, (n * 8 + 6) / 7));
+  }
+
+public:
+
+  /// Creates an empty map.
+  HashMap() = default;
+
+  /// Creates an empty map with room for `n` entries.
+  explicit HashMap(std::size_t n) {
+    reserve(n);
+  }
+
+  /// Returns the number of entries.
+  std::size_t size() const {
+    return count;
+  }
+
+  /// Returns `true` iff the map has no entry.
+  bool empty() const {
+    return count == 0;
+  }
+
+  /// Returns the number of slots.
+  std::size_t capacity() const {
+    return controls.size();
+  }
+
+  /// Makes room for `n` entries.
+  void reserve(std::size_t n) {
+    if (capacity_for(n) > controls.size()) rehash(capacity_for(n));
+  }
+
+  /// Removes all entries, keeping the slots.
+  void clear() {
+    std::fill(controls.begin(), controls.end(), empty_slot);
+    std::fill(slots.begin(), slots.end(), std::pair<K, V>{});
+    count = tombstones = 0;
+  }
+
+  /// Returns the value of the key equal to `key`, or `nullptr` if there is none.
+  template<typename Q>
+  V* find(Q const& key) {
+    auto i = locate(key, hasher(key));
+    return (i < controls.size()) ? &slots[i].second : nullptr;
+  }
+
+  /// Returns the value of the key equal to `key`, or `nullptr` if there is none.
+  template<typename Q>
+  V const* find(Q const& key) const {
+    auto i = locate(key, hasher(key));
+    return (i < controls.size()) ? &slots[i].second : nullptr;
+  }
+
+  /// Returns `true` iff the map has a key equal to `key`.
+  template<typename Q>
+  bool contains(Q const& key) const {
+    return locate(key, hasher(key)) < controls.size();
+  }
+
+  /// Inserts an entry whose key is constructed from `key` and whose value is constructed from
+  /// `args` if there is no key equal to `key`, and returns the value of that key along with
+  /// `true` iff the entry was inserted.
+  ///
+  /// Pointers to values are invalidated by insertions that grow the table.
+  template<typename Q, typename... Args>
+  std::pair<V*, bool> try_emplace(Q&& key, Args&&... args) {
+    auto h = hasher(key);
+    if (auto i = locate(key, h); i < controls.size()) {
+      return {&slots[i].second, false};
+    }
+
+    // Grow when 7/8 of the slots are used, or rebuild in place if most of them are tombstones.
+    if ((count + tombstones + 1) * 8 > controls.size() * 7) {
+      auto n = controls.size();
+      rehash(std::max(capacity_for(count + 1), ((count + 1) * 16 > n * 7) ? n * 2 : n));
+    }
+    std::size_t i = 0;
+    probe(h, [&](std::size_t g) {
+      auto m = match_free(&controls[g]);
+      if (m == 0) return false;
+      i = g + static_cast<std::size_t>(std::countr_zero(m));
+      return true;
+    });
+    tombstones -= (controls[i] == deleted_slot);
+    controls[i] = tag_of(h);
+    slots[i] = {K(std::forward<Q>(key)), V(std::forward<Args>(args)...)};
+    count += 1;
+    return {&slots[i].second, true};
+  }
+
+  /// Returns the value of `key`, inserting a default one if there is none.
+  V& operator[](K const& key) {
+    return *try_emplace(key).first;
+  }
+
+  /// Removes the entry whose key is equal to `key` and returns `true`, or returns `false` if
+  /// there is none.
+  template<typename Q>
+  bool erase(Q const& key) {
+    auto i = locate(key, hasher(key));
+    if (i == controls.size()) return false;
+
+    // Lookups stop at groups with an empty slot, so none of them probes past the group of `i` if
+    // that group has one, in which case the slot can be emptied rather than marked deleted.
+    auto g = i - (i % group_size);
+    if (match(&controls[g], empty_slot) != 0) {
+      controls[i] = empty_slot;
+    } else {
+      controls[i] = deleted_slot;
+      tombstones += 1;
+    }
+    slots[i] = {};
+    count -= 1;
+    return true;
+  }
+
+  /// Calls `f(key, value)` for each entry, in an unspecified order.
+  template<typename F>
+  void for_each(F f) {
+    for (std::size_t i = 0; i < controls.size(); ++i) {
+      if (controls[i] >= 0) f(std::as_const(slots[i].first), slots[i].second);
+    }
+  }
+
+  /// Calls `f(key, value)` for each entry, in an unspecified order.
+  template<typename F>
+  void for_each(F f) const {
+    for (std::size_t i = 0; i < controls.size(); ++i) {
+      if (controls[i] >= 0) f(slots[i].first, slots[i].second);
+    }
+  }
+
+};
+
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+#include "dummydb.hpp"
+#include "dummydb_protocol.hpp"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace ddb {
+
+/// An object appending metrics to a buffer in the Prometheus text exposition format.
+class Exposition final {
+private:
+
+  /// The buffer to which metrics are appended.
+  std::string& buffer;
+
+public:
+
+  /// Creates an instance appending to `buffer`.
+  explicit Exposition(std::string& buffer) : buffer(buffer) {}
+
+  /// Starts the family of metrics `name` of the given `type` (e.g., "counter"), described by `help`.
+  Exposition& family(std::string_view name, std::string_view type, std::string_view help) {
+    buffer.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    buffer.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    return *this;
+  }
+
+  /// Appends a sample of the metric `name` with the given labels, which are either empty or a
+  /// comma-separated list of `key="value"` pairs.
+  Exposition& sample(std::string_view name, std::string_view labels, double value) {
+    char v[32];
+    std::snprintf(v, sizeof(v), "%.17g", value);
+    buffer.append(name);
+    if (!labels.empty()) buffer.append("{").append(labels).append("}");
+    buffer.append(" ").append(v).append("\n");
+    return *this;
+  }
+
+};
+
+/// Counters of the requests executed by a server, by operation and outcome, and histograms of
+/// their latency.
+///
+/// Each thread updates its own set of counters, allocated the first time it records a request, so
+/// that recording never contends with other threads: counters are only written by their owner with
+/// plain relaxed stores and are summed across threads when metrics are collected.
+class RequestMetrics final {
+public:
+
+  /// The number of operation codes, including the unused code 0.
+  static constexpr std::size_t operation_count = 9;
+
+  /// The number of outcomes of a request, which are the `protocol::Status` codes.
+  static constexpr std::size_t status_count = 3;
+
+  /// The upper bounds of the latency histogram buckets, in seconds, excluding the last bucket
+  /// whose upper bound is infinite.
+  static constexpr std::array<double, 14> bucket_bounds{
+    1e-6, 2.5e-6, 5e-6, 1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 1e-2, 1e-1, 1
+  };
+
+  /// The counters of one thread.
+  struct Counters {
+
+    /// The number of requests, by operation and outcome.
+    std::array<std::array<std::atomic<std::uint64_t>, status_count>, operation_count> requests{};
+
+    /// The number of executed requests in each latency bucket, by operation.
+    std::array<std::array<std::atomic<std::uint64_t>, bucket_bounds.size() + 1>, operation_count> buckets{};
+
+    /// The total latency of executed requests, in nanoseconds, by operation.
+    std::array<std::atomic<std::uint64_t>, operation_count> latency_ns{};
+
+  };
+
+  /// The totals of the counters of all threads.
+  struct Totals {
+
+    /// The number of requests, by operation and outcome.
+    std::array<std::array<std::uint64_t, status_count>, operation_count> requests{};
+
+    /// The number of executed requests in each latency bucket, by operation.
+    std::array<std::array<std::uint64_t, bucket_bounds.size() + 1>, operation_count> buckets{};
+
+    /// The total latency of executed requests, in nanoseconds, by operation.
+    std::array<std::uint64_t, operation_count> latency_ns{};
+
+  };
+
+private:
+
+  /// The lock protecting `threads`.
+  std::mutex mutex;
+
+  /// The counters of each thread that recorded requests.
+  std::vector<std::unique_ptr<Counters>> threads;
+
+  /// The number identifying this instance in the caches of the threads, which is never reused.
+  std::uint64_t identity;
+
+  /// Increments `x`, which is only written by the calling thread.
+  static void bump(std::atomic<std::uint64_t>& x, std::uint64_t n = 1) {
+    x.store(x.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  /// Returns the counters of the calling thread.
+  Counters& local() {
+    thread_local std::uint64_t owner = 0;
+    thread_local Counters* counters = nullptr;
+    thread_local std::unordered_map<std::uint64_t, Counters*> others;
+    if (owner == identity) return *counters;
+
+    // The thread records requests for another instance than the last time.
+    auto& c = others[identity];
+    if (c == nullptr) {
+      std::lock_guard l{mutex};
+      c = threads.emplace_back(std::make_unique<Counters>()).get();
+    }
+    owner = identity;
+    counters = c;
+    return *c;
+  }
+
+  /// Returns the index of `code` in the arrays of counters.
+  static std::size_t index(std::uint8_t code) {
+    return (code < operation_count) ? code : 0;
+  }
+
+public:
+
+  RequestMetrics() {
+    static std::atomic<std::uint64_t> next_identity = 1;
+    identity = next_identity.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  RequestMetrics(RequestMetrics const&) = delete;
+  RequestMetrics& operator=(RequestMetrics const&) = delete;
+
+  /// Records a request performing `operation` that completed with `status` after `ns` nanoseconds.
+  void observe(std::uint8_t operation, protocol::Status status, std::uint64_t ns) {
+    auto& c = local();
+    auto o = index(operation);
+    bump(c.requests[o][static_cast<std::size_t>(status)]);
+    auto seconds = static_cast<double>(ns) * 1e-9;
+    std::size_t b = 0;
+    while ((b < bucket_bounds.size()) && (seconds > bucket_bounds[b])) ++b;
+    bump(c.buckets[o][b]);
+    bump(c.latency_ns[o], ns);
+  }
+
+  /// Records a request performing `operation` that was rejected without being executed.
+  void reject(std::uint8_t operation) {
+    bump(local().requests[index(operation)][static_cast<std::size_t>(protocol::Status::Busy)]);
+  }
+
+  /// Returns the sums of the counters of all threads.
+  Totals totals() {
+    Totals t;
+    std::lock_guard l{mutex};
+    for (auto const& c : threads) {
+      for (std::size_t o = 0; o < operation_count; ++o) {
+        for (std::size_t s = 0; s < status_count; ++s) {
+          t.requests[o][s] += c->requests[o][s].load(std::memory_order_relaxed);
+        }
+        for (std::size_t b = 0; b <= bucket_bounds.size(); ++b) {
+          t.buckets[o][b] += c->buckets[o][b].load(std::memory_order_relaxed);
+        }
+        t.latency_ns[o] += c->latency_ns[o].load(std::memory_order_relaxed);
+      }
+    }
+    return t;
+  }
+
+  /// Appends the metrics of this instance to `output`.
+  void expose(Exposition& output) {
+    static constexpr char const* operations[operation_count] = {
+      "unknown", "create_table", "insert", "record", "find_string", "scan", "insert_batch",
+      "insert_string", "summarize"
+    };
+    static constexpr char const* statuses[status_count] = {"ok", "error", "busy"};
+
+    auto t = totals();
+    output.family("dummydb_requests_total", "counter", "Requests received, by operation and outcome.");
+    for (std::size_t o = 0; o < operation_count; ++o) {
+      for (std::size_t s = 0; s < status_count; ++s) {
+        if (t.requests[o][s] == 0) continue;
+        auto labels = std::string("operation=\"") + operations[o] + "\",status=\"" + statuses[s] + "\"";
+        output.sample("dummydb_requests_total", labels, static_cast<double>(t.requests[o][s]));
+      }
+    }
+
+    output.family("dummydb_request_duration_seconds", "histogram", "Time spent executing requests.");
+    for (std::size_t o = 0; o < operation_count; ++o) {
+      std::uint64_t n = 0;
+      for (auto b : t.buckets[o]) n += b;
+      if (n == 0) continue;
+
+      auto operation = std::string("operation=\"") + operations[o] + "\"";
+      std::uint64_t cumulative = 0;
+      for (std::size_t b = 0; b <= bucket_bounds.size(); ++b) {
+        cumulative += t.buckets[o][b];
+        char le[32];
+        if (b < bucket_bounds.size()) {
+          std::snprintf(le, sizeof(le), "%g", bucket_bounds[b]);
+        } else {
+          std::snprintf(le, sizeof(le), "+Inf");
+        }
+        output.sample("dummydb_request_duration_seconds_bucket", operation + ",le=\"" + le + "\"",
+          static_cast<double>(cumulative));
+      }
+      output.sample("dummydb_request_duration_seconds_sum", operation, static_cast<double>(t.latency_ns[o]) * 1e-9);
+      output.sample("dummydb_request_duration_seconds_count", operation, static_cast<double>(n));
+    }
+  }
+
+};
+
+/// Appends the metrics describing the contents of `db` to `output`.
+///
+/// The caller must ensure that `db` is not modified concurrently.
+inline void expose_database(DummyDB const& db, Exposition& output) {
+  output.family("dummydb_tables", "gauge", "Number of tables.");
+  output.sample("dummydb_tables", "", static_cast<double>(db.table_count()));
+  output.family("dummydb_tables_max", "gauge", "Maximum number of tables.");
+  output.sample("dummydb_tables_max", "", static_cast<double>(db.max_table_count()));
+
+  output.family("dummydb_table_records", "gauge", "Number of records, by table.");
+  for (std::size_t t = 0; t < db.table_count(); ++t) {
+    output.sample("dummydb_table_records", "table=\"" + std::to_string(t) + "\"",
+      static_cast<double>(db.record_count(t)));
+  }
+  output.family("dummydb_table_fill_ratio", "gauge", "Fraction of the capacity of a table in use, by table.");
+  for (std::size_t t = 0; t < db.table_count(); ++t) {
+    output.sample("dummydb_table_fill_ratio", "table=\"" + std::to_string(t) + "\"",
+      static_cast<double>(db.record_count(t)) / static_cast<double>(db.record_capacity(t)));
+  }
+
+  output.family("dummydb_string_heap_used_bytes", "gauge", "Bytes of the string table in use.");
+  output.sample("dummydb_string_heap_used_bytes", "", static_cast<double>(db.string_table_usage()));
+  output.family("dummydb_string_heap_capacity_bytes", "gauge", "Size of the string table.");
+  output.sample("dummydb_string_heap_capacity_bytes", "", static_cast<double>(DummyDB::string_table_size));
+
+  output.family("dummydb_storage_bytes", "gauge", "Bytes allocated for the storage of the database.");
+  output.sample("dummydb_storage_bytes", "", static_cast<double>(db.storage_size()));
+  output.family("dummydb_storage_used_bytes", "gauge", "Bytes of the storage of the database holding data.");
+  output.sample("dummydb_storage_used_bytes", "", static_cast<double>(db.footprint().used));
+  if (auto r = db.resident_size(); r != not_found) {
+    output.family("dummydb_storage_resident_bytes", "gauge", "Bytes of the storage backed by physical memory.");
+    output.sample("dummydb_storage_resident_bytes", "", static_cast<double>(r));
+  }
+}
+
+/// Appends the memory footprint of the current process to `output`.
+inline void expose_process(Exposition& output) {
+  std::ifstream statm{"/proc/self/statm"};
+  std::size_t size = 0, resident = 0;
+  if (!(statm >> size >> resident)) return;
+  auto page = static_cast<double>(::sysconf(_SC_PAGESIZE));
+  output.family("process_virtual_memory_bytes", "gauge", "Virtual memory size in bytes.");
+  output.sample("process_virtual_memory_bytes", "", static_cast<double>(size) * page);
+  output.family("process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+  output.sample("process_resident_memory_bytes", "", static_cast<double>(resident) * page);
+}
+
+/// A minimal HTTP server exposing metrics to Prometheus on `GET /metrics`.
+///
+/// Scrapes are served one at a time by a dedicated thread, so collecting metrics never runs on the
+/// threads serving the database.
+class MetricsListener final {
+public:
+
+  /// A function returning the metrics to expose in the Prometheus text format.
+  using Collect = std::function<std::string()>;
+
+private:
+
+  /// The function collecting the metrics.
+  Collect collect;
+
+  /// The listening socket, or -1 if the instance is not listening.
+  int listener;
+
+  /// `true` iff the instance is being stopped.
+  std::atomic<bool> stopping;
+
+  /// The thread serving scrapes.
+  std::thread acceptor;
+
+  /// Sends `response` on `fd`.
+  static void send_all(int fd, std::string_view response) {
+    while (!response.empty()) {
+      auto n = ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+      if ((n < 0) && (errno == EINTR)) continue;
+      if (n <= 0) return;
+      response.remove_prefix(static_cast<std::size_t>(n));
+    }
+  }
+
+  /// Serves one request on `fd`.
+  void serve(int fd) {
+    // Read the request head, giving up on clients that are too slow or send too much.
+    std::string request;
+    char chunk[1024];
+    while ((request.find("\r\n\r\n") == std::string::npos) && (request.size() < 8192)) {
+      pollfd p{fd, POLLIN, 0};
+      if (::poll(&p, 1, 1000) <= 0) return;
+      auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) return;
+      request.append(chunk, static_cast<std::size_t>(n));
+    }
+
+    std::string status = "404 Not Found", body = "not found\n";
+    if (request.starts_with("GET /metrics ") || request.starts_with("GET /metrics?")) {
+      status = "200 OK";
+      body = collect();
+    }
+    auto response = "HTTP/1.1 " + status + "\r\n"
+      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+      "Content-Length: " + std::to_string(body.size()) + "\r\n"
+      "Connection: close\r\n\r\n" + body;
+    send_all(fd, response);
+  }
+
+  /// Serves scrapes until the instance is stopped.
+  void accept() {
+    while (!stopping) {
+      auto fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        return;
+      }
+      serve(fd);
+      ::close(fd);
+    }
+  }
+
+public:
+
+  /// Creates an instance exposing the metrics returned by `collect`.
+  explicit MetricsListener(Collect collect)
+    : collect(std::move(collect)), listener(-1), stopping(false)
+  {}
+
+  MetricsListener(MetricsListener const&) = delete;
+  MetricsListener& operator=(MetricsListener const&) = delete;
+
+  ~MetricsListener() {
+    stop();
+    if (listener >= 0) ::close(listener);
+  }
+
+  /// Accepts scrapes on `host`:`port` and returns the port, which is chosen by the system if `port`
+  /// is 0.
+  std::uint16_t listen_tcp(std::uint16_t port, std::string const& host = "127.0.0.1") {
+    if (listener >= 0) {
+      throw std::logic_error("metrics listener is already listening");
+    }
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &a.sin_addr) != 1) {
+      throw std::invalid_argument("invalid address: " + host);
+    }
+
+    auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if ((fd < 0) || (::bind(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a)) < 0) || (::listen(fd, 16) < 0)) {
+      auto e = errno;
+      if (fd >= 0) ::close(fd);
+      throw std::system_error(e, std::generic_category(), "bind");
+    }
+    listener = fd;
+
+    socklen_t n = sizeof(a);
+    ::getsockname(listener, reinterpret_cast<sockaddr*>(&a), &n);
+    return ntohs(a.sin_port);
+  }
+
+  /// Starts serving scrapes.
+  void start() {
+    acceptor = std::thread([this] { accept(); });
+  }
+
+  /// Stops serving scrapes.
+  void stop() {
+    if (stopping.exchange(true)) return;
+    if (listener >= 0) ::shutdown(listener, SHUT_RDWR);
+    if (acceptor.joinable()) acceptor.join();
+  }
+
+};
+
+}
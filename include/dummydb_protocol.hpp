@@ -0,0 +1,297 @@
+#pragma once
+
+#include "dummydb.hpp"
+
+#include <bit>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace ddb::protocol {
+
+// All integers are transmitted in the byte order of the host, which must be little-endian so that
+// hosts agree on the encoding without having to swap bytes.
+static_assert(std::endian::native == std::endian::little, "the protocol assumes little-endian hosts");
+
+/// The operation requested by a frame.
+///
+/// Each request frame carries one of these codes. Its payload is:
+/// - `CreateTable`: a schema.
+/// - `Insert`: a table identity (u64) followed by a record.
+/// - `Record`: a table identity (u64) followed by a record identity (u64).
+/// - `FindString`: a string.
+/// - `Scan`: a table identity (u64), the identity of the first record (u64), and the maximum
+///   number of records to return (u64).
+/// - `InsertBatch`: a table identity (u64), a number of records (u32), and as many records.
+/// - `InsertString`: a string.
+/// - `Summarize`: a table identity (u64) followed by the index of a numeric column (u8).
+enum class Opcode : std::uint8_t {
+  CreateTable = 1, Insert = 2, Record = 3, FindString = 4, Scan = 5, InsertBatch = 6,
+  InsertString = 7, Summarize = 8
+};
+
+/// The outcome of a request.
+///
+/// Each response frame carries one of these codes. If it is `Ok`, the payload is:
+/// - `CreateTable`: the identity of the new table (u64).
+/// - `Insert`: the identity of the new record (u64).
+/// - `Record`: a record.
+/// - `FindString`: the identity of the string (u64), which is `not_found` if it is absent.
+/// - `Scan`: a number of records (u64) followed by as many records.
+/// - `InsertBatch`: the identity of the first record inserted (u64) and the number of records
+///   inserted (u32), whose identities are consecutive. Fewer records than requested are inserted
+///   if the table becomes full, in which case the remaining ones are dropped.
+/// - `InsertString`: the identity of the string (u64).
+/// - `Summarize`: a summary.
+///
+/// Otherwise, the payload is a string describing the error. `Busy` signals that the server shed
+/// the request without executing it because it is overloaded or the client exceeded its limits, in
+/// which case the request may be retried later.
+enum class Status : std::uint8_t {
+  Ok = 0, Error = 1, Busy = 2
+};
+
+/// The size of the header of a frame: its length (u32), its request identity (u32), and its code
+/// (u8). The length of a frame does not include the length field itself.
+constexpr std::size_t frame_header_size = 9;
+
+/// The maximum size of a frame, excluding its length field.
+constexpr std::size_t max_frame_size = std::size_t{1} << 24;
+
+/// An error signaling that a peer violated the protocol.
+struct ProtocolError : std::runtime_error {
+  using std::runtime_error::runtime_error;
+};
+
+/// A frame parsed from a buffer.
+struct Frame {
+
+  /// The identity of the request, which the response echoes so that clients can pipeline requests.
+  std::uint32_t request_identity;
+
+  /// The `Opcode` of a request or the `Status` of a response.
+  std::uint8_t code;
+
+  /// The payload of the frame.
+  std::string_view payload;
+
+  /// The number of bytes occupied by the frame in the buffer from which it was parsed.
+  std::size_t size;
+
+};
+
+/// Returns the frame at the start of `bytes`, or `std::nullopt` if `bytes` does not contain a
+/// complete frame yet.
+inline std::optional<Frame> next_frame(std::string_view bytes) {
+  if (bytes.size() < frame_header_size) return std::nullopt;
+
+  std::uint32_t n;
+  std::memcpy(&n, bytes.data(), sizeof(n));
+  if ((n < (frame_header_size - sizeof(n))) || (n > max_frame_size)) {
+    throw ProtocolError("invalid frame length");
+  } else if (bytes.size() < (n + sizeof(n))) {
+    return std::nullopt;
+  }
+
+  Frame f;
+  std::memcpy(&f.request_identity, bytes.data() + sizeof(n), sizeof(f.request_identity));
+  f.code = static_cast<std::uint8_t>(bytes[frame_header_size - 1]);
+  f.payload = bytes.substr(frame_header_size, n + sizeof(n) - frame_header_size);
+  f.size = n + sizeof(n);
+  return f;
+}
+
+/// An object appending a frame to a buffer.
+///
+/// The length of the frame is written by `end`, which must be called once the payload is complete.
+class Writer final {
+private:
+
+  /// The buffer to which the frame is appended.
+  std::string& buffer;
+
+  /// The position of the frame in `buffer`.
+  std::size_t start;
+
+  /// Appends the bytes of `x`.
+  template<typename T>
+  void raw(T x) {
+    buffer.append(reinterpret_cast<char const*>(&x), sizeof(T));
+  }
+
+public:
+
+  /// Starts a frame with the given request identity and code at the end of `buffer`.
+  Writer(std::string& buffer, std::uint32_t request_identity, std::uint8_t code)
+    : buffer(buffer), start(buffer.size())
+  {
+    raw(std::uint32_t{0});
+    raw(request_identity);
+    raw(code);
+  }
+
+  /// Appends `x`.
+  Writer& u8(std::uint8_t x) { raw(x); return *this; }
+
+  /// Appends `x`.
+  Writer& u32(std::uint32_t x) { raw(x); return *this; }
+
+  /// Appends `x`.
+  Writer& u64(std::uint64_t x) { raw(x); return *this; }
+
+  /// Appends `x`.
+  Writer& i32(std::int32_t x) { raw(x); return *this; }
+
+  /// Appends `x`.
+  Writer& f64(double x) { raw(x); return *this; }
+
+  /// Appends the raw contents of `s`.
+  Writer& bytes(std::string_view s) {
+    buffer.append(s);
+    return *this;
+  }
+
+  /// Appends `s`, prefixed by its length (u32).
+  Writer& string(std::string_view s) {
+    u32(static_cast<std::uint32_t>(s.size()));
+    buffer.append(s);
+    return *this;
+  }
+
+  /// Appends `v`, prefixed by the `FieldType` of its alternative (u8).
+  Writer& value(Value const& v) {
+    switch (v.index()) {
+      case Integer: return u8(Integer).i32(std::get<Integer>(v));
+      case Float: return u8(Float).f64(std::get<Float>(v));
+      default: return u8(String).string(std::get<String>(v));
+    }
+  }
+
+  /// Appends `r`, prefixed by its number of fields (u8).
+  Writer& record(std::vector<Value> const& r) {
+    u8(static_cast<std::uint8_t>(r.size()));
+    for (auto const& v : r) value(v);
+    return *this;
+  }
+
+  /// Appends the count (u64), sum (f64), minimum (f64), and maximum (f64) of `s`.
+  Writer& summary(Summary const& s) {
+    return u64(s.count).f64(s.sum).f64(s.min).f64(s.max);
+  }
+
+  /// Appends `s`, prefixed by its number of fields (u8).
+  Writer& schema(std::vector<FieldType> const& s) {
+    u8(static_cast<std::uint8_t>(s.size()));
+    for (auto f : s) u8(f);
+    return *this;
+  }
+
+  /// Completes the frame.
+  void end() {
+    auto n = static_cast<std::uint32_t>(buffer.size() - start - sizeof(std::uint32_t));
+    std::memcpy(buffer.data() + start, &n, sizeof(n));
+  }
+
+};
+
+/// An object decoding the payload of a frame.
+///
+/// All methods throw `ProtocolError` if the payload is too short to contain what they decode.
+class Reader final {
+private:
+
+  /// The bytes that have not been decoded yet.
+  std::string_view bytes;
+
+  /// Decodes a trivially copyable value.
+  template<typename T>
+  T raw() {
+    T x;
+    std::memcpy(&x, take(sizeof(T)).data(), sizeof(T));
+    return x;
+  }
+
+  /// Consumes and returns the next `n` bytes.
+  std::string_view take(std::size_t n) {
+    if (bytes.size() < n) {
+      throw ProtocolError("truncated payload");
+    }
+    auto r = bytes.substr(0, n);
+    bytes.remove_prefix(n);
+    return r;
+  }
+
+public:
+
+  /// Creates an instance decoding `payload`.
+  explicit Reader(std::string_view payload) : bytes(payload) {}
+
+  /// Returns `true` iff the whole payload was decoded.
+  bool empty() const { return bytes.empty(); }
+
+  /// Returns the number of bytes that have not been decoded yet.
+  std::size_t remaining() const { return bytes.size(); }
+
+  /// Decodes an unsigned 8-bit integer.
+  std::uint8_t u8() { return raw<std::uint8_t>(); }
+
+  /// Decodes an unsigned 32-bit integer.
+  std::uint32_t u32() { return raw<std::uint32_t>(); }
+
+  /// Decodes an unsigned 64-bit integer.
+  std::uint64_t u64() { return raw<std::uint64_t>(); }
+
+  /// Decodes a signed 32-bit integer.
+  std::int32_t i32() { return raw<std::int32_t>(); }
+
+  /// Decodes a double-precision floating-point number.
+  double f64() { return raw<double>(); }
+
+  /// Decodes a string, returning a view into the payload.
+  std::string_view string() { return take(u32()); }
+
+  /// Decodes a field type.
+  FieldType field_type() {
+    auto f = u8();
+    if (f > String) {
+      throw ProtocolError("invalid field type");
+    }
+    return static_cast<FieldType>(f);
+  }
+
+  /// Decodes a value.
+  Value value() {
+    switch (field_type()) {
+      case Integer: return i32();
+      case Float: return f64();
+      default: return std::string{string()};
+    }
+  }
+
+  /// Decodes a record.
+  std::vector<Value> record() {
+    std::vector<Value> r(u8());
+    for (auto& v : r) v = value();
+    return r;
+  }
+
+  /// Decodes a summary.
+  Summary summary() {
+    Summary s;
+    s.count = u64();
+    s.sum = f64();
+    s.min = f64();
+    s.max = f64();
+    return s;
+  }
+
+  /// Decodes a schema.
+  std::vector<FieldType> schema() {
+    std::vector<FieldType> s(u8());
+    for (auto& f : s) f = field_type();
+    return s;
+  }
+
+};
+
+}
@@ -0,0 +1,635 @@
+#pragma once
+
+#include "dummydb.hpp"
+#include "dummydb_client.hpp"
+#include "dummydb_protocol.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ddb {
+
+/// Log shipping from a primary to its replicas.
+///
+/// A primary appends every modification of its database to a `ReplicationLog`, whose entries are
+/// frames of the client protocol (see `dummydb_protocol.hpp`) whose code is the `Opcode` of the
+/// modification and whose payload is the log sequence number (LSN) of the entry (u64), the time at
+/// which it was appended in nanoseconds since the Unix epoch (u64), and the payload of the request
+/// that performed the modification. Replaying the entries in order on an empty database yields an
+/// identical database, including the identities of tables, records, and strings.
+///
+/// A replica connects to the primary's `LogShipper` and sends an acknowledgement carrying the LSN
+/// of the last entry that it applied, after which the primary streams every subsequent entry. The
+/// replica acknowledges the entries it applies so that the primary can track its progress, and the
+/// primary sends heartbeats when its log is idle so that the replica can measure its lag.
+namespace replication {
+
+/// The code of a heartbeat frame, whose payload is the LSN of the last entry of the primary's log
+/// (u64) and the time at which it was sent (u64).
+constexpr std::uint8_t heartbeat = 0;
+
+/// The code of an acknowledgement frame, whose payload is the LSN of the last entry applied by the
+/// replica (u64).
+constexpr std::uint8_t acknowledgement = 0;
+
+/// The size of the prefix of the payload of a log entry preceding the payload of its request.
+constexpr std::size_t entry_prefix_size = 2 * sizeof(std::uint64_t);
+
+/// Returns the current time in nanoseconds since the Unix epoch.
+inline std::uint64_t now() {
+  auto t = std::chrono::system_clock::now().time_since_epoch();
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+}
+
+/// Sends all of `bytes` on `fd`, returning `false` iff the connection failed.
+inline bool send_all(int fd, std::string_view bytes) {
+  while (!bytes.empty()) {
+    auto n = ::send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL);
+    if ((n < 0) && (errno == EINTR)) continue;
+    if (n <= 0) return false;
+    bytes.remove_prefix(static_cast<std::size_t>(n));
+  }
+  return true;
+}
+
+/// Calls `f` on each frame read from `fd` until `f` returns `false` or the connection is closed.
+///
+/// Throws `protocol::ProtocolError` if the peer sends an invalid frame, and whatever `f` throws,
+/// e.g., when a frame is too short for its code. Callers running on their own thread must catch
+/// them, since a peer must not be able to terminate the process.
+template<typename F>
+void receive_frames(int fd, F f) {
+  std::string input;
+  char chunk[65536];
+  while (true) {
+    auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+    if ((n < 0) && (errno == EINTR)) continue;
+    if (n <= 0) return;
+    input.append(chunk, static_cast<std::size_t>(n));
+
+    std::size_t consumed = 0;
+    while (auto frame = protocol::next_frame(std::string_view{input}.substr(consumed))) {
+      consumed += frame->size;
+      if (!f(*frame)) return;
+    }
+    input.erase(0, consumed);
+  }
+}
+
+}
+
+/// The log of the modifications of a primary database.
+///
+/// The log is kept in memory and is never trimmed, since replicas that join late catch up from its
+/// first entry, so it grows with every modification of the database (including insertions of
+/// strings that were already stored) rather than with the contents of the database.
+class ReplicationLog final {
+private:
+
+  /// The lock protecting the state of the log.
+  mutable std::mutex mutex;
+
+  /// The condition signaled when an entry is appended or the log is closed.
+  mutable std::condition_variable changed;
+
+  /// The entries, back to back.
+  std::string entries;
+
+  /// The end of each entry in `entries`, indexed by LSN - 1.
+  std::vector<std::size_t> ends;
+
+  /// `true` iff the log has been closed.
+  bool closed;
+
+public:
+
+  /// Creates an empty log.
+  ReplicationLog() : closed(false) {}
+
+  /// Appends an entry for the modification `operation`, whose request payload is written by
+  /// `encode(w)` where `w` is a `protocol::Writer`, and returns its LSN.
+  ///
+  /// Entries must be appended in the order in which the modifications are applied, which is
+  /// typically achieved by appending them while holding the lock of the database.
+  template<typename Encode>
+  std::uint64_t append(protocol::Opcode operation, Encode encode) {
+    std::uint64_t lsn;
+    {
+      std::lock_guard l{mutex};
+      lsn = ends.size() + 1;
+      protocol::Writer w{entries, 0, std::uint8_t(operation)};
+      w.u64(lsn).u64(replication::now());
+      encode(w);
+      w.end();
+      ends.push_back(entries.size());
+    }
+    changed.notify_all();
+    return lsn;
+  }
+
+  /// Returns the LSN of the last entry, which is 0 if the log is empty.
+  std::uint64_t last_lsn() const {
+    std::lock_guard l{mutex};
+    return ends.size();
+  }
+
+  /// Appends the entries following the one whose LSN is `lsn` to `output`, waiting up to `timeout`
+  /// for an entry to be appended if there are none, and returns the LSN of the last entry copied
+  /// (or `lsn` if none was).
+  std::uint64_t read(std::uint64_t lsn, std::string& output, std::chrono::milliseconds timeout) const {
+    std::unique_lock l{mutex};
+    changed.wait_for(l, timeout, [&] { return closed || (ends.size() > lsn); });
+    if (ends.size() <= lsn) return lsn;
+    auto start = (lsn == 0) ? 0 : ends[lsn - 1];
+    output.append(entries, start, ends.back() - start);
+    return ends.size();
+  }
+
+  /// Wakes up the readers waiting for entries.
+  void close() {
+    {
+      std::lock_guard l{mutex};
+      closed = true;
+    }
+    changed.notify_all();
+  }
+
+};
+
+/// The replication status of a replica as observed by its primary.
+struct ReplicaStatus {
+
+  /// The LSN of the last entry sent to the replica.
+  std::uint64_t sent_lsn;
+
+  /// The LSN of the last entry that the replica acknowledged.
+  std::uint64_t acknowledged_lsn;
+
+  /// The number of entries of the log that the replica has not acknowledged yet.
+  std::uint64_t lag;
+
+  /// `true` iff the replica is connected.
+  bool connected;
+
+};
+
+/// An object streaming a replication log to the replicas connected to it.
+class LogShipper final {
+private:
+
+  /// The connection to a replica.
+  struct Link {
+
+    /// The socket.
+    int fd = -1;
+
+    /// The LSN of the last entry sent.
+    std::atomic<std::uint64_t> sent{0};
+
+    /// The LSN of the last entry acknowledged.
+    std::atomic<std::uint64_t> acknowledged{0};
+
+    /// `true` iff the replica is connected.
+    std::atomic<bool> connected{true};
+
+    /// `true` once the replica has sent the acknowledgement of the last entry it applied.
+    std::atomic<bool> greeted{false};
+
+    /// `true` once the replica has greeted the shipper or disconnected, which the sender awaits.
+    std::atomic<bool> ready{false};
+
+    /// The number of threads of the link that have finished, which can be joined without
+    /// blocking once both have.
+    std::atomic<int> finished{0};
+
+    /// The thread sending entries and heartbeats.
+    std::thread sender;
+
+    /// The thread receiving the greeting and the acknowledgements of the replica.
+    std::thread receiver;
+
+  };
+
+  /// The log being shipped.
+  ReplicationLog& log;
+
+  /// The listening socket.
+  int listener;
+
+  /// The path of the Unix-domain socket to remove when the shipper is destroyed.
+  std::string socket_path;
+
+  /// The thread accepting replicas.
+  std::thread acceptor;
+
+  /// The lock protecting `links`.
+  mutable std::mutex mutex;
+
+  /// The connections to replicas.
+  std::vector<std::unique_ptr<Link>> links;
+
+  /// `true` iff the shipper is stopping.
+  std::atomic<bool> stopping;
+
+  /// The interval at which heartbeats are sent when the log is idle.
+  static constexpr std::chrono::milliseconds heartbeat_interval{100};
+
+  /// Streams the log to the replica connected by `k`, once it has greeted the shipper.
+  void send(Link& k) {
+    k.ready.wait(false);
+    std::string buffer;
+    auto lsn = k.acknowledged.load();
+    while (!stopping && k.connected) {
+      buffer.clear();
+      auto last = log.read(lsn, buffer, heartbeat_interval);
+      if (last == lsn) {
+        protocol::Writer(buffer, 0, replication::heartbeat)
+          .u64(log.last_lsn()).u64(replication::now()).end();
+      }
+      if (!replication::send_all(k.fd, buffer)) break;
+      lsn = last;
+      k.sent = lsn;
+    }
+    disconnect(k);
+  }
+
+  /// Marks the link `k` disconnected and shuts its socket down, so that its other thread stops too,
+  /// when one of its threads finishes.
+  static void disconnect(Link& k) {
+    k.connected = false;
+    ::shutdown(k.fd, SHUT_RDWR);
+    k.ready = true;
+    k.ready.notify_all();
+    k.finished.fetch_add(1);
+  }
+
+  /// Receives the acknowledgements of the replica connected by `k`, the first of which is the
+  /// acknowledgement of the last entry it applied, from which its log is streamed.
+  ///
+  /// A replica sending an invalid frame is disconnected.
+  void receive(Link& k) {
+    try {
+      replication::receive_frames(k.fd, [&](protocol::Frame const& f) {
+        k.acknowledged = protocol::Reader{f.payload}.u64();
+        if (!k.greeted) {
+          k.sent = k.acknowledged.load();
+          k.greeted = true;
+          k.ready = true;
+          k.ready.notify_all();
+        }
+        return true;
+      });
+    } catch (std::exception const&) {
+      // Fall through to disconnect the replica.
+    }
+    disconnect(k);
+  }
+
+  /// Joins the threads and closes the sockets of the links whose threads have both finished, and
+  /// forgets them.
+  void reap() {
+    std::lock_guard l{mutex};
+    std::erase_if(links, [](auto const& k) {
+      if (k->finished < 2) return false;
+      k->sender.join();
+      k->receiver.join();
+      ::close(k->fd);
+      return true;
+    });
+  }
+
+  /// Accepts replicas until the shipper is stopped.
+  void accept() {
+    while (!stopping) {
+      auto fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno == EINTR || errno == ECONNABORTED) continue;
+        return;
+      }
+
+      // Replicas reconnect after failures, so the links of those that left are released here.
+      reap();
+
+      // The greeting of the replica is read by its receiver so that a replica that never sends
+      // one does not hold up the others.
+      auto k = std::make_unique<Link>();
+      k->fd = fd;
+      k->sender = std::thread([this, p = k.get()] { send(*p); });
+      k->receiver = std::thread([this, p = k.get()] { receive(*p); });
+      std::lock_guard l{mutex};
+      links.push_back(std::move(k));
+    }
+  }
+
+  /// Creates a socket listening on `address`.
+  void listen(int domain, sockaddr const* address, socklen_t size) {
+    if (listener >= 0) {
+      throw std::logic_error("log shipper is already listening");
+    }
+    auto fd = ::socket(domain, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if ((fd < 0) || (::bind(fd, address, size) < 0) || (::listen(fd, SOMAXCONN) < 0)) {
+      auto e = errno;
+      if (fd >= 0) ::close(fd);
+      throw std::system_error(e, std::generic_category(), "bind");
+    }
+    listener = fd;
+  }
+
+public:
+
+  /// Creates an instance shipping `log`.
+  explicit LogShipper(ReplicationLog& log) : log(log), listener(-1), stopping(false) {}
+
+  LogShipper(LogShipper const&) = delete;
+  LogShipper& operator=(LogShipper const&) = delete;
+
+  ~LogShipper() {
+    stop();
+    if (listener >= 0) ::close(listener);
+    if (!socket_path.empty()) ::unlink(socket_path.c_str());
+  }
+
+  /// Accepts replicas on `host`:`port` and returns the port, which is chosen by the system if
+  /// `port` is 0.
+  std::uint16_t listen_tcp(std::uint16_t port, std::string const& host = "127.0.0.1") {
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &a.sin_addr) != 1) {
+      throw std::invalid_argument("invalid address: " + host);
+    }
+    listen(AF_INET, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+    socklen_t n = sizeof(a);
+    ::getsockname(listener, reinterpret_cast<sockaddr*>(&a), &n);
+    return ntohs(a.sin_port);
+  }
+
+  /// Accepts replicas on the Unix-domain socket at `path`, replacing any existing file.
+  void listen_unix(std::string const& path) {
+    sockaddr_un a{};
+    a.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(a.sun_path)) {
+      throw std::invalid_argument("socket path is too long: " + path);
+    }
+    std::copy(path.begin(), path.end(), a.sun_path);
+    ::unlink(path.c_str());
+    listen(AF_UNIX, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+    socket_path = path;
+  }
+
+  /// Starts accepting replicas.
+  void start() {
+    acceptor = std::thread([this] { accept(); });
+  }
+
+  /// Disconnects the replicas and stops accepting new ones.
+  void stop() {
+    if (stopping.exchange(true)) return;
+    if (listener >= 0) ::shutdown(listener, SHUT_RDWR);
+    if (acceptor.joinable()) acceptor.join();
+
+    std::lock_guard l{mutex};
+    for (auto& k : links) {
+      ::shutdown(k->fd, SHUT_RDWR);
+      k->sender.join();
+      k->receiver.join();
+      ::close(k->fd);
+    }
+    links.clear();
+  }
+
+  /// Returns the status of each replica that has connected and greeted the shipper, in the order of
+  /// their connection.
+  std::vector<ReplicaStatus> replicas() const {
+    auto last = log.last_lsn();
+    std::vector<ReplicaStatus> result;
+    std::lock_guard l{mutex};
+    for (auto const& k : links) {
+      if (!k->greeted) continue;
+      auto a = k->acknowledged.load();
+      result.push_back({k->sent.load(), a, last - std::min(a, last), k->connected.load()});
+    }
+    return result;
+  }
+
+};
+
+/// The replication lag of a replica as observed by the replica.
+struct ReplicationLag {
+
+  /// The LSN of the last entry applied.
+  std::uint64_t applied_lsn;
+
+  /// The LSN of the last entry of the primary's log known to the replica.
+  std::uint64_t primary_lsn;
+
+  /// The number of entries known to have been appended to the primary's log but not applied.
+  std::uint64_t entries;
+
+  /// The time elapsed between the moment the last entry applied was appended to the primary's log
+  /// and the moment it was applied, in nanoseconds.
+  std::uint64_t apply_delay_ns;
+
+  /// `true` iff the replica is connected to its primary.
+  bool connected;
+
+};
+
+/// An object applying the log of a primary received from its `LogShipper`.
+///
+/// The replica reconnects to its primary if the connection is lost, resuming from the last entry
+/// it applied.
+class Replica final {
+public:
+
+  /// A function applying an entry, whose payload is the payload of the request that performed the
+  /// modification on the primary.
+  using Apply = std::function<void(protocol::Frame const&)>;
+
+private:
+
+  /// The address of the primary's log shipper.
+  Endpoint primary;
+
+  /// The function applying entries.
+  Apply apply;
+
+  /// The LSN of the last entry applied.
+  std::atomic<std::uint64_t> applied;
+
+  /// The LSN of the last entry of the primary's log known to the replica.
+  std::atomic<std::uint64_t> primary_lsn;
+
+  /// The apply delay of the last entry applied.
+  std::atomic<std::uint64_t> delay;
+
+  /// `true` iff the replica is connected.
+  std::atomic<bool> connected;
+
+  /// `true` iff the replica is stopping.
+  std::atomic<bool> stopping;
+
+  /// The lock protecting `fd` and `error`.
+  mutable std::mutex mutex;
+
+  /// The socket connected to the primary, or -1.
+  int fd;
+
+  /// The description of the last error of replication, if any.
+  std::string error;
+
+  /// The thread receiving and applying entries.
+  std::thread thread;
+
+  /// Receives and applies entries from the connection `s` until it fails.
+  ///
+  /// An invalid frame is recorded as the failure of the replica, which then reconnects.
+  void replicate(int s) {
+    std::string ack;
+    protocol::Writer(ack, 0, replication::acknowledgement).u64(applied).end();
+    if (!replication::send_all(s, ack)) return;
+    connected = true;
+
+    try {
+      receive(s, ack);
+    } catch (std::exception const& e) {
+      std::lock_guard l{mutex};
+      error = e.what();
+    }
+    connected = false;
+  }
+
+  /// Receives and applies entries from the connection `s`, acknowledging them with the buffer
+  /// `ack`, until it fails.
+  void receive(int s, std::string& ack) {
+    replication::receive_frames(s, [&](protocol::Frame const& f) {
+      protocol::Reader r{f.payload};
+      auto lsn = r.u64();
+      auto time = r.u64();
+      if (f.code == replication::heartbeat) {
+        primary_lsn = std::max(primary_lsn.load(), lsn);
+        return true;
+      } else if (lsn != applied + 1) {
+        return true;
+      }
+
+      auto entry = f;
+      entry.payload = f.payload.substr(replication::entry_prefix_size);
+      try {
+        apply(entry);
+      } catch (std::exception const& e) {
+        std::lock_guard l{mutex};
+        error = e.what();
+        stopping = true;
+        return false;
+      }
+      applied = lsn;
+      primary_lsn = std::max(primary_lsn.load(), lsn);
+      auto n = replication::now();
+      delay = (n > time) ? (n - time) : 0;
+
+      ack.clear();
+      protocol::Writer(ack, 0, replication::acknowledgement).u64(lsn).end();
+      return replication::send_all(s, ack);
+    });
+  }
+
+  /// Connects to the primary and replicates its log until the replica is stopped.
+  void run() {
+    while (!stopping) {
+      int s = -1;
+      try {
+        s = connect(primary);
+      } catch (std::exception const&) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        continue;
+      }
+      {
+        std::lock_guard l{mutex};
+        if (stopping) {
+          ::close(s);
+          return;
+        }
+        fd = s;
+      }
+      replicate(s);
+      {
+        std::lock_guard l{mutex};
+        fd = -1;
+      }
+      ::close(s);
+    }
+  }
+
+public:
+
+  /// Creates an instance applying the log shipped from `primary` with `apply`.
+  Replica(Endpoint primary, Apply apply)
+    : primary(std::move(primary)), apply(std::move(apply)),
+      applied(0), primary_lsn(0), delay(0), connected(false), stopping(false), fd(-1)
+  {}
+
+  Replica(Replica const&) = delete;
+  Replica& operator=(Replica const&) = delete;
+
+  ~Replica() {
+    stop();
+  }
+
+  /// Starts replicating.
+  void start() {
+    thread = std::thread([this] { run(); });
+  }
+
+  /// Stops replicating.
+  void stop() {
+    {
+      std::lock_guard l{mutex};
+      stopping = true;
+      if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+    }
+    if (thread.joinable()) thread.join();
+  }
+
+  /// Returns the replication lag of this replica.
+  ReplicationLag lag() const {
+    auto a = applied.load();
+    auto p = std::max(primary_lsn.load(), a);
+    return {a, p, p - a, delay.load(), connected.load()};
+  }
+
+  /// Returns the description of the last error of replication, or an empty string.
+  ///
+  /// An error applying an entry stops replication, while an invalid frame only makes the replica
+  /// reconnect.
+  std::string failure() const {
+    std::lock_guard l{mutex};
+    return error;
+  }
+
+  /// Blocks until the entry whose LSN is `lsn` has been applied or `timeout` has elapsed, and
+  /// returns `true` iff it has been applied.
+  bool wait_for(std::uint64_t lsn, std::chrono::milliseconds timeout) const {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (applied < lsn) {
+      if (std::chrono::steady_clock::now() >= deadline) return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+
+};
+
+}
@@ -0,0 +1,449 @@
+#pragma once
+
+#include "dummydb.hpp"
+
+#include <cmath>
+#include <map>
+#include <random>
+
+namespace ddb {
+
+/// An estimate of a quantity of a population computed from a sample.
+struct Estimate {
+
+  /// The estimated value.
+  double value = std::numeric_limits<double>::quiet_NaN();
+
+  /// The half-width of the confidence interval of the estimate.
+  double margin = std::numeric_limits<double>::infinity();
+
+  /// Returns the lower bound of the confidence interval.
+  double lower() const {
+    return value - margin;
+  }
+
+  /// Returns the upper bound of the confidence interval.
+  double upper() const {
+    return value + margin;
+  }
+
+};
+
+/// Estimates of the summary statistics of a numeric column over a population of records.
+struct EstimatedSummary {
+
+  /// The estimated number of records.
+  Estimate count;
+
+  /// The estimated sum of the values.
+  Estimate sum;
+
+  /// The estimated mean of the values.
+  Estimate mean;
+
+  /// The exact statistics of the sampled values, whose minimum and maximum bound those of the
+  /// population from the inside.
+  Summary sample;
+
+};
+
+/// A random sample of the records of a set of tables.
+///
+/// Records are drawn by sampling units, which are either single records or whole tables, chosen
+/// uniformly at random without replacement. The records of a sampled table may themselves be a
+/// uniform sample of its records, in which case each of them stands for several records.
+struct Sample {
+
+  /// The sampled records, in the order of their units.
+  std::vector<RecordId> records;
+
+  /// The end of each unit in `records`, or nothing if each record is a unit.
+  std::vector<std::size_t> unit_ends;
+
+  /// The number of records of its table that each record of each unit stands for, or nothing if
+  /// each record stands for itself.
+  std::vector<double> unit_weights;
+
+  /// The number of units in the population.
+  std::size_t population = 0;
+
+  /// Whether sampled units are observed completely, in which case the variance of estimates
+  /// shrinks as the sample covers more of the population.
+  bool complete_units = true;
+
+  /// Returns the number of sampled units.
+  std::size_t unit_count() const {
+    return unit_ends.empty() ? records.size() : unit_ends.size();
+  }
+
+};
+
+/// A uniform random sample of a stream of items of unknown length.
+///
+/// Items are offered one at a time and kept with a probability such that, after `n` items, the
+/// reservoir holds a uniform sample of `min(n, capacity)` of them. Draws are only made for kept
+/// items, whose positions are chosen with Li's algorithm L, so `skip` tells callers able to seek
+/// how many items they may jump over without offering them.
+template<typename T>
+class Reservoir {
+private:
+
+  /// The maximum number of sampled items.
+  std::size_t capacity;
+
+  /// The number of items offered or skipped so far.
+  std::size_t seen = 0;
+
+  /// The number of items to pass over before the next one to keep.
+  std::size_t gap = 0;
+
+  /// The product of the uniform draws made so far, as in algorithm L.
+  double w = 1;
+
+  /// The sampled items.
+  std::vector<T> contents;
+
+  /// Draws the gap before the next kept item with `rng`.
+  template<std::uniform_random_bit_generator G>
+  void draw_gap(G& rng) {
+    std::uniform_real_distribution<double> u{std::numeric_limits<double>::min(), 1};
+    w *= std::exp(std::log(u(rng)) / static_cast<double>(capacity));
+    gap = static_cast<std::size_t>(std::min(std::floor(std::log(u(rng)) / std::log1p(-w)), 0x1p62));
+  }
+
+public:
+
+  /// Creates an empty reservoir of up to `capacity` items.
+  explicit Reservoir(std::size_t capacity) : capacity(capacity) {
+    contents.reserve(capacity);
+  }
+
+  /// Returns the number of items offered or skipped so far.
+  std::size_t count() const {
+    return seen;
+  }
+
+  /// Returns the number of the next items that would not be kept, which need not be offered.
+  std::size_t skip() const {
+    return (contents.size() < capacity) ? 0 : gap;
+  }
+
+  /// Accounts for `n` items that are passed over, which is at most `skip()`.
+  void pass(std::size_t n) {
+    seen += n;
+    gap -= n;
+  }
+
+  /// Offers `x`, drawing from `rng` if it is kept.
+  template<std::uniform_random_bit_generator G>
+  void offer(T x, G& rng) {
+    seen += 1;
+    if (contents.size() < capacity) {
+      contents.push_back(std::move(x));
+      if (contents.size() == capacity) draw_gap(rng);
+    } else if (gap > 0) {
+      gap -= 1;
+    } else if (capacity > 0) {
+      contents[std::uniform_int_distribution<std::size_t>{0, capacity - 1}(rng)] = std::move(x);
+      draw_gap(rng);
+    }
+  }
+
+  /// Returns the sampled items.
+  std::vector<T> const& items() const {
+    return contents;
+  }
+
+  /// Returns the sampled items, leaving the reservoir empty.
+  std::vector<T> take() {
+    return std::exchange(contents, {});
+  }
+
+};
+
+namespace sampling {
+
+/// Returns `k` distinct integers in [0, n) chosen uniformly at random with `rng`, in increasing
+/// order, using Floyd's algorithm so that the cost depends on `k` rather than `n`.
+template<std::uniform_random_bit_generator G>
+std::vector<std::size_t> choose(std::size_t n, std::size_t k, G& rng) {
+  k = std::min(k, n);
+  HashMap<std::size_t, bool> chosen{k};
+  for (auto j = n - k; j < n; ++j) {
+    auto x = std::uniform_int_distribution<std::size_t>{0, j}(rng);
+    chosen.try_emplace(chosen.contains(x) ? j : x, true);
+  }
+  std::vector<std::size_t> result;
+  result.reserve(k);
+  chosen.for_each([&](std::size_t x, bool) { result.push_back(x); });
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+/// Returns the value `z` such that a standard normal variable lies in [-z, z] with probability
+/// `confidence`.
+inline double critical_value(double confidence) {
+  if (!(confidence > 0) || !(confidence < 1)) {
+    throw std::invalid_argument("confidence must be in (0, 1)");
+  }
+  double a = 0, b = 40;
+  for (int i = 0; i < 64; ++i) {
+    auto z = (a + b) / 2;
+    (std::erf(z / std::sqrt(2.0)) < confidence) ? (a = z) : (b = z);
+  }
+  return (a + b) / 2;
+}
+
+/// The totals of a sampling unit restricted to one group of records.
+struct UnitTotals {
+
+  /// The weighted number of records of the group in the unit.
+  double count = 0;
+
+  /// The weighted sum of the values of the records of the group in the unit.
+  double sum = 0;
+
+};
+
+/// Returns estimates of the statistics of a population of `population` units from the totals of
+/// `units` of them drawn uniformly without replacement, with margins at the confidence whose
+/// critical value is `z`.
+///
+/// Totals are expanded by the number of units and means are estimated by the ratio of the sums
+/// to the counts, whose variance is linearized. The finite population correction applies only
+/// if `complete_units` is `true`, since subsampled units vary even when all are drawn.
+inline EstimatedSummary estimate(
+  std::vector<UnitTotals> const& units, std::size_t population, bool complete_units, double z
+) {
+  EstimatedSummary result;
+  auto m = static_cast<double>(units.size());
+  if (units.empty()) return result;
+
+  UnitTotals mean;
+  for (auto const& u : units) {
+    mean.count += u.count;
+    mean.sum += u.sum;
+  }
+  mean.count /= m;
+  mean.sum /= m;
+  auto ratio = (mean.count > 0) ? mean.sum / mean.count : std::numeric_limits<double>::quiet_NaN();
+  double count_variance = 0, sum_variance = 0, residual_variance = 0;
+  for (auto const& u : units) {
+    count_variance += (u.count - mean.count) * (u.count - mean.count);
+    sum_variance += (u.sum - mean.sum) * (u.sum - mean.sum);
+    auto e = u.sum - ratio * u.count;
+    residual_variance += e * e;
+  }
+  if (units.size() > 1) {
+    count_variance /= m - 1;
+    sum_variance /= m - 1;
+    residual_variance /= m - 1;
+  } else {
+    count_variance = sum_variance = residual_variance = std::numeric_limits<double>::infinity();
+  }
+
+  auto n = static_cast<double>(population);
+  auto f = complete_units ? (1 - m / n) : 1.0;
+  result.count = {n * mean.count, z * n * std::sqrt(f * count_variance / m)};
+  result.sum = {n * mean.sum, z * n * std::sqrt(f * sum_variance / m)};
+  result.mean = {ratio, z * std::sqrt(f * residual_variance / m) / mean.count};
+  if (complete_units && (units.size() == population)) {
+    result.count.margin = result.sum.margin = result.mean.margin = 0;
+  }
+  return result;
+}
+
+/// Returns the value of the numeric field `v`, throwing `std::invalid_argument` if it is a string.
+inline double numeric(Value const& v) {
+  if (auto x = std::get_if<std::int32_t>(&v)) return *x;
+  if (auto x = std::get_if<double>(&v)) return *x;
+  throw std::invalid_argument("column is not numeric");
+}
+
+/// Returns the values of the numeric column at index `column` of the records of `db` identified
+/// by `ids`, in the same order.
+///
+/// Runs of consecutive records of a table, which make up samples of whole tables, are copied
+/// with `project` rather than decoded record by record.
+inline std::vector<double> numeric_column(DummyDB const& db, std::span<RecordId const> ids, std::size_t column) {
+  std::vector<double> result(ids.size());
+  std::vector<std::int32_t> integers;
+  std::size_t columns[] = {column};
+  for (std::size_t i = 0, j = 0; i < ids.size(); i = j) {
+    auto t = ids[i].table();
+    auto first = db.row_number(ids[i]);
+    for (j = i + 1; (j < ids.size()) && (ids[j].table() == t) && (db.row_number(ids[j]) == first + (j - i)); ++j) {}
+    auto values = std::span{result}.subspan(i, j - i);
+    switch (db.schema(t).at(column)) {
+      case Integer: {
+        integers.resize(j - i);
+        ColumnBuffer buffers[] = {std::span{integers}};
+        db.project(t, columns, first, j - i, buffers);
+        std::copy(integers.begin(), integers.end(), values.begin());
+        break;
+      }
+
+      case Float: {
+        ColumnBuffer buffers[] = {values};
+        db.project(t, columns, first, j - i, buffers);
+        break;
+      }
+
+      default:
+        throw std::invalid_argument("column is not numeric");
+    }
+  }
+  return result;
+}
+
+}
+
+/// Returns a uniform sample of `n` of the records of the tables `tables` of `db`, drawn without
+/// replacement with `rng`.
+///
+/// Records are chosen individually, which gives the most accurate estimates for a number of
+/// records but reads each of them from a different place.
+template<std::uniform_random_bit_generator G>
+Sample sample_records(DummyDB const& db, std::span<std::size_t const> tables, std::size_t n, G& rng) {
+  std::vector<std::size_t> ends;
+  std::size_t total = 0;
+  for (auto t : tables) ends.push_back(total += db.record_count(t));
+
+  Sample result;
+  result.population = total;
+  std::size_t j = 0;
+  for (auto i : sampling::choose(total, n, rng)) {
+    while (ends[j] <= i) ++j;
+    result.records.push_back(db.record_id(tables[j], i - ((j == 0) ? 0 : ends[j - 1])));
+  }
+  return result;
+}
+
+/// Returns a uniform sample of `n` of the records of the tables `tables` of `db` drawn with a
+/// reservoir in a single pass over the tables with `rng`.
+///
+/// The sample is distributed like that of `sample_records`, but the number of records is only
+/// read once per table, so records appended to tables that were already passed are not sampled.
+template<std::uniform_random_bit_generator G>
+Sample reservoir_sample(DummyDB const& db, std::span<std::size_t const> tables, std::size_t n, G& rng) {
+  Reservoir<RecordId> r{n};
+  for (auto t : tables) {
+    auto m = db.record_count(t);
+    for (std::size_t i = 0; i < m; ++i) {
+      if (auto s = std::min(r.skip(), m - i); s > 0) {
+        r.pass(s);
+        i += s - 1;
+      } else {
+        r.offer(db.record_id(t, i), rng);
+      }
+    }
+  }
+
+  Sample result;
+  result.population = r.count();
+  result.records = r.take();
+  std::sort(result.records.begin(), result.records.end());
+  return result;
+}
+
+/// Returns a sample of `n` of the tables `tables` of `db` drawn without replacement with `rng`,
+/// in which at most `rows_per_table` records of each sampled table are drawn uniformly.
+///
+/// Each table is a unit whose records are stored together, so that a sample covering a number of
+/// records is read much faster than with `sample_records`, at the cost of wider confidence
+/// intervals when tables differ from one another. Subsampling the records of large tables
+/// bounds the cost of reading each of them.
+///
+/// Throws `std::invalid_argument` if `rows_per_table` is 0, since sampled tables would then
+/// represent their records without any of them.
+template<std::uniform_random_bit_generator G>
+Sample sample_tables(
+  DummyDB const& db, std::span<std::size_t const> tables, std::size_t n, G& rng,
+  std::size_t rows_per_table = not_found
+) {
+  if (rows_per_table == 0) {
+    throw std::invalid_argument("at least one row of each table must be sampled");
+  }
+  Sample result;
+  result.population = tables.size();
+  for (auto i : sampling::choose(tables.size(), n, rng)) {
+    auto t = tables[i];
+    auto m = db.record_count(t);
+    if (m <= rows_per_table) {
+      for (std::size_t j = 0; j < m; ++j) result.records.push_back(db.record_id(t, j));
+      result.unit_weights.push_back(1);
+    } else {
+      for (auto j : sampling::choose(m, rows_per_table, rng)) result.records.push_back(db.record_id(t, j));
+      result.unit_weights.push_back(static_cast<double>(m) / static_cast<double>(rows_per_table));
+      result.complete_units = false;
+    }
+    result.unit_ends.push_back(result.records.size());
+  }
+  return result;
+}
+
+/// Returns estimates of the statistics of the numeric column at index `column` over all the
+/// records that `sample`, drawn from `db`, represents, with confidence intervals at the level
+/// `confidence`.
+///
+/// Throws `std::invalid_argument` if the column is not numeric.
+inline EstimatedSummary estimate_summary(
+  DummyDB const& db, Sample const& sample, std::size_t column, double confidence = 0.95
+) {
+  auto z = sampling::critical_value(confidence);
+  auto values = sampling::numeric_column(db, sample.records, column);
+  std::vector<sampling::UnitTotals> units(sample.unit_count());
+  Summary s;
+  for (std::size_t u = 0, i = 0; u < units.size(); ++u) {
+    auto end = sample.unit_ends.empty() ? u + 1 : sample.unit_ends[u];
+    auto w = sample.unit_weights.empty() ? 1.0 : sample.unit_weights[u];
+    for (; i < end; ++i) {
+      auto x = values[i];
+      s.add(x);
+      units[u].count += w;
+      units[u].sum += w * x;
+    }
+  }
+  auto result = sampling::estimate(units, sample.population, sample.complete_units, z);
+  result.sample = s;
+  return result;
+}
+
+/// Returns estimates of the statistics of the numeric column at index `column` over all the
+/// records that `sample`, drawn from `db`, represents, grouped by the value of their column at
+/// index `key_column`, with confidence intervals at the level `confidence`.
+///
+/// Groups absent from the sample are missing from the result, so rare groups are best explored
+/// with larger samples. Throws `std::invalid_argument` if the column is not numeric.
+inline std::map<Value, EstimatedSummary> estimate_groups(
+  DummyDB const& db, Sample const& sample, std::size_t key_column, std::size_t column,
+  double confidence = 0.95
+) {
+  auto z = sampling::critical_value(confidence);
+  auto records = db.multi_get(sample.records);
+  auto n = sample.unit_count();
+
+  // Every group has totals for every unit, which are zero where the group is absent.
+  std::map<Value, std::pair<std::vector<sampling::UnitTotals>, Summary>> groups;
+  for (std::size_t u = 0, i = 0; u < n; ++u) {
+    auto end = sample.unit_ends.empty() ? u + 1 : sample.unit_ends[u];
+    auto w = sample.unit_weights.empty() ? 1.0 : sample.unit_weights[u];
+    for (; i < end; ++i) {
+      auto x = sampling::numeric(records[i].at(column));
+      auto& [units, s] = groups[records[i].at(key_column)];
+      units.resize(n);
+      s.add(x);
+      units[u].count += w;
+      units[u].sum += w * x;
+    }
+  }
+
+  std::map<Value, EstimatedSummary> result;
+  for (auto& [k, g] : groups) {
+    auto& e = result[k] = sampling::estimate(g.first, sample.population, sample.complete_units, z);
+    e.sample = g.second;
+  }
+  return result;
+}
+
+}
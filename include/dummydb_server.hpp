@@ -0,0 +1,862 @@
+#pragma once
+
+#include "dummydb.hpp"
+#include "dummydb_admission.hpp"
+#include "dummydb_cache.hpp"
+#include "dummydb_metrics.hpp"
+#include "dummydb_protocol.hpp"
+#include "dummydb_replication.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ddb {
+
+/// The configuration of a server.
+struct ServerOptions {
+
+  /// The number of event loops.
+  std::size_t threads = std::thread::hardware_concurrency();
+
+  /// The log to which the modifications of the database are appended, if the server is the
+  /// primary of a replicated database.
+  ReplicationLog* log = nullptr;
+
+  /// `true` iff requests modifying the database are rejected, as on a replica.
+  bool read_only = false;
+
+  /// The maximum estimated size of the cached results of scans and aggregates, in bytes, or 0 to
+  /// disable caching.
+  std::size_t result_cache_bytes = 0;
+
+  /// The maximum number of decoded records cached for point lookups, or 0 to disable caching.
+  std::size_t record_cache_entries = 0;
+
+  /// The admission control of requests, which is disabled unless `admission.workers` is positive.
+  AdmissionOptions admission{};
+
+};
+
+/// The request handler shared by the event loops of a server.
+///
+/// Requests that modify the database are serialized with respect to each other and to readers;
+/// requests that only read from it run concurrently.
+class Service final {
+private:
+
+  /// The database being served.
+  DummyDB& db;
+
+  /// The lock protecting `db`.
+  std::shared_mutex mutex;
+
+  /// The log to which modifications are appended, if any.
+  ReplicationLog* log;
+
+  /// `true` iff requests modifying the database are rejected.
+  bool read_only;
+
+  /// The cache of the results of scans and aggregates, if any.
+  std::unique_ptr<ResultCache> cache;
+
+  /// The cache of the records returned by point lookups, if any.
+  std::unique_ptr<RecordCache> records;
+
+  /// The counters of the requests executed.
+  RequestMetrics requests;
+
+  /// Throws if clients may not modify the database.
+  void check_writable(bool replicated) const {
+    if (read_only && !replicated) {
+      throw std::logic_error("the database is read-only");
+    }
+  }
+
+  /// Appends the modification requested by `f` to the log, if any.
+  void log_request(protocol::Frame const& f, bool replicated) {
+    if (log && !replicated) {
+      log->append(static_cast<protocol::Opcode>(f.code), [&](auto& w) { w.bytes(f.payload); });
+    }
+  }
+
+  /// Throws if there is no table identified by `t`.
+  void check_table(std::size_t t) const {
+    if (t >= db.table_count()) {
+      throw std::out_of_range("no such table");
+    }
+  }
+
+  /// Throws if `record` cannot be inserted in the table identified by `t`.
+  void check_record(std::size_t t, std::vector<Value> const& record) const {
+    check_table(t);
+    auto s = db.schema(t);
+    if (s.size() != record.size()) {
+      throw std::invalid_argument("record does not match the schema of the table");
+    }
+    for (std::size_t i = 0; i < s.size(); ++i) {
+      if (record[i].index() != s[i]) {
+        throw std::invalid_argument("record does not match the schema of the table");
+      }
+    }
+  }
+
+  /// Inserts `records` in the table identified by `t` in order, stopping at the first one that
+  /// fails, logs the insertions, and returns the number of records inserted along with the error
+  /// that stopped them, if any.
+  ///
+  /// A failed insertion may have interned some strings of its record before failing, and string
+  /// identities depend on the order in which strings are interned, so the strings of that record
+  /// that are stored are logged after the records inserted (replicas ignore those they already
+  /// hold). Otherwise the string tables of the replicas would diverge from that of the primary.
+  /// Exceptions are rethrown once the insertions are logged.
+  std::pair<std::uint32_t, ErrorCode> insert_records(
+    std::size_t t, std::span<std::vector<Value> const> records, bool replicated
+  ) {
+    using namespace protocol;
+    std::uint32_t n = 0;
+    auto error = ErrorCode{0};
+    auto log_insertions = [&] {
+      if (!log || replicated) return;
+      // Log the records actually inserted one by one so that replicas need not know batches.
+      for (std::uint32_t i = 0; i < n; ++i) {
+        log->append(Opcode::Insert, [&](auto& w) { w.u64(t).record(records[i]); });
+      }
+      if (n == records.size()) return;
+      for (auto const& v : records[n]) {
+        auto s = std::get_if<String>(&v);
+        if (s && (db.find_string(*s) != not_found)) {
+          log->append(Opcode::InsertString, [&](auto& w) { w.string(*s); });
+        }
+      }
+    };
+    try {
+      for (; n < records.size(); ++n) {
+        auto i = db.try_insert(t, records[n]);
+        if (!i) {
+          error = i.error();
+          break;
+        }
+      }
+    } catch (...) {
+      log_insertions();
+      throw;
+    }
+    log_insertions();
+    return {n, error};
+  }
+
+  /// Executes the request `f` and appends its response to `output`, throwing on failure.
+  ///
+  /// `replicated` is `true` iff `f` is an entry of the log of a primary being replayed.
+  void dispatch(protocol::Frame const& f, std::string& output, bool replicated) {
+    using namespace protocol;
+    Reader r{f.payload};
+    switch (static_cast<Opcode>(f.code)) {
+      case Opcode::CreateTable: {
+        check_writable(replicated);
+        auto s = r.schema();
+        std::unique_lock l{mutex};
+        auto t = db.create_table(s);
+        log_request(f, replicated);
+        l.unlock();
+        Writer(output, f.request_identity, std::uint8_t(Status::Ok)).u64(t).end();
+        return;
+      }
+
+      case Opcode::Insert: {
+        check_writable(replicated);
+        auto t = r.u64();
+        auto record = r.record();
+        std::unique_lock l{mutex};
+        check_record(t, record);
+        auto i = db.record_count(t);
+        auto [n, error] = insert_records(t, std::span{&record, 1}, replicated);
+        if (n == 0) throw std::overflow_error(describe(error));
+        l.unlock();
+        Writer(output, f.request_identity, std::uint8_t(Status::Ok)).u64(i).end();
+        return;
+      }
+
+      case Opcode::InsertBatch: {
+        check_writable(replicated);
+        auto t = r.u64();
+        auto count = r.u32();
+        if (count > r.remaining()) {
+          throw ProtocolError("invalid record count");
+        }
+        std::vector<std::vector<Value>> records(count);
+        for (auto& record : records) record = r.record();
+        std::unique_lock l{mutex};
+        for (auto const& record : records) check_record(t, record);
+        std::size_t first = db.record_count(t);
+        auto [n, error] = insert_records(t, records, replicated);
+        if (n == 0) throw std::overflow_error(describe(error));
+        l.unlock();
+        Writer(output, f.request_identity, std::uint8_t(Status::Ok)).u64(first).u32(n).end();
+        return;
+      }
+
+      case Opcode::Record: {
+        auto t = r.u64();
+        auto i = r.u64();
+        std::shared_lock l{mutex};
+        check_table(t);
+        if (i >= db.record_count(t)) {
+          throw std::out_of_range("no such record");
+        }
+        if (records) {
+          auto record = records->shared_record(db.record_id(t, i));
+          l.unlock();
+          Writer(output, f.request_identity, std::uint8_t(Status::Ok)).record(*record).end();
+          return;
+        }
+        auto record = db.record(t, i);
+        l.unlock();
+        Writer(output, f.request_identity, std::uint8_t(Status::Ok)).record(record).end();
+        return;
+      }
+
+      case Opcode::InsertString: {
+        check_writable(replicated);
+        auto s = std::string{r.string()};
+        std::unique_lock l{mutex};
+        auto i = db.insert_string(s);
+        log_request(f, replicated);
+        l.unlock();
+        Writer(output, f.request_identity, std::uint8_t(Status::Ok)).u64(i).end();
+        return;
+      }
+
+      case Opcode::FindString: {
+        auto s = std::string{r.string()};
+        std::shared_lock l{mutex};
+        auto i = db.find_string(s);
+        l.unlock();
+        Writer(output, f.request_identity, std::uint8_t(Status::Ok)).u64(i).end();
+        return;
+      }
+
+      case Opcode::Summarize: {
+        auto t = r.u64();
+        auto c = r.u8();
+        std::shared_lock l{mutex};
+        check_table(t);
+        auto summary = cache ? *cache->summarize(t, c) : db.summarize(t, c);
+        l.unlock();
+        Writer(output, f.request_identity, std::uint8_t(Status::Ok)).summary(summary).end();
+        return;
+      }
+
+      case Opcode::Scan: {
+        auto t = r.u64();
+        auto first = r.u64();
+        auto count = r.u64();
+        std::shared_lock l{mutex};
+        check_table(t);
+        if (cache) {
+          auto rows = cache->scan(t, first, count);
+          l.unlock();
+          Writer w{output, f.request_identity, std::uint8_t(Status::Ok)};
+          w.u64(rows->size());
+          for (auto const& row : *rows) w.record(row);
+          w.end();
+          return;
+        }
+        auto n = db.record_count(t);
+        auto last = (first < n) ? first + std::min(count, n - first) : first;
+        Writer w{output, f.request_identity, std::uint8_t(Status::Ok)};
+        w.u64(last - first);
+        for (auto i = first; i < last; ++i) {
+          w.record(db.record(t, i));
+        }
+        w.end();
+        return;
+      }
+    }
+    throw ProtocolError("unknown operation");
+  }
+
+public:
+
+  /// Creates an instance serving `db`, appending modifications to `log` if it is not null,
+  /// rejecting them if `read_only` is `true`, caching up to `result_cache_bytes` bytes of results
+  /// of scans and aggregates, and caching up to `record_cache_entries` records for point lookups.
+  explicit Service(
+    DummyDB& db, ReplicationLog* log = nullptr, bool read_only = false, std::size_t result_cache_bytes = 0,
+    std::size_t record_cache_entries = 0
+  )
+    : db(db), log(log), read_only(read_only)
+  {
+    if (result_cache_bytes > 0) {
+      cache = std::make_unique<ResultCache>(db, result_cache_bytes);
+    }
+    if (record_cache_entries > 0) {
+      records = std::make_unique<RecordCache>(db, record_cache_entries);
+    }
+  }
+
+  /// Returns the result cache of this instance, or null if results are not cached.
+  ResultCache const* result_cache() const {
+    return cache.get();
+  }
+
+  /// Applies the modification described by `entry`, an entry of the log of a primary.
+  void replay(protocol::Frame const& entry) {
+    std::string ignored;
+    dispatch(entry, ignored, true);
+  }
+
+  /// Executes the request `f` and appends its response to `output`.
+  ///
+  /// Failures are reported to the client in an error response rather than thrown, except for
+  /// violations of the protocol that do not leave the connection in a usable state.
+  void execute(protocol::Frame const& f, std::string& output) {
+    auto n = output.size();
+    auto start = std::chrono::steady_clock::now();
+    auto status = protocol::Status::Ok;
+    try {
+      dispatch(f, output, false);
+    } catch (protocol::ProtocolError const&) {
+      throw;
+    } catch (std::exception const& e) {
+      output.resize(n);
+      protocol::Writer(output, f.request_identity, std::uint8_t(protocol::Status::Error))
+        .string(e.what()).end();
+      status = protocol::Status::Error;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    requests.observe(f.code, status,
+      static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+  }
+
+  /// Records that the request `f` was rejected without being executed.
+  void reject(protocol::Frame const& f) {
+    requests.reject(f.code);
+  }
+
+  /// Appends the metrics of the requests executed and of the database to `output`.
+  ///
+  /// The database is inspected under a shared lock, so collecting metrics only delays requests
+  /// that modify it.
+  void expose(Exposition& output) {
+    requests.expose(output);
+    {
+      std::shared_lock l{mutex};
+      expose_database(db, output);
+    }
+    if (cache) {
+      auto u = cache->usage();
+      output.family("dummydb_result_cache_hits_total", "counter", "Queries answered from the result cache.");
+      output.sample("dummydb_result_cache_hits_total", "", static_cast<double>(u.hits));
+      output.family("dummydb_result_cache_misses_total", "counter", "Queries computed and offered to the result cache.");
+      output.sample("dummydb_result_cache_misses_total", "", static_cast<double>(u.misses));
+      output.family("dummydb_result_cache_bytes", "gauge", "Estimated size of the cached results.");
+      output.sample("dummydb_result_cache_bytes", "", static_cast<double>(u.bytes));
+    }
+    if (records) {
+      auto u = records->usage();
+      output.family("dummydb_record_cache_hits_total", "counter", "Point lookups answered from the record cache.");
+      output.sample("dummydb_record_cache_hits_total", "", static_cast<double>(u.hits));
+      output.family("dummydb_record_cache_misses_total", "counter", "Point lookups that decoded their record.");
+      output.sample("dummydb_record_cache_misses_total", "", static_cast<double>(u.misses));
+      output.family("dummydb_record_cache_evictions_total", "counter", "Records evicted from the record cache.");
+      output.sample("dummydb_record_cache_evictions_total", "", static_cast<double>(u.evictions));
+      output.family("dummydb_record_cache_entries", "gauge", "Records in the record cache.");
+      output.sample("dummydb_record_cache_entries", "", static_cast<double>(u.entries));
+    }
+  }
+
+};
+
+/// A server exposing a database over TCP and Unix-domain sockets.
+///
+/// The server runs one event loop per thread, each with its own epoll instance. TCP connections
+/// are spread across loops by the kernel using one `SO_REUSEPORT` listener per loop, whereas Unix
+/// connections are accepted from a listener shared by all loops with `EPOLLEXCLUSIVE`. A loop
+/// executes every complete request that it reads from a connection before writing the responses
+/// back in a single system call, so that clients can pipeline requests.
+///
+/// If admission control is enabled, loops only parse requests and hand them to an
+/// `AdmissionController`, whose workers execute them and pass the responses back to the loop
+/// owning the connection. Responses may then be sent in a different order than their requests.
+/// Requests exceeding the limits of their client or finding their queue full are answered at once
+/// with a `Busy` status.
+class Server final {
+private:
+
+  /// The state of a connection.
+  struct Connection {
+
+    /// The bytes received and not yet consumed.
+    std::string input;
+
+    /// The bytes to send.
+    std::string output;
+
+    /// The number of bytes of `output` that have already been sent.
+    std::size_t written = 0;
+
+    /// `true` iff the loop is waiting for the socket to become writable.
+    bool waiting_for_output = false;
+
+    /// `true` iff the peer has shut down its side of the connection.
+    bool closed = false;
+
+    /// The number identifying the connection in its loop, which is not reused when the file
+    /// descriptor of a closed connection is.
+    std::uint64_t serial = 0;
+
+    /// The number of requests admitted and not yet completed.
+    std::size_t in_flight = 0;
+
+    /// The size of the requests admitted and not yet completed, in bytes.
+    std::size_t in_flight_bytes = 0;
+
+  };
+
+  /// The outcome of a request executed by a worker of the admission controller.
+  struct Completion {
+
+    /// The file descriptor of the connection on which the request was received.
+    int fd;
+
+    /// The serial number of the connection on which the request was received.
+    std::uint64_t serial;
+
+    /// The size of the request, in bytes.
+    std::size_t size;
+
+    /// The response.
+    std::string output;
+
+    /// `true` iff the request violated the protocol and the connection must be closed.
+    bool failed = false;
+
+  };
+
+  /// An event loop running on a dedicated thread.
+  struct Loop {
+
+    /// The epoll instance of the loop.
+    int epoll = -1;
+
+    /// The event file descriptor used to stop the loop.
+    int wakeup = -1;
+
+    /// The listeners watched by the loop.
+    std::vector<int> listeners;
+
+    /// The connections handled by the loop, keyed by file descriptor.
+    std::unordered_map<int, Connection> connections;
+
+    /// The serial number of the next connection.
+    std::uint64_t next_serial = 0;
+
+    /// The event file descriptor signaling that `completions` is not empty.
+    int completed = -1;
+
+    /// The lock protecting `completions`.
+    std::mutex mutex;
+
+    /// The requests executed by workers whose responses have not been written to their connection.
+    std::vector<Completion> completions;
+
+    /// The thread running the loop.
+    std::thread thread;
+
+  };
+
+  /// The request handler.
+  Service handler;
+
+  /// The admission controller, if requests are not executed by the event loops.
+  std::unique_ptr<AdmissionController> admission;
+
+  /// The event loops.
+  std::vector<std::unique_ptr<Loop>> loops;
+
+  /// The listening sockets.
+  std::vector<int> listeners;
+
+  /// The paths of the Unix-domain sockets to remove when the server is destroyed.
+  std::vector<std::string> socket_paths;
+
+  /// Throws a `std::system_error` describing `errno` if `result` is negative.
+  static int checked(int result, char const* what) {
+    if (result < 0) {
+      throw std::system_error(errno, std::generic_category(), what);
+    }
+    return result;
+  }
+
+  /// Registers `fd` with the epoll instance of `loop`.
+  static void watch(Loop& loop, int fd, std::uint32_t events) {
+    epoll_event e{};
+    e.events = events;
+    e.data.fd = fd;
+    checked(epoll_ctl(loop.epoll, EPOLL_CTL_ADD, fd, &e), "epoll_ctl");
+  }
+
+  /// Closes the connection `fd` of `loop`.
+  static void close_connection(Loop& loop, int fd) {
+    loop.connections.erase(fd);
+    ::close(fd);
+  }
+
+  /// Accepts all pending connections on `listener` in `loop`.
+  static void accept_all(Loop& loop, int listener) {
+    while (true) {
+      auto fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) return;
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      Connection c;
+      c.serial = loop.next_serial++;
+      loop.connections.emplace(fd, std::move(c));
+      watch(loop, fd, EPOLLIN | EPOLLRDHUP);
+    }
+  }
+
+  /// Sends as much of the pending output of `c` as possible, returning `false` iff the connection
+  /// failed.
+  static bool flush(Loop& loop, int fd, Connection& c) {
+    while (c.written < c.output.size()) {
+      auto n = ::send(fd, c.output.data() + c.written, c.output.size() - c.written, MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        if (errno != EAGAIN) return false;
+        break;
+      }
+      c.written += static_cast<std::size_t>(n);
+    }
+
+    auto pending = c.written < c.output.size();
+    if (!pending) {
+      c.output.clear();
+      c.written = 0;
+    }
+    if (pending != c.waiting_for_output) {
+      epoll_event e{};
+      e.events = EPOLLIN | EPOLLRDHUP | (pending ? std::uint32_t{EPOLLOUT} : 0u);
+      e.data.fd = fd;
+      epoll_ctl(loop.epoll, EPOLL_CTL_MOD, fd, &e);
+      c.waiting_for_output = pending;
+    }
+    return true;
+  }
+
+  /// Returns `true` iff the connection `c` can be closed because its peer shut it down and it has
+  /// no request in flight.
+  static bool is_finished(Connection const& c) {
+    return c.closed && (c.in_flight == 0);
+  }
+
+  /// Appends to `output` a response rejecting the request `f` because of `reason`.
+  static void reject(std::string& output, protocol::Frame const& f, std::string_view reason) {
+    protocol::Writer(output, f.request_identity, std::uint8_t(protocol::Status::Busy)).string(reason).end();
+  }
+
+  /// Submits the request `f` received on the connection `fd` of `loop` to the admission
+  /// controller, or rejects it if the client or the server is overloaded.
+  void admit(Loop& loop, int fd, Connection& c, protocol::Frame const& f) {
+    auto k = classify(static_cast<protocol::Opcode>(f.code));
+    auto const& o = admission->configuration();
+    auto buffered = c.output.size() - c.written;
+    if (c.in_flight >= o.max_requests_per_client) {
+      admission->shed(k);
+      handler.reject(f);
+      reject(c.output, f, "too many concurrent requests");
+      return;
+    } else if ((c.in_flight_bytes + buffered + f.size) > o.max_bytes_per_client) {
+      admission->shed(k);
+      handler.reject(f);
+      reject(c.output, f, "too much memory used by this client");
+      return;
+    }
+
+    auto request = std::string{f.payload.data() - protocol::frame_header_size, f.size};
+    auto job = [this, &loop, fd, serial = c.serial, request = std::move(request)] {
+      Completion done{fd, serial, request.size(), {}};
+      try {
+        handler.execute(*protocol::next_frame(request), done.output);
+      } catch (protocol::ProtocolError const&) {
+        done.failed = true;
+      }
+      {
+        std::lock_guard l{loop.mutex};
+        loop.completions.push_back(std::move(done));
+      }
+      std::uint64_t one = 1;
+      [[maybe_unused]] auto n = ::write(loop.completed, &one, sizeof(one));
+    };
+    if (!admission->submit(k, std::move(job))) {
+      handler.reject(f);
+      reject(c.output, f, "server is overloaded");
+      return;
+    }
+    c.in_flight += 1;
+    c.in_flight_bytes += f.size;
+  }
+
+  /// Writes the responses of the requests executed by workers for the connections of `loop`.
+  void complete(Loop& loop) {
+    std::uint64_t n;
+    [[maybe_unused]] auto r = ::read(loop.completed, &n, sizeof(n));
+    std::vector<Completion> done;
+    {
+      std::lock_guard l{loop.mutex};
+      done.swap(loop.completions);
+    }
+    for (auto& d : done) {
+      auto i = loop.connections.find(d.fd);
+      if ((i == loop.connections.end()) || (i->second.serial != d.serial)) continue;
+      auto& c = i->second;
+      c.in_flight -= 1;
+      c.in_flight_bytes -= d.size;
+      c.output.append(d.output);
+      if (d.failed || !flush(loop, d.fd, c) || is_finished(c)) {
+        close_connection(loop, d.fd);
+      }
+    }
+  }
+
+  /// Reads from the connection `fd` of `loop` and executes or admits the requests received,
+  /// returning `false` iff the connection failed.
+  bool receive(Loop& loop, int fd, Connection& c) {
+    char chunk[65536];
+    while (true) {
+      auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+      if (n > 0) {
+        c.input.append(chunk, static_cast<std::size_t>(n));
+      } else if (n == 0) {
+        c.closed = true;
+        break;
+      } else if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN) {
+        break;
+      } else {
+        return false;
+      }
+    }
+
+    try {
+      std::size_t consumed = 0;
+      while (auto f = protocol::next_frame(std::string_view{c.input}.substr(consumed))) {
+        if (admission) {
+          admit(loop, fd, c, *f);
+        } else {
+          handler.execute(*f, c.output);
+        }
+        consumed += f->size;
+      }
+      c.input.erase(0, consumed);
+    } catch (protocol::ProtocolError const&) {
+      return false;
+    }
+    return true;
+  }
+
+  /// Runs `loop` until it is stopped.
+  void run(Loop& loop) {
+    epoll_event events[64];
+    while (true) {
+      auto n = epoll_wait(loop.epoll, events, 64, -1);
+      for (int i = 0; i < n; ++i) {
+        auto fd = events[i].data.fd;
+        if (fd == loop.wakeup) {
+          return;
+        } else if (fd == loop.completed) {
+          complete(loop);
+          continue;
+        } else if (std::find(loop.listeners.begin(), loop.listeners.end(), fd) != loop.listeners.end()) {
+          accept_all(loop, fd);
+          continue;
+        }
+
+        auto c = loop.connections.find(fd);
+        if (c == loop.connections.end()) continue;
+        auto ok = true;
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+          ok = receive(loop, fd, c->second);
+        }
+        if (ok) {
+          ok = flush(loop, fd, c->second) && !is_finished(c->second);
+        }
+        if (!ok) {
+          close_connection(loop, fd);
+        }
+      }
+    }
+  }
+
+  /// Creates a socket listening on `address`.
+  static int listener(int domain, sockaddr const* address, socklen_t size, bool reuse_port) {
+    auto fd = checked(::socket(domain, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), "socket");
+    int one = 1;
+    if (reuse_port) {
+      ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    }
+    if ((::bind(fd, address, size) < 0) || (::listen(fd, SOMAXCONN) < 0)) {
+      auto e = errno;
+      ::close(fd);
+      throw std::system_error(e, std::generic_category(), "bind");
+    }
+    return fd;
+  }
+
+public:
+
+  /// Creates an instance serving `db` as configured by `options`.
+  Server(DummyDB& db, ServerOptions const& options)
+    : handler(db, options.log, options.read_only, options.result_cache_bytes, options.record_cache_entries)
+  {
+    for (std::size_t i = 0; i < std::max<std::size_t>(options.threads, 1); ++i) {
+      auto l = std::make_unique<Loop>();
+      l->epoll = checked(epoll_create1(EPOLL_CLOEXEC), "epoll_create1");
+      l->wakeup = checked(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd");
+      watch(*l, l->wakeup, EPOLLIN);
+      l->completed = checked(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), "eventfd");
+      watch(*l, l->completed, EPOLLIN);
+      loops.push_back(std::move(l));
+    }
+    if (options.admission.workers > 0) {
+      admission = std::make_unique<AdmissionController>(options.admission);
+    }
+  }
+
+  /// Creates an instance serving `db` with `thread_count` event loops.
+  explicit Server(DummyDB& db, std::size_t thread_count = std::thread::hardware_concurrency())
+    : Server(db, ServerOptions{.threads = thread_count})
+  {}
+
+  Server(Server const&) = delete;
+  Server& operator=(Server const&) = delete;
+
+  /// Returns the request handler of this server.
+  Service& service() {
+    return handler;
+  }
+
+  /// Returns the metrics of this server in the Prometheus text format.
+  std::string metrics() {
+    std::string result;
+    Exposition output{result};
+    handler.expose(output);
+    if (admission) {
+      static constexpr char const* classes[] = {"class=\"point\"", "class=\"scan\""};
+      auto s = admission->statistics();
+      output.family("dummydb_admission_queued", "gauge", "Requests waiting for a worker, by class.");
+      for (std::size_t c = 0; c < 2; ++c) {
+        output.sample("dummydb_admission_queued", classes[c], static_cast<double>(s.queued[c]));
+      }
+      output.family("dummydb_admission_rejected_total", "counter", "Requests shed by admission control, by class.");
+      for (std::size_t c = 0; c < 2; ++c) {
+        output.sample("dummydb_admission_rejected_total", classes[c], static_cast<double>(s.rejected[c]));
+      }
+    }
+    expose_process(output);
+    return result;
+  }
+
+  /// Returns the admission controller of this server, or null if admission control is disabled.
+  AdmissionController* admission_controller() {
+    return admission.get();
+  }
+
+  ~Server() {
+    stop();
+    for (auto& l : loops) {
+      for (auto& [fd, c] : l->connections) ::close(fd);
+      ::close(l->wakeup);
+      ::close(l->completed);
+      ::close(l->epoll);
+    }
+    for (auto fd : listeners) ::close(fd);
+    for (auto const& p : socket_paths) ::unlink(p.c_str());
+  }
+
+  /// Accepts TCP connections on `host`:`port` and returns the port, which is chosen by the system
+  /// if `port` is 0.
+  std::uint16_t listen_tcp(std::uint16_t port, std::string const& host = "127.0.0.1") {
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &a.sin_addr) != 1) {
+      throw std::invalid_argument("invalid address: " + host);
+    }
+
+    for (auto& l : loops) {
+      auto fd = listener(AF_INET, reinterpret_cast<sockaddr*>(&a), sizeof(a), true);
+      listeners.push_back(fd);
+      l->listeners.push_back(fd);
+      watch(*l, fd, EPOLLIN);
+
+      // The other loops must bind the port chosen for the first one.
+      socklen_t n = sizeof(a);
+      ::getsockname(fd, reinterpret_cast<sockaddr*>(&a), &n);
+    }
+    return ntohs(a.sin_port);
+  }
+
+  /// Accepts Unix-domain connections on the socket at `path`, replacing any existing file.
+  void listen_unix(std::string const& path) {
+    sockaddr_un a{};
+    a.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(a.sun_path)) {
+      throw std::invalid_argument("socket path is too long: " + path);
+    }
+    std::copy(path.begin(), path.end(), a.sun_path);
+    ::unlink(path.c_str());
+
+    auto fd = listener(AF_UNIX, reinterpret_cast<sockaddr*>(&a), sizeof(a), false);
+    listeners.push_back(fd);
+    socket_paths.push_back(path);
+    for (auto& l : loops) {
+      l->listeners.push_back(fd);
+      watch(*l, fd, EPOLLIN | EPOLLEXCLUSIVE);
+    }
+  }
+
+  /// Starts the event loops and the workers of the admission controller, if any.
+  void start() {
+    if (admission) admission->start();
+    for (auto& l : loops) {
+      l->thread = std::thread([this, loop = l.get()] { run(*loop); });
+    }
+  }
+
+  /// Stops the event loops and the workers of the admission controller, if any, and waits for them
+  /// to return.
+  void stop() {
+    if (admission) admission->stop();
+    for (auto& l : loops) {
+      if (l->thread.joinable()) {
+        std::uint64_t one = 1;
+        [[maybe_unused]] auto n = ::write(l->wakeup, &one, sizeof(one));
+        l->thread.join();
+      }
+    }
+  }
+
+};
+
+}
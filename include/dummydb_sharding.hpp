@@ -0,0 +1,283 @@
+#pragma once
+
+#include "dummydb.hpp"
+#include "dummydb_async.hpp"
+#include "dummydb_client.hpp"
+
+#include <future>
+#include <memory>
+#include <shared_mutex>
+
+namespace ddb {
+
+/// A database holding one partition of the tables of a sharded database.
+///
+/// Operations return futures so that a router can issue them on all shards before waiting for
+/// any, whether shards live in the same process or in local server processes.
+class Shard {
+public:
+
+  virtual ~Shard() = default;
+
+  /// Creates a new table with the given scheme and returns its identity.
+  virtual std::future<std::size_t> create_table(std::vector<FieldType> const& schema) = 0;
+
+  /// Inserts `record` in the table identified by `table_identity` and returns its identity.
+  virtual std::future<std::size_t> insert(std::size_t table_identity, std::vector<Value> const& record) = 0;
+
+  /// Returns the contents of the record identified by `record_identity`, which is stored in the
+  /// table identified by `table_identity`.
+  virtual std::future<std::vector<Value>> record(std::size_t table_identity, std::size_t record_identity) = 0;
+
+  /// Returns up to `count` records of the table identified by `table_identity`, starting from the
+  /// record identified by `first`.
+  virtual std::future<std::vector<std::vector<Value>>> scan(
+    std::size_t table_identity, std::size_t first, std::size_t count) = 0;
+
+  /// Returns summary statistics of the numeric column at index `column` of the table identified
+  /// by `table_identity`.
+  virtual std::future<Summary> summarize(std::size_t table_identity, std::size_t column) = 0;
+
+};
+
+/// A shard stored in the current process, whose operations run on an executor.
+class LocalShard final : public Shard {
+private:
+
+  /// The database.
+  DummyDB& db;
+
+  /// The executor running the operations.
+  Executor& executor;
+
+  /// The lock protecting `db`.
+  std::shared_mutex mutex;
+
+  /// Runs `f` on `executor` with exclusive access to `db` if `exclusive` is `true` or shared access
+  /// otherwise, and returns a future of its result.
+  template<typename F>
+  auto run(bool exclusive, F f) {
+    using T = std::invoke_result_t<F&>;
+    auto p = std::make_shared<std::promise<T>>();
+    auto result = p->get_future();
+    executor.post([this, exclusive, p, f = std::move(f)]() mutable {
+      try {
+        if (exclusive) {
+          std::unique_lock l{mutex};
+          p->set_value(f());
+        } else {
+          std::shared_lock l{mutex};
+          p->set_value(f());
+        }
+      } catch (...) {
+        p->set_exception(std::current_exception());
+      }
+    });
+    return result;
+  }
+
+public:
+
+  /// Creates an instance running operations on `db` with `executor`.
+  LocalShard(DummyDB& db, Executor& executor) : db(db), executor(executor) {}
+
+  std::future<std::size_t> create_table(std::vector<FieldType> const& schema) override {
+    return run(true, [this, schema] { return db.create_table(schema); });
+  }
+
+  std::future<std::size_t> insert(std::size_t table_identity, std::vector<Value> const& record) override {
+    return run(true, [this, table_identity, record] { return db.insert(table_identity, record); });
+  }
+
+  std::future<std::vector<Value>> record(std::size_t table_identity, std::size_t record_identity) override {
+    return run(false, [this, table_identity, record_identity] {
+      return db.record(table_identity, record_identity);
+    });
+  }
+
+  std::future<std::vector<std::vector<Value>>> scan(
+    std::size_t table_identity, std::size_t first, std::size_t count
+  ) override {
+    return run(false, [this, table_identity, first, count] {
+      auto n = db.record_count(table_identity);
+      auto last = (first < n) ? first + std::min(count, n - first) : first;
+      std::vector<std::vector<Value>> result;
+      result.reserve(last - first);
+      for (auto i = first; i < last; ++i) {
+        result.push_back(db.record(table_identity, i));
+      }
+      return result;
+    });
+  }
+
+  std::future<Summary> summarize(std::size_t table_identity, std::size_t column) override {
+    return run(false, [this, table_identity, column] { return db.summarize(table_identity, column); });
+  }
+
+};
+
+/// A shard served by a server process, accessed through a connection.
+class RemoteShard final : public Shard {
+private:
+
+  /// The connection to the server.
+  Connection& connection;
+
+public:
+
+  /// Creates an instance accessing the database served on the other end of `connection`.
+  explicit RemoteShard(Connection& connection) : connection(connection) {}
+
+  std::future<std::size_t> create_table(std::vector<FieldType> const& schema) override {
+    return connection.create_table(schema);
+  }
+
+  std::future<std::size_t> insert(std::size_t table_identity, std::vector<Value> const& record) override {
+    return connection.insert(table_identity, record);
+  }
+
+  std::future<std::vector<Value>> record(std::size_t table_identity, std::size_t record_identity) override {
+    return connection.record(table_identity, record_identity);
+  }
+
+  std::future<std::vector<std::vector<Value>>> scan(
+    std::size_t table_identity, std::size_t first, std::size_t count
+  ) override {
+    return connection.scan(table_identity, first, count);
+  }
+
+  std::future<Summary> summarize(std::size_t table_identity, std::size_t column) override {
+    return connection.summarize(table_identity, column);
+  }
+
+};
+
+/// The identity of a record in a sharded table.
+struct ShardedRecordIdentity {
+
+  /// The index of the shard storing the record.
+  std::size_t shard;
+
+  /// The identity of the record in its shard.
+  std::size_t record;
+
+  friend bool operator==(ShardedRecordIdentity const&, ShardedRecordIdentity const&) = default;
+
+};
+
+/// Returns `v` as it reads once stored in a table, i.e., with `Float` values rounded to single
+/// precision.
+inline Value stored_value(Value v) {
+  if (auto x = std::get_if<Float>(&v)) *x = static_cast<double>(static_cast<float>(*x));
+  return v;
+}
+
+/// Returns the hash of `v` as it reads once stored in a table, so that a key and the same key read
+/// back from a record hash alike.
+inline std::size_t hash_value(Value const& v) {
+  if (auto x = std::get_if<Float>(&v)) {
+    return static_cast<std::size_t>(Hash{}(Value{static_cast<double>(static_cast<float>(*x))}));
+  }
+  return static_cast<std::size_t>(Hash{}(v));
+}
+
+/// A logical table partitioned across several shards by the hash of a key column.
+///
+/// Point operations are routed to the shard owning the key of the record. Scans and aggregates
+/// are issued to all shards at once and their results are merged once all shards have answered.
+class ShardedTable final {
+private:
+
+  /// The shards.
+  std::vector<Shard*> shards;
+
+  /// The identity of the partition of this table in each shard.
+  std::vector<std::size_t> partitions;
+
+  /// The index of the key column.
+  std::size_t key;
+
+public:
+
+  /// Creates a table with the given schema partitioned across `shards` by the column at index
+  /// `key_column`.
+  ShardedTable(std::vector<Shard*> shards, std::vector<FieldType> const& schema, std::size_t key_column)
+    : shards(std::move(shards)), key(key_column)
+  {
+    if (this->shards.empty()) {
+      throw std::invalid_argument("a sharded table requires at least one shard");
+    } else if (key_column >= schema.size()) {
+      throw std::out_of_range("no such column");
+    }
+
+    std::vector<std::future<std::size_t>> fs;
+    for (auto s : this->shards) fs.push_back(s->create_table(schema));
+    for (auto& f : fs) partitions.push_back(f.get());
+  }
+
+  /// Returns the number of shards.
+  std::size_t shard_count() const {
+    return shards.size();
+  }
+
+  /// Returns the index of the shard owning the records whose key is `k`.
+  std::size_t shard_of(Value const& k) const {
+    return hash_value(k) % shards.size();
+  }
+
+  /// Inserts `record` in the shard owning its key and returns its identity.
+  ShardedRecordIdentity insert(std::vector<Value> const& record) {
+    if (key >= record.size()) {
+      throw std::invalid_argument("record does not have a key");
+    }
+    auto s = shard_of(record[key]);
+    return {s, shards[s]->insert(partitions[s], record).get()};
+  }
+
+  /// Returns the contents of the record identified by `i`.
+  std::vector<Value> record(ShardedRecordIdentity i) const {
+    return shards.at(i.shard)->record(partitions[i.shard], i.record).get();
+  }
+
+  /// Returns the records whose key is `k`, scanning only the shard owning `k`.
+  ///
+  /// `Float` keys match the records whose key was the same number before it was rounded to single
+  /// precision by storage.
+  std::vector<std::vector<Value>> find(Value const& k) const {
+    auto s = shard_of(k);
+    auto rows = shards[s]->scan(partitions[s], 0, not_found).get();
+    auto stored = stored_value(k);
+    std::erase_if(rows, [&](auto const& r) { return r[key] != stored; });
+    return rows;
+  }
+
+  /// Returns all the records of the table, grouped by shard.
+  std::vector<std::vector<Value>> scan() const {
+    std::vector<std::future<std::vector<std::vector<Value>>>> fs;
+    for (std::size_t s = 0; s < shards.size(); ++s) {
+      fs.push_back(shards[s]->scan(partitions[s], 0, not_found));
+    }
+
+    std::vector<std::vector<Value>> result;
+    for (auto& f : fs) {
+      auto rows = f.get();
+      result.insert(result.end(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+    }
+    return result;
+  }
+
+  /// Returns summary statistics of the numeric column at index `column` over all shards.
+  Summary summarize(std::size_t column) const {
+    std::vector<std::future<Summary>> fs;
+    for (std::size_t s = 0; s < shards.size(); ++s) {
+      fs.push_back(shards[s]->summarize(partitions[s], column));
+    }
+
+    Summary result;
+    for (auto& f : fs) result.merge(f.get());
+    return result;
+  }
+
+};
+
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "dummydb.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ddb {
+
+/// Writes `count` bytes starting at `bytes` to the file descriptor `fd`, returning `true` iff all
+/// of them were written.
+inline bool write_fully(int fd, char const* bytes, std::size_t count) {
+  while (count > 0) {
+    auto n = ::write(fd, bytes, count);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    bytes += n;
+    count -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+/// A consistent image of a database being saved to disk by a child process.
+///
+/// The child is created with `fork()`, so it observes the contents of the database as they were at
+/// the time of the call and the kernel's copy-on-write paging isolates it from the writes that the
+/// parent keeps performing. The parent only pays for duplicating its page tables and for the page
+/// faults of the first write to each page while the child is alive.
+class BackgroundSave final {
+private:
+
+  /// The identity of the child process, or `-1` if it has been reaped.
+  pid_t pid;
+
+  /// `true` iff the child process exited successfully; meaningful only once `pid` is `-1`.
+  bool succeeded;
+
+  /// Records the termination status of the child process.
+  void reap(int status) {
+    pid = -1;
+    succeeded = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+  }
+
+public:
+
+  /// Starts saving an image of `db` to `path`.
+  ///
+  /// The image is written to a temporary file that is renamed to `path` once complete, so that
+  /// `path` never refers to a partial image.
+  BackgroundSave(DummyDB const& db, std::string const& path) : pid(-1), succeeded(false) {
+    auto staging = path + ".tmp";
+    pid = ::fork();
+    if (pid < 0) {
+      throw std::runtime_error("cannot fork to save database image");
+    } else if (pid == 0) {
+      // Only async-signal-safe functions may be used past this point, since the parent may have
+      // been running other threads holding locks (e.g., in the allocator) when it forked.
+      auto fd = ::open(staging.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      auto ok = (fd >= 0)
+        && db.write_image([&](char const* b, std::size_t n) { return write_fully(fd, b, n); })
+        && (::fsync(fd) == 0)
+        && (::close(fd) == 0)
+        && (::rename(staging.c_str(), path.c_str()) == 0);
+      ::_exit(ok ? 0 : 1);
+    }
+  }
+
+  BackgroundSave(BackgroundSave const&) = delete;
+  BackgroundSave& operator=(BackgroundSave const&) = delete;
+
+  /// Waits for the child process so that it does not outlive this instance as a zombie.
+  ~BackgroundSave() {
+    wait();
+  }
+
+  /// Returns `true` iff the save has completed, without blocking.
+  bool done() {
+    if (pid < 0) return true;
+    int status = 0;
+    if (::waitpid(pid, &status, WNOHANG) == pid) {
+      reap(status);
+      return true;
+    }
+    return false;
+  }
+
+  /// Blocks until the save has completed and returns `true` iff it succeeded.
+  bool wait() {
+    if (pid >= 0) {
+      int status = 0;
+      while (::waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+          pid = -1;
+          return succeeded = false;
+        }
+      }
+      reap(status);
+    }
+    return succeeded;
+  }
+
+};
+
+}
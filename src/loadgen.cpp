@@ -0,0 +1,194 @@
+#include "dummydb.hpp"
+#include "dummydb_bench.hpp"
+#include "dummydb_client.hpp"
+#include "dummydb_protocol.hpp"
+
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace ddb::protocol;
+
+/// The options of the load generator.
+struct Options {
+  ddb::Endpoint server;
+  std::size_t connections = 4;
+  std::size_t depth = 16;
+  std::size_t requests = 100000;
+  std::string operation = "record";
+};
+
+/// A blocking connection to the server.
+class Connection final {
+private:
+
+  /// The socket.
+  int fd;
+
+  /// The bytes received and not yet consumed.
+  std::string input;
+
+public:
+
+  /// Creates an instance connected to the server described by `o`.
+  explicit Connection(Options const& o) : fd(ddb::connect(o.server)) {}
+
+  ~Connection() { ::close(fd); }
+
+  /// Sends `bytes`.
+  void send(std::string const& bytes) {
+    std::size_t n = 0;
+    while (n < bytes.size()) {
+      auto m = ::send(fd, bytes.data() + n, bytes.size() - n, MSG_NOSIGNAL);
+      if (m <= 0) throw std::runtime_error("connection lost");
+      n += static_cast<std::size_t>(m);
+    }
+  }
+
+  /// Calls `f` on each response received by the next read from the socket.
+  template<typename F>
+  void receive(F f) {
+    char chunk[65536];
+    auto m = ::recv(fd, chunk, sizeof(chunk), 0);
+    if (m <= 0) throw std::runtime_error("connection lost");
+    input.append(chunk, static_cast<std::size_t>(m));
+
+    std::size_t consumed = 0;
+    while (auto r = next_frame(std::string_view{input}.substr(consumed))) {
+      f(*r);
+      consumed += r->size;
+    }
+    input.erase(0, consumed);
+  }
+
+  /// Sends `request` and returns the payload of its response.
+  std::string call(std::string const& request) {
+    send(request);
+    std::string payload;
+    auto done = false;
+    while (!done) {
+      receive([&](Frame const& f) {
+        if (f.code != std::uint8_t(Status::Ok)) {
+          throw std::runtime_error("request failed: " + std::string{Reader{f.payload}.string()});
+        }
+        payload = f.payload;
+        done = true;
+      });
+    }
+    return payload;
+  }
+
+};
+
+/// Appends to `buffer` the request number `i`, identified by `i`.
+void write_request(Options const& o, std::uint64_t table, std::uint64_t rows, std::uint32_t i,
+  std::string& buffer)
+{
+  if (o.operation == "insert") {
+    Writer(buffer, i, std::uint8_t(Opcode::Insert)).u64(table)
+      .record({static_cast<std::int32_t>(i), static_cast<std::int32_t>(i)}).end();
+  } else {
+    Writer(buffer, i, std::uint8_t(Opcode::Record)).u64(table).u64(i % rows).end();
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  for (int i = 1; (i + 1) < argc; i += 2) {
+    std::string k = argv[i];
+    std::string v = argv[i + 1];
+    if (k == "--host") o.server.host = v;
+    else if (k == "--port") o.server.port = static_cast<std::uint16_t>(std::stoul(v));
+    else if (k == "--unix") o.server.unix_path = v;
+    else if (k == "--connections") o.connections = std::stoul(v);
+    else if (k == "--depth") o.depth = std::stoul(v);
+    else if (k == "--requests") o.requests = std::stoul(v);
+    else if (k == "--operation") o.operation = v;
+    else {
+      std::cerr << "unknown option: " << k << std::endl;
+      return 2;
+    }
+  }
+  if (o.depth == 0) {
+    std::cerr << "--depth must be at least 1" << std::endl;
+    return 2;
+  }
+
+  // Create a table with a few records for the lookups.
+  std::uint64_t table;
+  std::uint64_t rows = 0;
+  {
+    Connection c{o};
+    std::string b;
+    Writer(b, 0, std::uint8_t(Opcode::CreateTable)).schema({ddb::Integer, ddb::Integer}).end();
+    table = Reader{c.call(b)}.u64();
+    for (; rows < 128; ++rows) {
+      b.clear();
+      Writer(b, 0, std::uint8_t(Opcode::Insert)).u64(table)
+        .record({static_cast<std::int32_t>(rows), 0}).end();
+      c.call(b);
+    }
+  }
+
+  std::mutex m;
+  ddb::bench::Latencies latencies;
+  std::size_t errors = 0;
+  std::vector<std::thread> threads;
+  auto start = ddb::bench::Clock::now();
+  for (std::size_t k = 0; k < o.connections; ++k) {
+    threads.emplace_back([&] {
+      Connection c{o};
+      ddb::bench::Latencies l;
+      // The send times of the requests in flight, by identity, since workers may respond out of order.
+      ddb::HashMap<std::uint32_t, ddb::bench::Clock::time_point> sent(o.depth);
+      std::uint32_t issued = 0;
+      std::size_t received = 0;
+      std::size_t failed = 0;
+
+      // Keep `depth` requests in flight, issuing a new one whenever a response arrives.
+      std::string b;
+      for (; (issued < o.depth) && (issued < o.requests); ++issued) {
+        sent.try_emplace(issued, ddb::bench::Clock::now());
+        write_request(o, table, rows, issued, b);
+      }
+      c.send(b);
+      while (received < o.requests) {
+        b.clear();
+        c.receive([&](Frame const& f) {
+          if (auto t = sent.find(f.request_identity)) {
+            l.add(ddb::bench::elapsed_ns(*t));
+            sent.erase(f.request_identity);
+          }
+          ++received;
+          failed += (f.code != std::uint8_t(Status::Ok));
+          if (issued < o.requests) {
+            sent.try_emplace(issued, ddb::bench::Clock::now());
+            write_request(o, table, rows, issued++, b);
+          }
+        });
+        if (!b.empty()) c.send(b);
+      }
+
+      std::lock_guard g{m};
+      latencies.merge(l);
+      errors += failed;
+    });
+  }
+  for (auto& t : threads) t.join();
+  auto ns = ddb::bench::elapsed_ns(start);
+
+  ddb::bench::report_throughput(o.operation.c_str(), o.connections * o.requests, ns);
+  latencies.report(o.operation.c_str());
+  if (errors > 0) {
+    // Inserts fail once the table is full, which still exercises the whole request path.
+    std::cout << errors << " requests failed" << std::endl;
+  }
+  return 0;
+}
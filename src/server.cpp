@@ -0,0 +1,160 @@
+#include "dummydb.hpp"
+#include "dummydb_metrics.hpp"
+#include "dummydb_replication.hpp"
+#include "dummydb_server.hpp"
+
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+/// Prints the usage of this program.
+void usage(char const* program) {
+  std::cerr
+    << "usage: " << program << " [options]\n"
+    << "  --tables N     maximum number of tables (default: 64)\n"
+    << "  --threads N    number of event loops (default: number of cores)\n"
+    << "  --host ADDR    address on which TCP connections are accepted (default: 127.0.0.1)\n"
+    << "  --port N       port on which TCP connections are accepted (default: 7411)\n"
+    << "  --unix PATH    path of a Unix-domain socket on which connections are accepted\n"
+    << "  --workers N    number of threads executing requests under admission control\n"
+    << "                 (default: 0, requests are executed by the event loops)\n"
+    << "  --client-requests N\n"
+    << "                 maximum number of requests in flight per client (default: 256)\n"
+    << "  --client-memory MIB\n"
+    << "                 maximum size of the requests and responses in flight per client (default: 16)\n"
+    << "  --metrics-port N\n"
+    << "                 port on which metrics are served to Prometheus at /metrics\n"
+    << "  --result-cache MIB\n"
+    << "                 size of the cache of scan and aggregate results (default: 0, disabled)\n"
+    << "  --record-cache N\n"
+    << "                 number of decoded records cached for point lookups (default: 0, disabled)\n"
+    << "  --replication-port N\n"
+    << "                 port on which replicas are accepted, making this server a primary\n"
+    << "  --replica-of HOST:PORT\n"
+    << "                 address of the primary of which this server is a read-only replica\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+  std::size_t tables = 64;
+  std::size_t threads = std::thread::hardware_concurrency();
+  std::string host = "127.0.0.1";
+  std::uint16_t port = 7411;
+  std::string unix_path;
+  std::size_t result_cache = 0;
+  std::size_t record_cache = 0;
+  ddb::AdmissionOptions admission;
+  std::uint16_t replication_port = 0;
+  std::uint16_t metrics_port = 0;
+  std::string replica_of;
+
+  for (int i = 1; i < argc; ++i) {
+    auto has_value = (i + 1) < argc;
+    if (has_value && (std::strcmp(argv[i], "--tables") == 0)) {
+      tables = std::stoul(argv[++i]);
+    } else if (has_value && (std::strcmp(argv[i], "--threads") == 0)) {
+      threads = std::stoul(argv[++i]);
+    } else if (has_value && (std::strcmp(argv[i], "--host") == 0)) {
+      host = argv[++i];
+    } else if (has_value && (std::strcmp(argv[i], "--port") == 0)) {
+      port = static_cast<std::uint16_t>(std::stoul(argv[++i]));
+    } else if (has_value && (std::strcmp(argv[i], "--unix") == 0)) {
+      unix_path = argv[++i];
+    } else if (has_value && (std::strcmp(argv[i], "--workers") == 0)) {
+      admission.workers = std::stoul(argv[++i]);
+    } else if (has_value && (std::strcmp(argv[i], "--client-requests") == 0)) {
+      admission.max_requests_per_client = std::stoul(argv[++i]);
+    } else if (has_value && (std::strcmp(argv[i], "--client-memory") == 0)) {
+      admission.max_bytes_per_client = std::stoul(argv[++i]) << 20;
+    } else if (has_value && (std::strcmp(argv[i], "--result-cache") == 0)) {
+      result_cache = std::stoul(argv[++i]) << 20;
+    } else if (has_value && (std::strcmp(argv[i], "--record-cache") == 0)) {
+      record_cache = std::stoul(argv[++i]);
+    } else if (has_value && (std::strcmp(argv[i], "--replication-port") == 0)) {
+      replication_port = static_cast<std::uint16_t>(std::stoul(argv[++i]));
+    } else if (has_value && (std::strcmp(argv[i], "--metrics-port") == 0)) {
+      metrics_port = static_cast<std::uint16_t>(std::stoul(argv[++i]));
+    } else if (has_value && (std::strcmp(argv[i], "--replica-of") == 0)) {
+      replica_of = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  // Block the termination signals before the event loops are spawned so that they are delivered
+  // to the main thread only.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  if ((replication_port != 0) && !replica_of.empty()) {
+    std::cerr << "a server cannot be both a primary and a replica" << std::endl;
+    return 2;
+  }
+
+  ddb::DummyDB db{tables};
+  ddb::ReplicationLog log;
+  ddb::ServerOptions options;
+  options.threads = threads;
+  options.log = (replication_port != 0) ? &log : nullptr;
+  options.read_only = !replica_of.empty();
+  options.result_cache_bytes = result_cache;
+  options.record_cache_entries = record_cache;
+  options.admission = admission;
+  ddb::Server server{db, options};
+
+  std::unique_ptr<ddb::LogShipper> shipper;
+  if (replication_port != 0) {
+    shipper = std::make_unique<ddb::LogShipper>(log);
+    shipper->listen_tcp(replication_port, host);
+    shipper->start();
+    std::cout << "shipping the log on " << host << ":" << replication_port << std::endl;
+  }
+
+  std::unique_ptr<ddb::Replica> replica;
+  if (!replica_of.empty()) {
+    auto colon = replica_of.rfind(':');
+    if (colon == std::string::npos) {
+      usage(argv[0]);
+      return 2;
+    }
+    ddb::Endpoint primary;
+    primary.host = replica_of.substr(0, colon);
+    primary.port = static_cast<std::uint16_t>(std::stoul(replica_of.substr(colon + 1)));
+    replica = std::make_unique<ddb::Replica>(primary, [&](ddb::protocol::Frame const& f) {
+      server.service().replay(f);
+    });
+    replica->start();
+    std::cout << "replicating " << replica_of << std::endl;
+  }
+
+  auto p = server.listen_tcp(port, host);
+  std::cout << "listening on " << host << ":" << p << std::endl;
+  if (!unix_path.empty()) {
+    server.listen_unix(unix_path);
+    std::cout << "listening on " << unix_path << std::endl;
+  }
+  server.start();
+
+  std::unique_ptr<ddb::MetricsListener> metrics;
+  if (metrics_port != 0) {
+    metrics = std::make_unique<ddb::MetricsListener>([&] { return server.metrics(); });
+    metrics->listen_tcp(metrics_port, host);
+    metrics->start();
+    std::cout << "serving metrics on " << host << ":" << metrics_port << "/metrics" << std::endl;
+  }
+
+  int s = 0;
+  sigwait(&signals, &s);
+  if (metrics) metrics->stop();
+  if (replica) replica->stop();
+  server.stop();
+  if (shipper) shipper->stop();
+  return 0;
+}
@@ -1,6 +1,58 @@
 #include <dummydb.hpp>
+#include <dummydb_admission.hpp>
+#include <dummydb_async.hpp>
+#include <dummydb_bulk.hpp>
+#include <dummydb_cache.hpp>
+#include <dummydb_client.hpp>
+#include <dummydb_filter.hpp>
+#include <dummydb_hash.hpp>
+#include <dummydb_metrics.hpp>
+#include <dummydb_replication.hpp>
+#include <dummydb_sampling.hpp>
+#include <dummydb_server.hpp>
+#include <dummydb_sharding.hpp>
+#include <dummydb_snapshot.hpp>
 #include <boost/ut.hpp>
 
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <latch>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <sstream>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/// Returns a socket connected to the Unix-domain socket at `path`.
+int connect_unix(std::string const& path) {
+  sockaddr_un a{};
+  a.sun_family = AF_UNIX;
+  std::copy(path.begin(), path.end(), a.sun_path);
+  auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::connect(fd, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+  return fd;
+}
+
+/// Reads `count` frames from `fd`.
+std::vector<std::pair<ddb::protocol::Frame, std::string>> read_frames(int fd, std::size_t count) {
+  std::vector<std::pair<ddb::protocol::Frame, std::string>> result;
+  std::string input;
+  char chunk[4096];
+  while (result.size() < count) {
+    auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) break;
+    input.append(chunk, static_cast<std::size_t>(n));
+    while (auto f = ddb::protocol::next_frame(input)) {
+      result.emplace_back(*f, std::string{f->payload});
+      input.erase(0, f->size);
+    }
+  }
+  return result;
+}
+
 int main() {
   using namespace boost::ut;
 
@@ -53,5 +105,1105 @@ int main() {
     expect(db.string(j) == "World");
   };
 
+  "try_insert"_test = [] {
+    ddb::DummyDB db{1};
+    auto t = db.try_create_table({ddb::Integer, ddb::Integer});
+    expect((t.has_value()) >> fatal);
+    expect(db.try_create_table({ddb::Integer}).error() == ddb::ErrorCode::TooManyTables);
+
+    std::size_t n = 0;
+    while (auto i = db.try_insert(*t, {1, 2})) {
+      expect(*i == n++);
+    }
+    expect(n == db.record_capacity(*t));
+    expect(db.try_insert(*t, {1, 2}).error() == ddb::ErrorCode::TableFull);
+    expect(throws<std::overflow_error>([&] { db.insert(*t, {1, 2}); }));
+
+    // Strings never overflow the string table into the tables.
+    std::string s(200, 'a');
+    std::size_t m = 0;
+    for (; m < 100; ++m) {
+      s[0] = static_cast<char>('a' + (m % 26));
+      s[1] = static_cast<char>('a' + (m / 26));
+      if (!db.try_insert_string(s)) break;
+    }
+    expect(m == ddb::string_table_size / (s.size() + 1));
+    expect(db.try_insert_string(s).error() == ddb::ErrorCode::StringTableFull);
+    expect(db.record(*t, 0)[0] == ddb::Value{1});
+  };
+
+  "insert_fields"_test = [] {
+    ddb::DummyDB db{1};
+    auto t = db.create_table({ddb::Integer, ddb::Float, ddb::String});
+    std::string_view name = "Hello";
+    auto i = db.insert(t, 42, 1.5, name);
+    auto j = db.emplace(t, std::tuple{7, 2.5f, std::string{"World"}});
+    auto k = db.insert(t, std::vector<ddb::Value>{42, 1.5, "Hello"});
+    expect(std::ranges::equal(db.record(t, i), std::vector<ddb::Value>{42, 1.5, "Hello"}));
+    expect(std::ranges::equal(db.record(t, j), std::vector<ddb::Value>{7, 2.5, "World"}));
+    expect(std::ranges::equal(db.record(t, k), db.record(t, i)));
+
+    // Fields must match the schema of the table.
+    expect(throws<std::invalid_argument>([&] { db.insert(t, 42, 1.5); }));
+    expect(throws<std::invalid_argument>([&] { db.insert(t, 1.5, 42, "a"); }));
+    expect(db.record_count(t) == 3_u);
+
+    // Integers that could be truncated, booleans, and characters are rejected at compile time.
+    static_assert(ddb::FieldArgument<std::int16_t> && ddb::FieldArgument<std::uint16_t const&>);
+    static_assert(!ddb::FieldArgument<std::int64_t> && !ddb::FieldArgument<std::uint32_t>);
+    static_assert(!ddb::FieldArgument<bool> && !ddb::FieldArgument<char>);
+    expect(db.insert(t, std::int16_t{-7}, 0.5, "short") == 3_u);
+  };
+
+  "validation"_test = [] {
+    ddb::DummyDB db{2};
+    auto checked = db.checked();
+    auto t = checked.create_table({ddb::Integer, ddb::String});
+    auto r = checked.insert(t, {1, "one"});
+
+    expect(throws<std::out_of_range>([&] { checked.record(t + 1, 0); }));
+    expect(throws<std::out_of_range>([&] { checked.record(t, r + 1); }));
+    expect(throws<std::out_of_range>([&] { checked.summarize(t, 2); }));
+    expect(throws<std::out_of_range>([&] { checked.string(db.find_string("one") + 1); }));
+    std::vector<std::size_t> ids{r, r + 1};
+    expect(throws<std::out_of_range>([&] { checked.multi_get(t, ids); }));
+
+    // Insertions validate their records in both the default and the checked modes.
+    expect(throws<std::invalid_argument>([&] { checked.insert(t, {1.5, "x"}); }));
+    expect(throws<std::invalid_argument>([&] { db.insert(t, {1}); }));
+    expect(throws<std::invalid_argument>([&] { db.insert_string(std::string(256, 'x')); }));
+    expect(throws<std::invalid_argument>([&] { db.insert_string(""); }));
+    expect(db.record_count(t) == 1_u);
+
+    // Unchecked handles give the same results for valid arguments.
+    auto unchecked = db.unchecked();
+    auto s = unchecked.insert(t, 2, std::string_view{"two"});
+    expect(std::ranges::equal(unchecked.record(t, s), checked.record(t, s)));
+    expect(unchecked.string(db.find_string("two")) == "two");
+    expect(unchecked.summarize(t, 0).sum == 3._d);
+  };
+
+  "multi_get"_test = [] {
+    ddb::DummyDB db{2};
+    auto t0 = db.create_table({ddb::Integer, ddb::String});
+    auto t1 = db.create_table({ddb::Float});
+    for (std::int32_t i = 0; i < 40; ++i) {
+      db.insert(t0, {i, std::to_string(i)});
+      db.insert(t1, {i * 0.5});
+    }
+
+    std::vector<std::size_t> ids{3, 0, 39, 3, 17};
+    auto rows = db.multi_get(t0, ids);
+    expect((rows.size() == ids.size()) >> fatal);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      expect(std::ranges::equal(rows[i], db.record(t0, ids[i])));
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> locations;
+    for (std::size_t i = 0; i < 40; ++i) {
+      locations.emplace_back(i % 2, (i * 7) % 40);
+    }
+    auto mixed = db.multi_get(locations);
+    expect((mixed.size() == locations.size()) >> fatal);
+    for (std::size_t i = 0; i < locations.size(); ++i) {
+      expect(std::ranges::equal(mixed[i], db.record(locations[i].first, locations[i].second)));
+    }
+  };
+
+  "summarize"_test = [] {
+    ddb::DummyDB db{1};
+    auto t = db.create_table({ddb::Integer, ddb::Float, ddb::String});
+    expect(db.summarize(t, 0).count == 0_u);
+    db.insert(t, {3, 0.5, "a"});
+    db.insert(t, {-1, 1.5, "b"});
+    db.insert(t, {4, 1.0, "c"});
+
+    auto s = db.summarize(t, 0);
+    expect(s.count == 3_u);
+    expect(s.sum == 6._d);
+    expect(s.min == -1._d);
+    expect(s.max == 4._d);
+    expect(db.summarize(t, 1).mean() == 1._d);
+    expect(throws([&] { db.summarize(t, 2); }));
+    expect(throws([&] { db.summarize(t, 3); }));
+  };
+
+  "save_and_load"_test = [] {
+    ddb::DummyDB db{4};
+    auto t = db.create_table({ddb::Integer, ddb::Float, ddb::String});
+    auto r = db.insert(t, {42, 1.5, "Hello"});
+
+    std::stringstream image;
+    db.save(image);
+    ddb::DummyDB copy{image};
+    expect(copy.max_table_count() == 4);
+    expect(copy.table_count() == 1);
+    expect(std::ranges::equal(copy.record(t, r), std::vector<ddb::Value>{42, 1.5, "Hello"}));
+  };
+
+  "layout"_test = [] {
+    using Small = ddb::BasicDummyDB<ddb::Layout<1024, 2048, 64>>;
+    Small db{2};
+    expect(Small::table_size == 1024_u);
+    auto t = db.create_table({ddb::Integer, ddb::String});
+    expect(db.record_capacity(t) == 119_u);
+    for (std::int32_t i = 0; i < 119; ++i) db.insert(t, i, "x");
+    expect(!db.try_insert(t, 0, "x"));
+    expect(std::ranges::equal(db.checked().record(t, 118), std::vector<ddb::Value>{118, "x"}));
+
+    std::stringstream image;
+    db.save(image);
+    Small copy{image};
+    expect(copy.record_count(t) == 119_u);
+    expect(std::ranges::equal(copy.record(t, 7), std::vector<ddb::Value>{7, "x"}));
+
+    // Images are only compatible with databases of the same layout.
+    std::stringstream other;
+    db.save(other);
+    expect(throws([&] { ddb::DummyDB db{other}; }));
+  };
+
+  "clone_and_copy_table"_test = [] {
+    ddb::DummyDB db{3};
+    auto t = db.create_table({ddb::Integer, ddb::String});
+    db.insert(t, 1, "one");
+    db.insert(t, 2, "two");
+
+    auto copy = db.clone();
+    copy.insert(t, 3, "three");
+    expect(db.record_count(t) == 2_u);
+    expect(copy.record_count(t) == 3_u);
+    expect(db.find_string("three") == ddb::not_found);
+    expect(std::ranges::equal(copy.record(t, 1), db.record(t, 1)));
+
+    // Copying a table into another database re-interns its strings.
+    ddb::DummyDB other{1};
+    other.insert_string("zero");
+    auto u = other.copy_table(copy, t);
+    expect(std::ranges::equal(other.record(u, 2), std::vector<ddb::Value>{3, "three"}));
+    expect(other.try_copy_table(copy, t).error() == ddb::ErrorCode::TooManyTables);
+    expect(throws<std::out_of_range>([&] { db.copy_table(copy, 2); }));
+
+    // Copying a table into a clone of its database keeps the identities of its strings.
+    auto v = copy.copy_table(db, t);
+    expect(std::ranges::equal(copy.record(v, 0), std::vector<ddb::Value>{1, "one"}));
+
+    auto moved = std::move(copy);
+    expect(moved.record_count(v) == 2_u);
+    copy = std::move(other);
+    expect(copy.record_count(u) == 3_u);
+  };
+
+  "record_id"_test = [] {
+    ddb::DummyDB db{2};
+    db.create_table({ddb::Float});
+    auto t = db.create_table({ddb::Integer, ddb::String});
+    for (std::int32_t i = 0; i < 20; ++i) db.insert(t, i, "row");
+
+    auto id = db.record_id(t, 13);
+    expect(id.table() == t);
+    expect(id.page() == 0_u);
+    expect(db.row_number(id) == 13_u);
+    expect(ddb::RecordId::from_bits(id.bits()) == id);
+    expect(db.record_id(t, 2) < id);
+    expect(std::ranges::equal(db.record(id), db.record(t, 13)));
+    expect(throws<std::out_of_range>([&] { db.record_id(t, 20); }));
+    expect(throws<std::out_of_range>([&] { db.checked().record(ddb::RecordId{t, 0, 20}); }));
+    expect(throws<std::out_of_range>([&] { db.checked().record(ddb::RecordId{t, 1, 0}); }));
+    expect(std::ranges::equal(db.checked().record(id), db.record(t, 13)));
+
+    constexpr ddb::RecordId r{7, 3, 5};
+    static_assert((r.table() == 7) && (r.page() == 3) && (r.slot() == 5));
+    std::vector<ddb::RecordId> ids{id, db.record_id(t, 0)};
+    auto rows = db.multi_get(ids);
+    expect(std::ranges::equal(rows[1], std::vector<ddb::Value>{0, "row"}));
+  };
+
+  "footprint"_test = [] {
+    using Large = ddb::BasicDummyDB<ddb::Layout<65536>>;
+    Large db{4};
+    auto t = db.create_table({ddb::Integer, ddb::String});
+    for (std::int32_t i = 0; i < 10; ++i) db.insert(t, i, "name");
+
+    expect(db.table_footprint(t).allocated == 65536_u);
+    expect(db.table_footprint(t).used == 108_u);
+    expect(db.string_table_footprint().used == 5_u);
+    auto f = db.footprint();
+    expect(f.allocated == db.storage_size());
+    expect(f.used == 64 + 5 + db.table_footprint(t).used);
+
+    // Cloning writes whole tables, whose free space can then be given back.
+    auto copy = db.clone();
+    auto resident = copy.resident_size();
+    expect(resident >= 65536_u);
+    expect(copy.shrink_to_fit() >= 60000_u);
+    expect(copy.resident_size() < resident);
+    expect(std::ranges::equal(copy.record(t, 9), std::vector<ddb::Value>{9, "name"}));
+    expect(copy.insert(t, 10, "other") == 10_u);
+    expect(copy.record_count(copy.create_table({ddb::Float})) == 0_u);
+  };
+
+  "load_invalid_image"_test = [] {
+    std::stringstream image{"not a database"};
+    expect(throws([&] { ddb::DummyDB db{image}; }));
+  };
+
+  "background_save"_test = [] {
+    auto path = (std::filesystem::temp_directory_path() / "dummydb-test-snapshot.ddb").string();
+    ddb::DummyDB db{4};
+    auto t = db.create_table({ddb::Integer});
+    auto r = db.insert(t, {1});
+    {
+      ddb::BackgroundSave save{db, path};
+      // Writes performed while the image is being saved must not be visible in the image.
+      db.insert(t, {2});
+      db.create_table({ddb::Integer});
+      expect(save.wait());
+    }
+
+    std::ifstream input{path, std::ios::binary};
+    ddb::DummyDB copy{input};
+    expect(copy.table_count() == 1);
+    expect(std::ranges::equal(copy.record(t, r), std::vector<ddb::Value>{1}));
+    std::filesystem::remove(path);
+  };
+
+  "protocol_round_trip"_test = [] {
+    using namespace ddb::protocol;
+    std::string b;
+    Writer(b, 7, 1).record({1, 2.5, "x"}).end();
+    auto f = next_frame(b);
+    expect((f.has_value()) >> fatal);
+    expect(f->request_identity == 7_u);
+    expect(f->size == b.size());
+    Reader r{f->payload};
+    expect(std::ranges::equal(r.record(), std::vector<ddb::Value>{1, 2.5, "x"}));
+    expect(r.empty());
+    expect(!next_frame(std::string_view{b}.substr(0, b.size() - 1)).has_value());
+  };
+
+  "server_pipelining"_test = [] {
+    using namespace ddb::protocol;
+    auto path = (std::filesystem::temp_directory_path() / "dummydb-test-server.sock").string();
+    ddb::DummyDB db{4};
+    ddb::Server server{db, 2};
+    server.listen_unix(path);
+    server.start();
+
+    // Send several requests at once; each depends on the ones before it.
+    std::string b;
+    Writer(b, 1, std::uint8_t(Opcode::CreateTable)).schema({ddb::Integer, ddb::String}).end();
+    Writer(b, 2, std::uint8_t(Opcode::Insert)).u64(0).record({42, "Hello"}).end();
+    Writer(b, 3, std::uint8_t(Opcode::Record)).u64(0).u64(0).end();
+    Writer(b, 4, std::uint8_t(Opcode::Record)).u64(3).u64(0).end();
+    Writer(b, 5, std::uint8_t(Opcode::Scan)).u64(0).u64(0).u64(10).end();
+    Writer(b, 6, std::uint8_t(Opcode::FindString)).string("Hello").end();
+
+    auto fd = connect_unix(path);
+    ::send(fd, b.data(), b.size(), 0);
+    auto responses = read_frames(fd, 6);
+    ::close(fd);
+    server.stop();
+
+    expect((responses.size() == 6) >> fatal);
+    for (std::size_t i = 0; i < 6; ++i) {
+      expect(responses[i].first.request_identity == i + 1);
+    }
+    expect(Reader{responses[0].second}.u64() == 0_u);
+    expect(Reader{responses[1].second}.u64() == 0_u);
+    expect(std::ranges::equal(Reader{responses[2].second}.record(), std::vector<ddb::Value>{42, "Hello"}));
+    expect(responses[3].first.code == std::uint8_t(Status::Error));
+    expect(Reader{responses[4].second}.u64() == 1_u);
+    expect(Reader{responses[5].second}.u64() == db.find_string("Hello"));
+  };
+
+  "admission"_test = [] {
+    using namespace ddb::protocol;
+
+    // Point requests are favored over scans according to their weights.
+    ddb::AdmissionOptions o;
+    o.workers = 1;
+    o.point_weight = 2;
+    o.scan_weight = 1;
+    o.max_queued_scans = 3;
+    ddb::AdmissionController controller{o};
+    std::string order;
+    std::latch done{7};
+    for (int i = 0; i < 3; ++i) {
+      expect(controller.submit(ddb::RequestClass::Scan, [&] { order += 'S'; done.count_down(); }));
+    }
+    expect(!controller.submit(ddb::RequestClass::Scan, [&] { order += 'S'; }));
+    for (int i = 0; i < 4; ++i) {
+      expect(controller.submit(ddb::RequestClass::Point, [&] { order += 'P'; done.count_down(); }));
+    }
+    controller.start();
+    done.wait();
+    controller.stop();
+    expect(order == "PPSPPSS");
+    expect(controller.statistics().rejected[1] == 1_u);
+
+    // Requests beyond the concurrency limit of a client are shed with a busy response.
+    auto path = (std::filesystem::temp_directory_path() / "dummydb-test-admission.sock").string();
+    ddb::DummyDB db{4};
+    auto t = db.create_table({ddb::Integer});
+    db.insert(t, {7});
+    ddb::ServerOptions options;
+    options.threads = 1;
+    options.admission.workers = 2;
+    options.admission.max_requests_per_client = 2;
+    ddb::Server server{db, options};
+    server.listen_unix(path);
+    server.start();
+
+    std::string b;
+    for (std::uint32_t i = 0; i < 5; ++i) {
+      Writer(b, i, std::uint8_t(Opcode::Record)).u64(t).u64(0).end();
+    }
+    auto fd = connect_unix(path);
+    ::send(fd, b.data(), b.size(), 0);
+    auto responses = read_frames(fd, 5);
+    ::close(fd);
+    server.stop();
+
+    expect((responses.size() == 5) >> fatal);
+    std::size_t ok = 0, busy = 0;
+    for (auto const& [f, payload] : responses) {
+      if (f.code == std::uint8_t(Status::Ok)) {
+        ok += 1;
+        expect(std::ranges::equal(Reader{payload}.record(), std::vector<ddb::Value>{7}));
+      } else {
+        busy += (f.code == std::uint8_t(Status::Busy));
+      }
+    }
+    expect(ok == 2_u);
+    expect(busy == 3_u);
+    expect(server.admission_controller()->statistics().rejected[0] == 3_u);
+  };
+
+  "metrics"_test = [] {
+    using namespace ddb::protocol;
+    ddb::DummyDB db{4};
+    ddb::Server server{db, 1};
+    std::string b, output;
+    Writer(b, 1, std::uint8_t(Opcode::CreateTable)).schema({ddb::Integer, ddb::String}).end();
+    Writer(b, 2, std::uint8_t(Opcode::Insert)).u64(0).record({42, "Hello"}).end();
+    Writer(b, 3, std::uint8_t(Opcode::Record)).u64(0).u64(0).end();
+    Writer(b, 4, std::uint8_t(Opcode::Record)).u64(0).u64(9).end();
+    std::string_view input{b};
+    while (auto f = next_frame(input)) {
+      server.service().execute(*f, output);
+      input.remove_prefix(f->size);
+    }
+
+    // Counters are collected from the threads that recorded them.
+    std::thread([&] {
+      std::string r;
+      Writer(r, 5, std::uint8_t(Opcode::Record)).u64(0).u64(0).end();
+      server.service().execute(*next_frame(r), output);
+    }).join();
+
+    auto m = server.metrics();
+    expect(m.find("dummydb_requests_total{operation=\"record\",status=\"ok\"} 2\n") != std::string::npos);
+    expect(m.find("dummydb_requests_total{operation=\"record\",status=\"error\"} 1\n") != std::string::npos);
+    expect(m.find("dummydb_request_duration_seconds_count{operation=\"insert\"} 1\n") != std::string::npos);
+    expect(m.find("dummydb_table_records{table=\"0\"} 1\n") != std::string::npos);
+    expect(m.find("dummydb_string_heap_used_bytes 6\n") != std::string::npos);
+
+    // Metrics are served over HTTP.
+    ddb::MetricsListener listener{[&] { return server.metrics(); }};
+    auto port = listener.listen_tcp(0);
+    listener.start();
+    ddb::Endpoint e;
+    e.port = port;
+    auto fd = ddb::connect(e);
+    std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::send(fd, request.data(), request.size(), 0);
+    std::string response;
+    char chunk[4096];
+    while (true) {
+      auto n = ::recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) break;
+      response.append(chunk, static_cast<std::size_t>(n));
+    }
+    ::close(fd);
+    listener.stop();
+    expect(response.starts_with("HTTP/1.1 200 OK\r\n"));
+    expect(response.find("# TYPE dummydb_request_duration_seconds histogram\n") != std::string::npos);
+  };
+
+  "client"_test = [] {
+    auto path = (std::filesystem::temp_directory_path() / "dummydb-test-client.sock").string();
+    ddb::DummyDB db{4};
+    ddb::Server server{db, 1};
+    server.listen_unix(path);
+    server.start();
+
+    ddb::Endpoint e;
+    e.unix_path = path;
+    ddb::ConnectionPool pool{e, 2};
+    auto t = pool.create_table({ddb::Integer, ddb::String}).get();
+
+    // Issue several requests before waiting for any of them.
+    auto r0 = pool.insert(t, {1, "a"});
+    auto r1 = pool.insert(t, {2, "b"});
+    expect(r0.get() != r1.get());
+    expect(std::ranges::equal(pool.record(t, 1).get(), db.record(t, 1)));
+    expect(pool.scan(t, 0, 10).get().size() == 2_u);
+    expect(pool.find_string("b").get() == db.find_string("b"));
+    expect(throws<ddb::ServerError>([&] { pool.record(t, 42).get(); }));
+
+    ddb::BatchInserter batch{pool.next(), t, 4};
+    std::vector<std::future<std::size_t>> ids;
+    for (std::int32_t i = 0; i < 10; ++i) {
+      ids.push_back(batch.insert({i, "c"}));
+    }
+    batch.flush();
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      expect(ids[i].get() == i + 2);
+    }
+    expect(db.record_count(t) == 12_u);
+  };
+
+  "async"_test = [] {
+    ddb::DummyDB db{1};
+    ddb::ThreadPool io{2};
+    ddb::AsyncDB adb{db, io};
+
+    // Note: braced lists are built outside of `co_await` expressions to work around a GCC 12 bug.
+    std::vector<ddb::FieldType> schema{ddb::Integer, ddb::String};
+    std::vector<ddb::Value> a{1, "a"};
+    std::vector<ddb::Value> b{2, "b"};
+    auto run = [&]() -> ddb::Task<std::vector<std::vector<ddb::Value>>> {
+      auto t = co_await adb.create_table(schema);
+      auto r = co_await adb.insert(t, a);
+      co_await adb.insert(t, b);
+      auto x = co_await adb.record(t, r);
+      expect(std::ranges::equal(x, a));
+      co_return co_await adb.scan(t, 1, 10);
+    };
+    auto rows = ddb::sync_wait(run());
+    expect((rows.size() == 1_u) >> fatal);
+    expect(std::ranges::equal(rows[0], b));
+
+    // Exceptions thrown by operations propagate to the awaiting coroutine.
+    auto fail = [&]() -> ddb::Task<> {
+      co_await adb.create_table(schema);
+    };
+    expect(throws<std::overflow_error>([&] { ddb::sync_wait(fail()); }));
+  };
+
+  "replication"_test = [] {
+    auto dir = std::filesystem::temp_directory_path();
+    auto primary_path = (dir / "dummydb-test-primary.sock").string();
+    auto shipper_path = (dir / "dummydb-test-shipper.sock").string();
+    auto replica_path = (dir / "dummydb-test-replica.sock").string();
+
+    // The primary serves clients and ships its log.
+    ddb::DummyDB primary_db{4};
+    ddb::ReplicationLog log;
+    ddb::Server primary{primary_db, ddb::ServerOptions{.threads = 1, .log = &log}};
+    primary.listen_unix(primary_path);
+    primary.start();
+    ddb::LogShipper shipper{log};
+    shipper.listen_unix(shipper_path);
+    shipper.start();
+
+    ddb::Endpoint e;
+    e.unix_path = primary_path;
+    ddb::Connection c{e};
+    auto t = c.create_table({ddb::Integer, ddb::String}).get();
+    c.insert(t, {1, "one"}).get();
+    c.insert_string("orphan").get();
+    ddb::BatchInserter batch{c, t};
+    batch.insert({2, "two"});
+    batch.insert({3, "three"});
+    batch.flush();
+
+    // A replica that never greets the shipper holds up neither other replicas nor `stop`.
+    auto silent = connect_unix(shipper_path);
+
+    // A replica whose greeting is malformed is disconnected without stopping the shipper.
+    auto malformed = connect_unix(shipper_path);
+    std::string greeting;
+    ddb::protocol::Writer(greeting, 0, ddb::replication::acknowledgement).end();
+    ::send(malformed, greeting.data(), greeting.size(), MSG_NOSIGNAL);
+    char byte;
+    expect(::recv(malformed, &byte, 1, 0) == 0_l);
+    ::close(malformed);
+
+    // The replica joins late and catches up from the beginning of the log.
+    ddb::DummyDB replica_db{4};
+    ddb::Server replica_server{replica_db, ddb::ServerOptions{.threads = 1, .read_only = true}};
+    replica_server.listen_unix(replica_path);
+    replica_server.start();
+    ddb::Endpoint p;
+    p.unix_path = shipper_path;
+    ddb::Replica replica{p, [&](ddb::protocol::Frame const& f) { replica_server.service().replay(f); }};
+    replica.start();
+
+    auto r = c.insert(t, {4, "four"}).get();
+    expect((replica.wait_for(log.last_lsn(), std::chrono::seconds(5))) >> fatal);
+    expect(log.last_lsn() == 6_u);
+
+    ddb::Endpoint re;
+    re.unix_path = replica_path;
+    ddb::Connection rc{re};
+    expect(std::ranges::equal(rc.record(t, r).get(), primary_db.record(t, r)));
+    expect(rc.scan(t, 0, 10).get().size() == 4_u);
+    expect(rc.find_string("orphan").get() == primary_db.find_string("orphan"));
+    expect(throws<ddb::ServerError>([&] { rc.insert(t, {5, "five"}).get(); }));
+
+    auto lag = replica.lag();
+    expect(lag.applied_lsn == 6_u);
+    expect(lag.entries == 0_u);
+    expect(replica.failure().empty());
+
+    // The primary observes the acknowledgements of the replica.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((shipper.replicas().empty() || (shipper.replicas()[0].lag != 0))
+      && (std::chrono::steady_clock::now() < deadline)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    expect((shipper.replicas().size() == 1_u) >> fatal);
+    expect(shipper.replicas()[0].acknowledged_lsn == 6_u);
+    expect(shipper.replicas()[0].connected);
+
+    // The links of replicas that left are released when another replica connects.
+    for (int i = 0; i < 3; ++i) {
+      auto flapping = connect_unix(shipper_path);
+      std::string ack;
+      ddb::protocol::Writer(ack, 0, ddb::replication::acknowledgement).u64(0).end();
+      ::send(flapping, ack.data(), ack.size(), MSG_NOSIGNAL);
+      while ((shipper.replicas().size() < 2) && (std::chrono::steady_clock::now() < deadline)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      ::close(flapping);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    auto latecomer = connect_unix(shipper_path);
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((shipper.replicas().size() != 1) && (std::chrono::steady_clock::now() < deadline)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    expect(shipper.replicas().size() == 1_u);
+    expect(shipper.replicas()[0].connected);
+
+    // Failed insertions ship the strings that they interned, so identities stay in step.
+    auto u = c.create_table({ddb::String, ddb::String}).get();
+    expect(throws<ddb::ServerError>([&] { c.insert(u, {"interned", ""}).get(); }));
+    expect(throws<ddb::ServerError>([&] { c.insert_batch(u, {{"a", "b"}, {"batched", ""}}).get(); }));
+    auto v = c.insert(u, {"after", "failures"}).get();
+    expect((replica.wait_for(log.last_lsn(), std::chrono::seconds(5))) >> fatal);
+    expect(primary_db.find_string("interned") != ddb::not_found);
+    for (auto s : {"interned", "batched", "after", "failures"}) {
+      expect(rc.find_string(s).get() == primary_db.find_string(s));
+    }
+    expect(std::ranges::equal(rc.record(u, v).get(), primary_db.record(u, v)));
+    expect(rc.scan(u, 0, 10).get().size() == 2_u);
+
+    replica.stop();
+    replica_server.stop();
+    shipper.stop();
+    primary.stop();
+    ::close(silent);
+    ::close(latecomer);
+  };
+
+  "sharding"_test = [] {
+    auto path = (std::filesystem::temp_directory_path() / "dummydb-test-shard.sock").string();
+    ddb::ThreadPool pool{2};
+    ddb::DummyDB d0{2};
+    ddb::DummyDB d1{2};
+    ddb::LocalShard s0{d0, pool};
+    ddb::LocalShard s1{d1, pool};
+
+    // The third shard lives behind a server.
+    ddb::DummyDB d2{2};
+    ddb::Server server{d2, 1};
+    server.listen_unix(path);
+    server.start();
+    ddb::Endpoint e;
+    e.unix_path = path;
+    ddb::Connection c{e};
+    ddb::RemoteShard s2{c};
+
+    ddb::ShardedTable t{{&s0, &s1, &s2}, {ddb::Integer, ddb::Float}, 0};
+    std::vector<ddb::ShardedRecordIdentity> ids;
+    for (std::int32_t i = 0; i < 60; ++i) {
+      ids.push_back(t.insert({i, 0.5 * i}));
+      expect(ids.back().shard == t.shard_of(i));
+    }
+    expect(d0.record_count(0) + d1.record_count(0) + d2.record_count(0) == 60_u);
+
+    expect(std::ranges::equal(t.record(ids[7]), std::vector<ddb::Value>{7, 3.5}));
+    auto rows = t.find(42);
+    expect((rows.size() == 1_u) >> fatal);
+    expect(std::ranges::equal(rows[0], std::vector<ddb::Value>{42, 21.0}));
+    expect(t.scan().size() == 60_u);
+
+    auto s = t.summarize(0);
+    expect(s.count == 60_u);
+    expect(s.sum == 1770._d);
+    expect(s.min == 0._d);
+    expect(s.max == 59._d);
+
+    // Float keys are found both as given and as read back, although they are stored as floats.
+    ddb::ShardedTable u{{&s0, &s1, &s2}, {ddb::Float, ddb::Integer}, 0};
+    for (std::int32_t i = 0; i < 20; ++i) u.insert({0.1 * i, i});
+    auto found = u.find(0.1 * 7);
+    expect((found.size() == 1_u) >> fatal);
+    expect(found[0][1] == ddb::Value{7});
+    expect(std::get<ddb::Float>(found[0][0]) != 0.1 * 7);
+    expect(u.find(found[0][0]).size() == 1_u);
+    expect(u.find(0.1 * 7 + 1e-3).empty());
+  };
+
+  "result_cache"_test = [] {
+    ddb::DummyDB db{4};
+    auto t = db.create_table({ddb::Integer, ddb::Float});
+    auto u = db.create_table({ddb::Integer});
+    for (int i = 0; i < 10; ++i) db.insert(t, {i, i * 0.5});
+
+    ddb::ResultCache cache{db, 1 << 20};
+    auto a = cache.summarize(t, 0);
+    auto b = cache.summarize(t, 0);
+    expect(a == b);
+    expect(b->sum == 45._d);
+    expect(cache.usage().hits == 1_u);
+    expect(cache.usage().misses == 1_u);
+
+    // Scans past the end of the table share their result whatever their count.
+    auto r = cache.scan(t, 5, 100);
+    expect(r->size() == 5_u);
+    expect(cache.scan(t, 5, ddb::not_found) == r);
+
+    // Modifying another table keeps results valid; modifying the table invalidates them.
+    db.insert(u, {1});
+    expect(cache.summarize(t, 0) == a);
+    db.insert(t, {10, 5.});
+    auto c = cache.summarize(t, 0);
+    expect(c != a);
+    expect(c->sum == 55._d);
+    expect(cache.scan(t, 5, 100)->size() == 6_u);
+
+    // The least recently used results are evicted first.
+    ddb::ResultCache small{db, 1024};
+    auto first = small.scan(t, 0, 1);
+    for (std::size_t i = 1; i < 10; ++i) {
+      small.scan(t, i, 1);
+      expect(small.scan(t, 0, 1) == first);
+    }
+    expect(small.usage().evictions > 0_u);
+    expect(small.usage().bytes <= 1024_u);
+  };
+
+  "record_cache"_test = [] {
+    ddb::DummyDB db{1};
+    auto t = db.create_table({ddb::Integer, ddb::String});
+    for (std::int32_t i = 0; i < 100; ++i) db.insert(t, i, "row " + std::to_string(i));
+
+    // A single set, whose recently used records survive while the others are replaced.
+    ddb::RecordCache cache{db, 1};
+    expect(cache.capacity() == 8_u);
+    auto hot = db.record_id(t, 42);
+    expect(std::ranges::equal(cache.record(hot), db.record(hot)));
+    for (std::size_t i = 50; i < 100; ++i) {
+      expect(std::ranges::equal(cache.record(db.record_id(t, i)), db.record(t, i)));
+      expect(std::ranges::equal(cache.record(hot), std::vector<ddb::Value>{42, "row 42"}));
+    }
+    auto u = cache.usage();
+    expect(u.hits == 50_u);
+    expect(u.misses == 51_u);
+    expect(u.evictions == 43_u);
+    expect(u.entries == 8_u);
+
+    expect(*cache.shared_record(hot) == cache.record(hot));
+    cache.invalidate(hot);
+    cache.record(hot);
+    expect(cache.usage().misses == 52_u);
+
+    // Updates are not seen until the record is invalidated.
+    db.update(t, 42, {-42, "updated"});
+    expect(std::ranges::equal(cache.record(hot), std::vector<ddb::Value>{42, "row 42"}));
+    cache.invalidate(hot);
+    expect(std::ranges::equal(*cache.shared_record(hot), std::vector<ddb::Value>{-42, "updated"}));
+    expect(cache.usage().misses == 53_u);
+    cache.invalidate(t);
+    expect(cache.usage().entries == 0_u);
+
+    // Hits take no lock, and entries replaced while they are being looked up stay valid.
+    static_assert(ddb::RecordCache::lock_free_hits);
+    std::atomic<std::size_t> wrong = 0;
+    auto look_up = [&](std::size_t offset) {
+      for (std::size_t i = 0; i < 20000; ++i) {
+        auto r = (i * 7 + offset) % 24;
+        auto record = cache.shared_record(db.record_id(t, r));
+        if ((*record)[0] != ddb::Value{static_cast<std::int32_t>(r)}) wrong += 1;
+        if ((i % 100) == 0) cache.invalidate(db.record_id(t, r));
+      }
+    };
+    std::thread a{look_up, 0};
+    std::thread b{look_up, 5};
+    look_up(11);
+    a.join();
+    b.join();
+    expect(wrong.load() == 0_u);
+  };
+
+  "project"_test = [] {
+    ddb::DummyDB db{2};
+    auto t = db.create_table({ddb::Integer, ddb::String, ddb::Float});
+    for (std::int32_t i = 0; i < 10; ++i) db.insert(t, -i, "row " + std::to_string(i), 0.5 * i);
+    auto u = db.create_table({ddb::Float});
+    for (std::int32_t i = 0; i < 3; ++i) db.insert(u, 0.25 * i);
+
+    std::vector<std::int32_t> ints(8);
+    std::vector<std::string_view> strings(8);
+    std::vector<double> doubles(8);
+    std::size_t columns[] = {2, 0, 1};
+    ddb::ColumnBuffer buffers[] = {std::span{doubles}, std::span{ints}, std::span{strings}};
+    expect(db.project(t, columns, 4, 8, buffers) == 6_u);
+    for (std::size_t i = 0; i < 6; ++i) {
+      expect(ints[i] == -static_cast<std::int32_t>(i + 4));
+      expect(strings[i] == "row " + std::to_string(i + 4));
+      expect(doubles[i] == 0.5 * static_cast<double>(i + 4));
+    }
+    expect(db.project(t, columns, 10, 8, buffers) == 0_u);
+
+    std::vector<float> floats(3);
+    std::size_t only[] = {0};
+    ddb::ColumnBuffer single[] = {std::span{floats}};
+    expect(db.project(u, only, 0, 3, single) == 3_u);
+    expect(floats == std::vector<float>{0.0f, 0.25f, 0.5f});
+
+    ddb::ColumnBuffer mismatched[] = {std::span{ints}};
+    expect(throws<std::invalid_argument>([&] { db.project(u, only, 0, 3, mismatched); }));
+    ddb::ColumnBuffer small[] = {std::span{floats}.first(2)};
+    expect(throws<std::invalid_argument>([&] { db.project(u, only, 0, 3, small); }));
+    std::size_t missing[] = {1};
+    expect(throws<std::out_of_range>([&] { db.project(u, missing, 0, 3, single); }));
+    expect(throws<std::out_of_range>([&] { db.project(2, only, 0, 3, single); }));
+  };
+
+  "sampling"_test = [] {
+    ddb::DummyDB db{64};
+    std::vector<std::size_t> tables;
+    for (std::size_t t = 0; t < 64; ++t) {
+      tables.push_back(db.create_table({ddb::Integer, ddb::Float}));
+      for (std::int32_t i = 0; i < 100; ++i) db.insert(t, i % 4, static_cast<double>(t) + i);
+    }
+    double total = 0;
+    for (auto t : tables) total += db.summarize(t, 1).sum;
+    std::mt19937_64 rng{42};
+    expect(std::abs(ddb::sampling::critical_value(0.95) - 1.959964) < 1e-6);
+
+    // Samples covering all records give exact estimates.
+    for (auto s : {ddb::sample_records(db, tables, 6400, rng), ddb::reservoir_sample(db, tables, 6400, rng)}) {
+      expect(s.records.size() == 6400_u);
+      expect(s.population == 6400_u);
+      auto e = ddb::estimate_summary(db, s, 1);
+      expect(std::abs(e.sum.value - total) < 1e-6);
+      expect(e.sum.margin == 0.0);
+      expect(e.count.value == 6400.0);
+    }
+    auto whole = ddb::sample_tables(db, tables, 64, rng);
+    expect(whole.unit_count() == 64_u);
+    expect(std::abs(ddb::estimate_summary(db, whole, 1).sum.value - total) < 1e-6);
+
+    // Partial samples are distinct records whose wide confidence intervals cover the true values.
+    auto s = ddb::sample_records(db, tables, 640, rng);
+    expect(std::set<ddb::RecordId>(s.records.begin(), s.records.end()).size() == 640_u);
+    auto e = ddb::estimate_summary(db, s, 1, 0.999);
+    expect(e.sum.lower() < total && total < e.sum.upper());
+    expect(e.sum.margin > 0.0);
+    expect(e.count.margin == 0.0);
+    auto r = ddb::reservoir_sample(db, tables, 640, rng);
+    expect(std::set<ddb::RecordId>(r.records.begin(), r.records.end()).size() == 640_u);
+    e = ddb::estimate_summary(db, r, 1, 0.999);
+    expect(e.mean.lower() < total / 6400 && total / 6400 < e.mean.upper());
+
+    // Tables of equal size give exact counts, and subsampled ones stand for all their records.
+    auto b = ddb::sample_tables(db, tables, 16, rng, 10);
+    expect(b.records.size() == 160_u);
+    expect(!b.complete_units);
+    e = ddb::estimate_summary(db, b, 1, 0.999);
+    expect(e.count.value == 6400.0);
+    expect(e.count.margin < 1e-9);
+    expect(e.sum.lower() < total && total < e.sum.upper());
+    expect(throws<std::invalid_argument>([&] { ddb::sample_tables(db, tables, 16, rng, 0); }));
+
+    auto groups = ddb::estimate_groups(db, ddb::sample_records(db, tables, 6400, rng), 0, 1);
+    expect(groups.size() == 4_u);
+    for (auto const& [k, g] : groups) {
+      expect(g.count.value == 1600.0);
+      expect(g.sample.count == 1600_u);
+    }
+    groups = ddb::estimate_groups(db, s, 0, 1, 0.999);
+    expect(groups.size() == 4_u);
+    for (auto const& [k, g] : groups) {
+      expect(g.count.lower() < 1600.0 && 1600.0 < g.count.upper());
+    }
+    expect(throws<std::invalid_argument>([&] { ddb::estimate_summary(db, s, 1, 1.5); }));
+
+    // Each of 10 items is kept by a reservoir of 5 about half of the time.
+    std::vector<std::size_t> kept(10);
+    for (std::size_t i = 0; i < 2000; ++i) {
+      ddb::Reservoir<std::size_t> reservoir{5};
+      for (std::size_t j = 0; j < 10; ++j) {
+        if (reservoir.skip() > 0) {
+          reservoir.pass(1);
+        } else {
+          reservoir.offer(j, rng);
+        }
+      }
+      expect(reservoir.count() == 10_u);
+      for (auto j : reservoir.items()) kept[j] += 1;
+    }
+    for (auto k : kept) expect(k > 850_u && k < 1150_u);
+  };
+
+  "bulk_load"_test = [] {
+    ddb::DummyDB db{8};
+    auto a = db.insert_string("alpha");
+    std::string_view strings[] = {"beta", "alpha", "gamma", "beta"};
+    auto ids = db.insert_strings(strings);
+    expect(ids.size() == 4_u);
+    expect(ids[1] == a);
+    expect(ids[0] == ids[3]);
+    expect(db.string(ids[2]) == "gamma");
+    expect(db.string_table_usage() == 17_u);
+    std::string_view empty[] = {""};
+    expect(throws<std::invalid_argument>([&] { db.insert_strings(empty); }));
+
+    auto t = db.create_table({ddb::Integer, ddb::String});
+    std::uint32_t fields[] = {7, static_cast<std::uint32_t>(a), 8, static_cast<std::uint32_t>(ids[2])};
+    expect(db.append_encoded(t, fields) == 2_u);
+    expect(std::ranges::equal(db.record(t, 1), std::vector<ddb::Value>{8, "gamma"}));
+    expect(throws<std::invalid_argument>([&] { db.append_encoded(t, std::span{fields}.first(3)); }));
+    fields[1] = 4096;
+    expect(throws<std::out_of_range>([&] { db.append_encoded(t, fields); }));
+    fields[1] = static_cast<std::uint32_t>(ids[2] + 1);
+    expect(throws<std::out_of_range>([&] { db.append_encoded(t, fields); }));
+    expect(db.record_count(t) == 2_u);
+
+    std::vector<std::vector<ddb::Value>> records;
+    for (std::int32_t i = 0; i < 2000; ++i) {
+      records.push_back({i, "tag " + std::to_string(i % 50), 0.5 * i, (i % 2) ? "odd" : "alpha"});
+    }
+    for (std::size_t parallelism : {1, 4}) {
+      ddb::DummyDB target{16};
+      target.insert_string("odd");
+      ddb::ThreadPool pool{2};
+      ddb::BulkLoader loader{target, pool, {ddb::Integer, ddb::String, ddb::Float, ddb::String}, parallelism};
+      expect(loader.load(std::span{records}.first(500)) == 500_u);
+      expect(loader.load(std::span{records}.subspan(500)) == 1500_u);
+      expect(loader.tables().size() > 1_u);
+      std::size_t i = 0;
+      for (auto u : loader.tables()) {
+        for (std::size_t j = 0; j < target.record_count(u); ++j, ++i) {
+          expect(std::ranges::equal(target.record(u, j), records[i]));
+        }
+      }
+      expect(i == 2000_u);
+      expect(target.find_string("odd") == 0_u);
+      expect(target.string_table_usage() == 350_u);
+      std::vector<std::vector<ddb::Value>> wrong{{1, 2, 0.5, "x"}};
+      expect(throws<std::invalid_argument>([&] { loader.load(wrong); }));
+    }
+  };
+
+  "hash"_test = [] {
+    ddb::Hash h;
+    expect(h(std::string{"sensor"}) == h(std::string_view{"sensor"}));
+    expect(h(0.0) == h(-0.0));
+    expect(h(ddb::Value{1}) != h(ddb::Value{"1"}));
+    expect(h(std::int32_t{7}) == h(std::uint64_t{7}));
+
+    // Hashes of distinct short strings of any length and of consecutive integers do not collide,
+    // even in their low bits.
+    std::set<std::uint64_t> hashes, low_bits;
+    std::string s;
+    for (std::size_t i = 0; i < 64; ++i) {
+      s.push_back(static_cast<char>('a' + (i % 26)));
+      hashes.insert(h(s));
+      hashes.insert(h(s + '!'));
+    }
+    expect(hashes.size() == 128_u);
+    for (std::uint64_t i = 0; i < 4096; ++i) low_bits.insert(h(i) & 0xffffff);
+    expect(low_bits.size() > 4090_u);
+  };
+
+  "hash_map"_test = [] {
+    ddb::HashMap<std::string, std::size_t> names;
+    expect(names.find("x") == nullptr);
+    expect(names.try_emplace(std::string_view{"alpha"}, 1u).second);
+    expect(!names.try_emplace(std::string_view{"alpha"}, 2u).second);
+    names["beta"] = 3;
+    expect(*names.find(std::string_view{"alpha"}) == 1_u);
+    expect(*names.find("beta") == 3_u);
+    expect(names.size() == 2_u);
+    expect(names.erase("alpha"));
+    expect(!names.erase("alpha"));
+    expect(!names.contains("alpha"));
+    names.clear();
+    expect(names.empty());
+
+    // Random operations behave like those of `std::unordered_map`.
+    std::mt19937_64 rng{7};
+    ddb::HashMap<std::uint64_t, std::uint64_t> m;
+    std::unordered_map<std::uint64_t, std::uint64_t> reference;
+    for (std::size_t i = 0; i < 50000; ++i) {
+      auto k = rng() % 2000;
+      switch (rng() % 3) {
+        case 0:
+          expect(m.try_emplace(k, i).second == reference.try_emplace(k, i).second);
+          break;
+        case 1:
+          expect(m.erase(k) == (reference.erase(k) == 1));
+          break;
+        default:
+          auto v = m.find(k);
+          auto r = reference.find(k);
+          expect((v != nullptr) == (r != reference.end()));
+          if (v != nullptr) expect(*v == r->second);
+      }
+    }
+    expect(m.size() == reference.size());
+    std::size_t n = 0;
+    m.for_each([&](std::uint64_t k, std::uint64_t v) { n += (reference.at(k) == v); });
+    expect(n == reference.size());
+    expect(m.capacity() <= 4096_u);
+  };
+
+  "cuckoo_filter"_test = [] {
+    expect(throws<std::invalid_argument>([] { ddb::CuckooFilter{16, 0.0}; }));
+    ddb::CuckooFilter f{10000, 0.01};
+    expect(f.fingerprint_bits() == 10_u);
+    expect(f.memory_size() < 16384_u);
+    for (std::uint64_t i = 0; i < 10000; ++i) expect(f.insert(ddb::hash_integer(i)));
+    expect(f.size() == 10000_u);
+    std::size_t missing = 0, false_positives = 0;
+    for (std::uint64_t i = 0; i < 10000; ++i) missing += !f.contains(ddb::hash_integer(i));
+    for (std::uint64_t i = 10000; i < 110000; ++i) false_positives += f.contains(ddb::hash_integer(i));
+    expect(missing == 0_u);
+    expect(false_positives < 1000_u);
+
+    // Erased hashes are gone and the others remain, even after the filter overflowed.
+    for (std::uint64_t i = 0; i < 10000; i += 2) expect(f.erase(ddb::hash_integer(i)));
+    for (std::uint64_t i = 1; i < 10000; i += 2) missing += !f.contains(ddb::hash_integer(i));
+    expect(missing == 0_u);
+    expect(f.size() == 5000_u);
+    ddb::CuckooFilter small{64, 0.05};
+    std::uint64_t n = 0;
+    while (small.insert(ddb::hash_integer(n))) ++n;
+    expect(n >= 60_u);
+    for (std::uint64_t i = 0; i < n; ++i) missing += !small.contains(ddb::hash_integer(i));
+    expect(missing == 0_u);
+  };
+
+  "key_filter"_test = [] {
+    ddb::DummyDB db{1};
+    auto t = db.create_table({ddb::Integer, ddb::String, ddb::Float});
+    for (std::int32_t i = 0; i < 100; ++i) db.insert(t, i * 3, "user " + std::to_string(i), 0.25 * i);
+    ddb::KeyFilter ids{db, t, 0};
+    ddb::KeyFilter names{db, t, 1, 0.001};
+    ddb::KeyFilter amounts{db, t, 2};
+    expect(names.filter().fingerprint_bits() == 13_u);
+
+    // Deduplicating ingestion inserts only the records whose key is new.
+    std::size_t inserted = 0;
+    for (std::int32_t i = 0; i < 200; ++i) {
+      if (!ids.contains(i)) {
+        db.insert(t, i, "new user " + std::to_string(i), 0.5);
+        ids.add(i);
+        inserted += 1;
+      }
+    }
+    expect(inserted == 133_u);
+    for (std::int32_t i = 0; i < 200; ++i) expect(ids.contains(i));
+    expect(!ids.contains(-1));
+    auto u = ids.usage();
+    expect(u.lookups == 401_u);
+    expect(u.rejected + u.false_positives == 134_u);
+
+    expect(names.contains(std::string{"user 42"}));
+    expect(!names.contains(std::string{"user 420"}));
+    expect(amounts.contains(0.75));
+    expect(!amounts.contains(0.3));
+    expect(names.contains(std::string{"user 42"}, [](ddb::Value const&) { return false; }) == false);
+    expect(names.erase(std::string{"user 42"}));
+    auto before = names.usage();
+    expect(!names.contains(std::string{"user 42"}));
+    expect(names.usage().rejected == before.rejected + 1);
+    expect(names.usage().false_positives == before.false_positives);
+    expect(throws<std::invalid_argument>([&] { ids.contains(0.5); }));
+    expect(throws<std::out_of_range>([&] { ddb::KeyFilter(db, t, 3); }));
+  };
+
+  "sequence_lock"_test = [] {
+    ddb::DummyDB db{1};
+    // Wide records make updates long enough to be preempted while readers run, even on one core.
+    std::vector<ddb::FieldType> schema(62, ddb::Integer);
+    schema.insert(schema.end(), {ddb::Float, ddb::String});
+    auto t = db.create_table(schema);
+    auto make = [](std::int32_t k) {
+      std::vector<ddb::Value> r(62, k);
+      r.insert(r.end(), {static_cast<double>(k), std::to_string(k % 10)});
+      return r;
+    };
+    auto consistent = [&](std::vector<ddb::Value> const& r) {
+      auto k = std::get<ddb::Integer>(r[0]);
+      return std::ranges::equal(r, make(k));
+    };
+    db.insert(t, make(0));
+    auto v = db.version(t);
+    expect(*db.try_update(t, 0, make(7)) == 0_u);
+    expect(consistent(db.record(t, 0)) && (db.record(t, 0)[0] == ddb::Value{7}));
+    expect(db.version(t) == v + 1);
+    expect(throws<std::out_of_range>([&] { db.update(t, 1, make(1)); }));
+    expect(throws<std::invalid_argument>([&] { db.update(t, 0, {1, 2, 3.0, 4}); }));
+    expect(throws<std::invalid_argument>([&] { db.update(t, 0, std::vector<ddb::Value>(64, 1)); }));
+
+    // A single writer updates a record in place and appends records while readers check that
+    // every record they read is made of the fields of a single write.
+    std::atomic<bool> done = false;
+    std::atomic<std::size_t> torn = 0;
+    std::atomic<std::size_t> reads = 0;
+    auto reader = [&](bool batched) {
+      while (!done.load()) {
+        std::size_t ids[] = {0, db.record_count(t) - 1};
+        auto records = batched ? db.multi_get(t, ids) : std::vector<std::vector<ddb::Value>>{db.record(t, 0)};
+        for (auto const& r : records) {
+          if (!consistent(r)) torn += 1;
+        }
+        reads += records.size();
+      }
+    };
+    std::thread a{reader, false};
+    std::thread b{reader, true};
+    for (std::int32_t k = 0; k < 200000; ++k) {
+      db.update(t, 0, make(k));
+      if ((k % 1000) == 0) (void)db.try_insert(t, make(k));
+    }
+    done = true;
+    a.join();
+    b.join();
+    expect(torn.load() == 0_u);
+    expect(reads.load() > 0_u);
+    expect(db.record(t, 0)[0] == ddb::Value{199999});
+
+    // An update whose strings do not fit leaves the record unchanged.
+    std::string s(200, 'a');
+    for (std::size_t m = 0; m < 100; ++m) {
+      s[0] = static_cast<char>('a' + (m % 26));
+      s[1] = static_cast<char>('a' + (m / 26));
+      if (!db.try_insert_string(s)) break;
+    }
+    auto r = make(1);
+    r.back() = s;
+    expect(db.try_update(t, 0, r).error() == ddb::ErrorCode::StringTableFull);
+    expect(db.record(t, 0)[0] == ddb::Value{199999});
+  };
+
   return 0;
 }